@@ -0,0 +1,95 @@
+#include "ArchiveExtractor.h"
+#include "Log.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+ArchiveExtractor::ArchiveExtractor(const ArchiveIndex& index, const std::string& dataPath, ExtractionOptions options)
+    : index(index), dataPath(dataPath), data(ImageReader::Open(dataPath)), options(options) {
+    if (!data) {
+        throw std::runtime_error("Failed to open archive data: " + dataPath);
+    }
+}
+
+std::filesystem::path ArchiveExtractor::GetRelativeOutputPath(std::string_view name) {
+    std::filesystem::path relativePath;
+    size_t start = 0;
+    while (start <= name.size()) {
+        size_t end = name.find_first_of("/\\", start);
+        if (end == std::string_view::npos) {
+            end = name.size();
+        }
+        std::string_view component = name.substr(start, end - start);
+        if (component == "..") {
+            return {};
+        }
+        if (!component.empty() && component != ".") {
+            relativePath /= std::string(component);
+        }
+        start = end + 1;
+    }
+    if (relativePath.has_root_name()) {
+        return {};
+    }
+    return relativePath;
+}
+
+std::string ArchiveExtractor::FindDataFile(const std::string& indexPath) {
+    for (const char* extension : { ".DAT", ".dat" }) {
+        std::filesystem::path candidate = std::filesystem::path(indexPath).replace_extension(extension);
+        if (std::filesystem::exists(candidate)) {
+            return candidate.string();
+        }
+    }
+    return {};
+}
+
+ExtractionStats ArchiveExtractor::ExtractAll(const std::filesystem::path& outputDirectory) {
+    Metrics::ScopedTimer timer(Phase::Extraction);
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Sequential source reads: visit the assets in the order they sit in the .dat.
+    std::vector<uint32_t> order(index.Size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return index.GetOffset(a) < index.GetOffset(b);
+    });
+
+    std::vector<ExtractionTarget> work;
+    work.reserve(order.size());
+    for (uint32_t i : order) {
+        std::string_view name = index.GetName(i);
+        std::filesystem::path relativePath = GetRelativeOutputPath(name);
+        if (relativePath.empty()) {
+            LOG_WARNING("Skipping archive entry " << i << " with unusable name \"" << name << "\"");
+            continue;
+        }
+        // Names match case-insensitively, so only the first of a set of duplicates is written.
+        if (index.Find(name) != i) {
+            LOG_WARNING("Skipping duplicate archive entry " << i << ": " << name);
+            continue;
+        }
+        if (static_cast<uint64_t>(index.GetOffset(i)) + index.GetSize(i) > data->Size()) {
+            throw std::runtime_error("Archive entry " + std::string(name) + " lies outside the data file.");
+        }
+        work.push_back({ index.GetOffset(i), index.GetSize(i), outputDirectory / relativePath });
+    }
+
+    // Create the output tree up front so writers never race on directory creation.
+    std::filesystem::create_directories(outputDirectory);
+    for (const auto& item : work) {
+        std::filesystem::create_directories(item.OutputPath.parent_path());
+    }
+
+    ExtractionStats stats = Extractor::WriteFiles(*data, dataPath, work, options);
+    stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    Metrics::Add(Counter::FilesExtracted, stats.Files);
+    Metrics::Add(Counter::BytesExtracted, stats.Bytes);
+    LOG_INFO("Unpacked " << stats.Files << " assets (" << stats.Bytes << " bytes) in " << stats.Seconds << " s: "
+        << stats.MegabytesPerSecond() << " MB/s, " << stats.FilesPerSecond() << " files/s");
+    return stats;
+}
@@ -0,0 +1,35 @@
+#ifndef ARCHIVEEXTRACTOR_H
+#define ARCHIVEEXTRACTOR_H
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "ArchiveIndex.h"
+#include "Extractor.h"
+#include "ImageReader.h"
+
+// Unpacks the assets of an HD2/HED-indexed .dat. Entries are read in Offset order so the .dat is
+// scanned front to back, through the same chunked read and write pipeline as Extractor and under
+// the same in-flight byte cap. Output depends only on the archive, not on the thread count.
+class ArchiveExtractor {
+public:
+    // Throws std::runtime_error if the .dat cannot be opened.
+    ArchiveExtractor(const ArchiveIndex& index, const std::string& dataPath, ExtractionOptions options = {});
+
+    ExtractionStats ExtractAll(const std::filesystem::path& outputDirectory);
+
+    // Output location of an entry name, or an empty path for names that are empty or would
+    // escape the output directory (absolute, or containing "..").
+    static std::filesystem::path GetRelativeOutputPath(std::string_view name);
+    // The .dat next to an index: same stem, extension ".DAT" or ".dat". Empty if neither exists.
+    static std::string FindDataFile(const std::string& indexPath);
+
+private:
+    const ArchiveIndex& index;
+    std::string dataPath;
+    std::unique_ptr<ImageReader> data;
+    ExtractionOptions options;
+};
+
+#endif // ARCHIVEEXTRACTOR_H
@@ -0,0 +1,152 @@
+#include "ArchiveIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+    constexpr uint64_t FnvOffsetBasis = 14695981039346656037ull;
+    constexpr uint64_t FnvPrime = 1099511628211ull;
+    constexpr uint32_t EmptySlot = 0xFFFFFFFF;
+
+    char NormalizeChar(char c) {
+        if (c >= 'a' && c <= 'z') {
+            return static_cast<char>(c - 'a' + 'A');
+        }
+        return c == '\\' ? '/' : c;
+    }
+
+    uint64_t HashName(std::string_view name) {
+        uint64_t hash = FnvOffsetBasis;
+        for (char c : name) {
+            hash = (hash ^ static_cast<uint8_t>(NormalizeChar(c))) * FnvPrime;
+        }
+        return hash;
+    }
+
+    bool NamesEqual(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return NormalizeChar(x) == NormalizeChar(y);
+        });
+    }
+
+    std::string_view BoundedString(const uint8_t* data, size_t maxLength) {
+        const char* text = reinterpret_cast<const char*>(data);
+        const void* terminator = std::memchr(text, '\0', maxLength);
+        return std::string_view(text, terminator ? static_cast<const char*>(terminator) - text : maxLength);
+    }
+
+} // namespace
+
+ArchiveFormat ArchiveIndex::FormatFromPath(const std::string& path) {
+    // Tolerates ISO9660 version suffixes, e.g. "DATA\\DATA.HD2;1".
+    std::string extension = std::filesystem::path(path.substr(0, path.rfind(';'))).extension().string();
+    for (char& c : extension) {
+        c = NormalizeChar(c);
+    }
+    if (extension == ".HD2") {
+        return ArchiveFormat::HD2;
+    }
+    if (extension == ".HED") {
+        return ArchiveFormat::HED;
+    }
+    throw std::runtime_error("Unrecognized archive index extension: " + path);
+}
+
+void ArchiveIndex::Load(const std::string& path) {
+    Load(path, FormatFromPath(path));
+}
+
+void ArchiveIndex::Load(const std::string& path, ArchiveFormat archiveFormat) {
+    auto fileReader = ImageReader::Open(path);
+    if (!fileReader) {
+        throw std::runtime_error("Failed to open archive index: " + path);
+    }
+    FileView fileView = fileReader->View(0, static_cast<size_t>(fileReader->Size()));
+    Load(std::move(fileView), archiveFormat);
+    reader = std::move(fileReader);
+}
+
+void ArchiveIndex::Load(FileView headerView, ArchiveFormat archiveFormat) {
+    reader.reset();
+    view = std::move(headerView);
+    format = archiveFormat;
+    Build();
+}
+
+void ArchiveIndex::Build() {
+    names.clear();
+    lookupSlots.clear();
+
+    const uint8_t* data = view.Data();
+    const size_t size = view.Size();
+
+    if (format == ArchiveFormat::HD2) {
+        // The string table follows the entries, so the lowest name offset seen bounds the table.
+        size_t tableEnd = size;
+        for (size_t position = 0; position + HD2EntrySize <= tableEnd; position += HD2EntrySize) {
+            const uint8_t* entry = data + position;
+            if (std::all_of(entry, entry + HD2EntrySize, [](uint8_t b) { return b == 0; })) {
+                break;
+            }
+            uint32_t nameOffset = Bytes::ReadUInt32(entry);
+            if (nameOffset < position + HD2EntrySize || nameOffset >= size) {
+                throw std::runtime_error("Invalid name offset in HD2 entry " + std::to_string(names.size()) + ".");
+            }
+            tableEnd = std::min<size_t>(tableEnd, nameOffset);
+            names.push_back(BoundedString(data + nameOffset, size - nameOffset));
+        }
+    }
+    else {
+        for (size_t position = 0; position + HEDEntrySize <= size; position += HEDEntrySize) {
+            const uint8_t* entry = data + position;
+            if (entry[0] == 0) {
+                break;
+            }
+            names.push_back(BoundedString(entry, HEDNameSize));
+        }
+    }
+
+    size_t slotCount = 16;
+    while (slotCount < names.size() * 2) {
+        slotCount <<= 1;
+    }
+    lookupSlots.assign(slotCount, EmptySlot);
+    for (uint32_t i = 0; i < names.size(); i++) {
+        size_t slot = HashName(names[i]) & (slotCount - 1);
+        while (lookupSlots[slot] != EmptySlot) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        lookupSlots[slot] = i;
+    }
+}
+
+ArchiveEntry ArchiveIndex::Get(uint32_t i) const {
+    ArchiveEntry entry;
+    entry.Name = names[i];
+    entry.Offset = GetOffset(i);
+    entry.Size = GetSize(i);
+    if (format == ArchiveFormat::HD2) {
+        entry.LBAOffset = Bytes::ReadUInt32(GetEntryData(i) + 24);
+        entry.LBAExtent = Bytes::ReadUInt32(GetEntryData(i) + 28);
+    }
+    else {
+        entry.LBAOffset = entry.Offset / 2048;
+        entry.LBAExtent = static_cast<uint32_t>((static_cast<uint64_t>(entry.Size) + 2047) / 2048);
+    }
+    return entry;
+}
+
+std::optional<uint32_t> ArchiveIndex::Find(std::string_view name) const {
+    if (lookupSlots.empty()) {
+        return std::nullopt;
+    }
+    const size_t mask = lookupSlots.size() - 1;
+    for (size_t slot = HashName(name) & mask; lookupSlots[slot] != EmptySlot; slot = (slot + 1) & mask) {
+        if (NamesEqual(names[lookupSlots[slot]], name)) {
+            return lookupSlots[slot];
+        }
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,71 @@
+#ifndef ARCHIVEINDEX_H
+#define ARCHIVEINDEX_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Bytes.h"
+#include "FileView.h"
+#include "ImageReader.h"
+
+enum class ArchiveFormat {
+    HD2,    // 32-byte entries naming their file through an offset into a trailing string table
+    HED     // 80-byte entries with the name inline
+};
+
+struct ArchiveEntry {
+    std::string_view Name;
+    uint32_t Offset;     // Byte offset of the data in the companion .dat
+    uint32_t Size;
+    uint32_t LBAOffset;  // Offset in 2048-byte sectors (derived from Offset for HED)
+    uint32_t LBAExtent;  // Sectors spanned (derived from Size for HED)
+};
+
+// Index of an HD2 or HED archive header. The header bytes are memory-mapped (or viewed in place
+// inside a larger image) and entries are decoded straight from them; the only per-entry state
+// is each name, resolved once, and a hash table for name lookups.
+class ArchiveIndex {
+public:
+    static constexpr size_t HD2EntrySize = 32;
+    static constexpr size_t HEDEntrySize = 80;
+    static constexpr size_t HEDNameSize = 64;
+
+    // Format chosen from the extension (.hd2 or .hed). Throws std::runtime_error if the file cannot
+    // be opened or its entries are malformed.
+    void Load(const std::string& path);
+    void Load(const std::string& path, ArchiveFormat format);
+    // Indexes header bytes that are already mapped, e.g. a FileView into an ISO.
+    void Load(FileView headerView, ArchiveFormat format);
+
+    ArchiveFormat GetFormat() const { return format; }
+    size_t Size() const { return names.size(); }
+
+    std::string_view GetName(uint32_t i) const { return names[i]; }
+    uint32_t GetOffset(uint32_t i) const { return Bytes::ReadUInt32(GetEntryData(i) + (format == ArchiveFormat::HD2 ? 16 : 64)); }
+    uint32_t GetSize(uint32_t i) const { return Bytes::ReadUInt32(GetEntryData(i) + (format == ArchiveFormat::HD2 ? 20 : 68)); }
+    ArchiveEntry Get(uint32_t i) const;
+
+    // Raw on-disk bytes of entry `i`, laid out as an HD2 or HED struct.
+    const uint8_t* GetEntryData(uint32_t i) const { return view.Data() + i * GetEntrySize(); }
+    size_t GetEntrySize() const { return format == ArchiveFormat::HD2 ? HD2EntrySize : HEDEntrySize; }
+    const FileView& GetView() const { return view; }
+
+    // Entry whose name matches `name`, ignoring ASCII case and treating '\\' as '/'.
+    std::optional<uint32_t> Find(std::string_view name) const;
+
+    static ArchiveFormat FormatFromPath(const std::string& path);
+
+private:
+    void Build();
+
+    std::unique_ptr<ImageReader> reader; // Keeps a mapped header file alive for `view`
+    FileView view;
+    ArchiveFormat format = ArchiveFormat::HD2;
+    std::vector<std::string_view> names;
+    std::vector<uint32_t> lookupSlots;   // Open-addressed table of entry indices keyed by name hash
+};
+
+#endif // ARCHIVEINDEX_H
@@ -0,0 +1,304 @@
+#include "ArchivePatcher.h"
+#include "ArchiveExtractor.h"
+#include "ArchiveIndex.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+    constexpr size_t CopyBlockSize = 4 * 1024 * 1024;
+
+    void PutUInt32(uint8_t* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint32_t ToUInt32(uint64_t value, const char* what) {
+        if (value > 0xFFFFFFFFull) {
+            throw std::runtime_error(std::string(what) + " no longer fits in an archive entry.");
+        }
+        return static_cast<uint32_t>(value);
+    }
+
+    void WriteBytes(std::ostream& output, const uint8_t* data, size_t length, const std::string& path) {
+        if (!output.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(length))) {
+            throw std::runtime_error("Failed to write " + path + ".");
+        }
+    }
+
+    // Field positions within an entry (see HD2 / HED).
+    struct EntryLayout {
+        size_t Offset;
+        size_t Size;
+        bool HasLBAFields;
+    };
+
+    EntryLayout GetLayout(ArchiveFormat format) {
+        return format == ArchiveFormat::HD2 ? EntryLayout{ 16, 20, true } : EntryLayout{ 64, 68, false };
+    }
+
+} // namespace
+
+ArchivePatcher::ArchivePatcher(std::string indexPath, std::string dataPath)
+    : indexPath(std::move(indexPath)), dataPath(std::move(dataPath)) {
+    if (this->dataPath.empty()) {
+        this->dataPath = ArchiveExtractor::FindDataFile(this->indexPath);
+        if (this->dataPath.empty()) {
+            throw std::runtime_error("No .dat found next to " + this->indexPath + ".");
+        }
+    }
+}
+
+void ArchivePatcher::Replace(std::string_view memberName, std::vector<uint8_t> data) {
+    replacements.emplace_back(std::string(memberName), std::move(data));
+}
+
+ArchivePatchResult ArchivePatcher::Apply() {
+    auto startTime = std::chrono::steady_clock::now();
+    ArchivePatchResult result;
+
+    // Snapshot everything needed from the mapped index, then release it so both files can be rewritten.
+    ArchiveIndex index;
+    index.Load(indexPath);
+    const ArchiveFormat format = index.GetFormat();
+    const EntryLayout layout = GetLayout(format);
+    const size_t entrySize = index.GetEntrySize();
+    const uint32_t memberCount = static_cast<uint32_t>(index.Size());
+    std::vector<uint8_t> indexBytes(index.GetView().begin(), index.GetView().end());
+
+    std::vector<uint64_t> offsets(memberCount);
+    std::vector<uint32_t> sizes(memberCount);
+    for (uint32_t i = 0; i < memberCount; i++) {
+        offsets[i] = index.GetOffset(i);
+        sizes[i] = index.GetSize(i);
+    }
+
+    // Later replacements of the same member win.
+    std::vector<const std::vector<uint8_t>*> payloads(memberCount, nullptr);
+    for (const auto& [name, data] : replacements) {
+        auto member = index.Find(name);
+        if (!member) {
+            throw std::runtime_error("No such archive member: " + name);
+        }
+        ToUInt32(data.size(), name.c_str());
+        payloads[*member] = &data;
+    }
+    index = ArchiveIndex();
+
+    std::vector<uint32_t> order(memberCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&offsets](uint32_t a, uint32_t b) { return offsets[a] < offsets[b]; });
+
+    const uint64_t dataSize = std::filesystem::file_size(dataPath);
+
+    // A member's slot runs to the next member's offset (or the end of the .dat). Members sharing an
+    // offset share their data, so none of them can be rewritten in place.
+    bool fitsInPlace = true;
+    for (size_t position = 0; position < order.size(); position++) {
+        uint32_t member = order[position];
+        if (!payloads[member]) {
+            continue;
+        }
+        size_t next = position + 1;
+        while (next < order.size() && offsets[order[next]] == offsets[member] && sizes[order[next]] == 0) {
+            next++;
+        }
+        bool shared = (position > 0 && offsets[order[position - 1]] == offsets[member] && sizes[order[position - 1]] > 0) ||
+            (next < order.size() && offsets[order[next]] == offsets[member]);
+        uint64_t slotEnd = next < order.size() ? offsets[order[next]] : dataSize;
+        if (shared || offsets[member] + payloads[member]->size() > slotEnd) {
+            fitsInPlace = false;
+            break;
+        }
+    }
+
+    auto setEntrySize = [&](uint32_t member, uint32_t size) {
+        uint8_t* entry = indexBytes.data() + member * entrySize;
+        PutUInt32(entry + layout.Size, size);
+        if (layout.HasLBAFields) {
+            PutUInt32(entry + 28, static_cast<uint32_t>(AlignUp(size, 2048) / 2048));
+        }
+    };
+
+    if (fitsInPlace) {
+        std::fstream data(dataPath, std::ios::binary | std::ios::in | std::ios::out);
+        std::fstream header(indexPath, std::ios::binary | std::ios::in | std::ios::out);
+        if (!data || !header) {
+            throw std::runtime_error("Failed to open " + indexPath + " and " + dataPath + " for writing.");
+        }
+        for (uint32_t member = 0; member < memberCount; member++) {
+            const std::vector<uint8_t>* payload = payloads[member];
+            if (!payload) {
+                continue;
+            }
+            data.seekp(static_cast<std::streamoff>(offsets[member]));
+            WriteBytes(data, payload->data(), payload->size(), dataPath);
+
+            // Only the size fields change; the offset stays put.
+            setEntrySize(member, static_cast<uint32_t>(payload->size()));
+            size_t fieldsStart = member * entrySize + layout.Size;
+            size_t fieldsEnd = layout.HasLBAFields ? member * entrySize + 32 : fieldsStart + 4;
+            header.seekp(static_cast<std::streamoff>(fieldsStart));
+            WriteBytes(header, indexBytes.data() + fieldsStart, fieldsEnd - fieldsStart, indexPath);
+
+            result.MembersReplaced++;
+            result.BytesWritten += payload->size() + (fieldsEnd - fieldsStart);
+        }
+    }
+    else {
+        // Keep the coarsest alignment every existing member already honours (2048 for sector-aligned archives).
+        uint64_t alignment = 2048;
+        while (alignment > 1 && std::any_of(offsets.begin(), offsets.end(), [alignment](uint64_t o) { return o % alignment != 0; })) {
+            alignment /= 2;
+        }
+
+        auto source = ImageReader::Open(dataPath, ImageBackend::Auto);
+        if (!source) {
+            throw std::runtime_error("Failed to open archive data: " + dataPath);
+        }
+
+        const std::string temporaryDataPath = dataPath + ".tmp";
+        const std::string temporaryIndexPath = indexPath + ".tmp";
+        std::ofstream output(temporaryDataPath, std::ios::binary | std::ios::trunc);
+        if (!output) {
+            throw std::runtime_error("Failed to create " + temporaryDataPath + ".");
+        }
+
+        std::vector<uint8_t> scratch;
+        uint64_t cursor = 0;
+        auto padTo = [&](uint64_t target) {
+            static const uint8_t zeros[2048] = {};
+            while (cursor < target) {
+                size_t length = static_cast<size_t>(std::min<uint64_t>(target - cursor, sizeof(zeros)));
+                WriteBytes(output, zeros, length, temporaryDataPath);
+                cursor += length;
+            }
+        };
+        auto copySource = [&](uint64_t begin, uint64_t end) {
+            for (uint64_t position = begin; position < end; position += CopyBlockSize) {
+                size_t length = static_cast<size_t>(std::min<uint64_t>(end - position, CopyBlockSize));
+                const uint8_t* bytes = source->ReadSpan(position, length, scratch);
+                if (bytes == nullptr) {
+                    throw std::runtime_error("Failed to read " + dataPath + ".");
+                }
+                WriteBytes(output, bytes, length, temporaryDataPath);
+            }
+            cursor += end - begin;
+        };
+
+        // Unchanged members are grouped into runs that move by one common (aligned) delta, so each
+        // run, including the padding between its members, is a single sequential copy.
+        bool inRun = false;
+        uint64_t runBegin = 0;
+        uint64_t runEnd = 0;
+        uint64_t runTarget = 0;
+        auto flushRun = [&]() {
+            if (inRun) {
+                padTo(runTarget);
+                copySource(runBegin, runEnd);
+                inRun = false;
+            }
+        };
+
+        std::vector<uint64_t> newOffsets(memberCount);
+        for (uint32_t member : order) {
+            const std::vector<uint8_t>* payload = payloads[member];
+            if (payload) {
+                flushRun();
+                newOffsets[member] = AlignUp(cursor, alignment);
+                padTo(newOffsets[member]);
+                WriteBytes(output, payload->data(), payload->size(), temporaryDataPath);
+                cursor += payload->size();
+                result.MembersReplaced++;
+                continue;
+            }
+
+            uint64_t begin = offsets[member];
+            uint64_t end = begin + sizes[member];
+            if (end > dataSize) {
+                throw std::runtime_error("Archive member " + std::to_string(member) + " lies outside " + dataPath + ".");
+            }
+            if (inRun && begin >= runBegin) {
+                runEnd = std::max(runEnd, end);
+            }
+            else {
+                flushRun();
+                inRun = true;
+                runBegin = begin;
+                runEnd = end;
+                runTarget = AlignUp(cursor, alignment);
+            }
+            newOffsets[member] = runTarget + (begin - runBegin);
+        }
+        flushRun();
+        padTo(AlignUp(cursor, alignment));
+        output.close();
+        if (!output) {
+            throw std::runtime_error("Failed to write " + temporaryDataPath + ".");
+        }
+        result.BytesWritten += cursor;
+
+        for (uint32_t member = 0; member < memberCount; member++) {
+            uint8_t* entry = indexBytes.data() + member * entrySize;
+            PutUInt32(entry + layout.Offset, ToUInt32(newOffsets[member], "A member offset"));
+            uint32_t size = payloads[member] ? static_cast<uint32_t>(payloads[member]->size()) : sizes[member];
+            setEntrySize(member, size);
+            if (layout.HasLBAFields) {
+                PutUInt32(entry + 24, static_cast<uint32_t>(newOffsets[member] / 2048));
+            }
+        }
+        std::ofstream header(temporaryIndexPath, std::ios::binary | std::ios::trunc);
+        if (!header) {
+            throw std::runtime_error("Failed to create " + temporaryIndexPath + ".");
+        }
+        WriteBytes(header, indexBytes.data(), indexBytes.size(), temporaryIndexPath);
+        header.close();
+        if (!header) {
+            throw std::runtime_error("Failed to write " + temporaryIndexPath + ".");
+        }
+        result.BytesWritten += indexBytes.size();
+
+        // The source mapping must be gone before the originals can be replaced on Windows.
+        source.reset();
+        // The originals are kept as backups until both replacements are in, so a failure part way
+        // through puts back the pair as it was rather than leaving a new .DAT next to the old index.
+        const std::string backupDataPath = dataPath + ".bak";
+        const std::string backupIndexPath = indexPath + ".bak";
+        std::filesystem::rename(dataPath, backupDataPath);
+        try {
+            std::filesystem::rename(indexPath, backupIndexPath);
+            try {
+                std::filesystem::rename(temporaryDataPath, dataPath);
+                std::filesystem::rename(temporaryIndexPath, indexPath);
+            }
+            catch (...) {
+                std::error_code ignored;
+                std::filesystem::rename(backupIndexPath, indexPath, ignored);
+                throw;
+            }
+        }
+        catch (...) {
+            std::error_code ignored;
+            std::filesystem::rename(backupDataPath, dataPath, ignored);
+            throw;
+        }
+        std::filesystem::remove(backupDataPath);
+        std::filesystem::remove(backupIndexPath);
+        result.Repacked = true;
+    }
+
+    result.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    LOG_INFO((result.Repacked ? "Repacked " : "Patched in place ") << dataPath << ": " << result.MembersReplaced
+        << " members replaced, " << result.BytesWritten << " bytes written in " << result.Seconds << " s");
+    return result;
+}
@@ -0,0 +1,40 @@
+#ifndef ARCHIVEPATCHER_H
+#define ARCHIVEPATCHER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct ArchivePatchResult {
+    bool Repacked = false;          // False when every replacement was written into its old slot
+    uint64_t MembersReplaced = 0;
+    uint64_t BytesWritten = 0;      // Data and index bytes written, including copied members on a repack
+    double Seconds = 0.0;
+};
+
+// Replaces members of an HD2/HED-indexed .dat on disk. If every new payload fits in its member's
+// slot (the gap up to the next member), only the payloads and the changed index fields are
+// written. Otherwise the .dat is rebuilt in one sequential pass: runs of unchanged members are
+// copied as single blocks, offsets are recomputed at the archive's existing alignment, and both
+// files are swapped in once complete.
+class ArchivePatcher {
+public:
+    // An empty `dataPath` means the .dat next to the index (see ArchiveExtractor::FindDataFile).
+    ArchivePatcher(std::string indexPath, std::string dataPath = {});
+
+    // Queues a replacement; the archive is untouched until Apply(). Replacing a member twice keeps
+    // the last payload.
+    void Replace(std::string_view memberName, std::vector<uint8_t> data);
+
+    // Throws std::runtime_error if a member is unknown or either file cannot be written.
+    ArchivePatchResult Apply();
+
+private:
+    std::string indexPath;
+    std::string dataPath;
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> replacements;
+};
+
+#endif // ARCHIVEPATCHER_H
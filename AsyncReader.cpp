@@ -0,0 +1,462 @@
+#include "AsyncReader.h"
+#include "Log.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    // Files start on sector boundaries, so the gap between one file and the next is at most the
+    // padding after the first. Reading it costs less than a separate read.
+    constexpr uint64_t MergeGap = 2048;
+
+    const char* GetBackendName(AsyncBackend backend) {
+        switch (backend) {
+        case AsyncBackend::Mapped: return "mapped";
+        case AsyncBackend::IoUring: return "io_uring";
+        default: return "threads";
+        }
+    }
+
+} // namespace
+
+class AsyncReader::Engine {
+public:
+    struct Read {
+        uint8_t* Destination;
+        uint64_t Offset;
+        size_t Length;
+        int64_t Result = 0;     // Bytes read, or a negative error
+        void* Owner;
+    };
+
+    explicit Engine(size_t depth) : depth(depth) {}
+
+    ~Engine() {
+#ifdef __linux__
+        if (sqRing != nullptr) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (cqRing != nullptr && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqes != nullptr) {
+            munmap(sqes, sqesSize);
+        }
+        if (ringFd >= 0) {
+            ::close(ringFd);
+        }
+        if (fileFd >= 0) {
+            ::close(fileFd);
+        }
+#endif
+    }
+
+    // Returns false when io_uring is unavailable (not Linux, an old kernel, or blocked by a
+    // seccomp policy), leaving the engine unchanged.
+    bool OpenUring(const std::string& path) {
+#ifdef __linux__
+        io_uring_params params{};
+        int ring = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(depth), &params));
+        if (ring < 0) {
+            return false;
+        }
+
+        // IORING_OP_READ needs 5.6; the probe itself fails on kernels older than that.
+        alignas(io_uring_probe) uint8_t probeBuffer[sizeof(io_uring_probe) + (IORING_OP_READ + 1) * sizeof(io_uring_probe_op)] = {};
+        auto* probe = reinterpret_cast<io_uring_probe*>(probeBuffer);
+        if (syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, IORING_OP_READ + 1) < 0 ||
+            probe->last_op < IORING_OP_READ || !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)) {
+            ::close(ring);
+            return false;
+        }
+
+        int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0) {
+            ::close(ring);
+            return false;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sq = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        void* cq = singleMap ? sq : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+        void* entries = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+        if (sq == MAP_FAILED || cq == MAP_FAILED || entries == MAP_FAILED) {
+            if (sq != MAP_FAILED) {
+                munmap(sq, sqRingSize);
+            }
+            if (cq != MAP_FAILED && cq != sq) {
+                munmap(cq, cqRingSize);
+            }
+            if (entries != MAP_FAILED) {
+                munmap(entries, sqesSize);
+            }
+            ::close(file);
+            ::close(ring);
+            return false;
+        }
+
+        ringFd = ring;
+        fileFd = file;
+        sqRing = static_cast<uint8_t*>(sq);
+        cqRing = static_cast<uint8_t*>(cq);
+        sqes = static_cast<io_uring_sqe*>(entries);
+        sqTail = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+        // The kernel may round the ring up, never down.
+        depth = std::min<size_t>(depth, params.sq_entries);
+        return true;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    void OpenThreads(ImageReader& imageReader) {
+        reader = &imageReader;
+        completions = std::make_unique<MpmcQueue<Read*>>(depth);
+        pool = std::make_unique<WorkerPool>(depth);
+    }
+
+    size_t GetDepth() const { return depth; }
+
+    // At most GetDepth() reads may be outstanding.
+    void Issue(Read* read) {
+        Metrics::Add(Counter::Reads);
+        Metrics::Add(Counter::BytesRead, read->Length);
+        if (pool) {
+            pool->Submit([this, read] {
+                try {
+                    read->Result = reader->Read(read->Offset, read->Destination, read->Length) ? static_cast<int64_t>(read->Length) : -EIO;
+                }
+                catch (const std::exception&) {
+                    read->Result = -EIO;
+                }
+                completions->Push(read);
+            });
+            return;
+        }
+#ifdef __linux__
+        // Only this thread touches the tail; the kernel reads it after the release store.
+        unsigned tail = *sqTail;
+        unsigned index = tail & sqMask;
+        io_uring_sqe& entry = sqes[index];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.opcode = IORING_OP_READ;
+        entry.fd = fileFd;
+        entry.off = read->Offset;
+        entry.addr = reinterpret_cast<uint64_t>(read->Destination);
+        entry.len = static_cast<uint32_t>(read->Length);
+        entry.user_data = reinterpret_cast<uint64_t>(read);
+        sqArray[index] = index;
+        std::atomic_ref<unsigned>(*sqTail).store(tail + 1, std::memory_order_release);
+        unsubmitted++;
+#endif
+    }
+
+    // Submits what Issue() queued, waits for at least one read to finish and appends all finished
+    // reads to `completed`.
+    void Wait(std::vector<Read*>& completed) {
+        if (pool) {
+            Read* read;
+            completions->Pop(read);
+            completed.push_back(read);
+            while (completions->TryPop(read)) {
+                completed.push_back(read);
+            }
+            return;
+        }
+#ifdef __linux__
+        for (;;) {
+            int result = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, unsubmitted, 1u, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (result >= 0) {
+                unsubmitted -= static_cast<unsigned>(result);
+                break;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+            }
+        }
+        unsigned head = *cqHead;
+        unsigned tail = std::atomic_ref<unsigned>(*cqTail).load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            const io_uring_cqe& entry = cqes[head & cqMask];
+            Read* read = reinterpret_cast<Read*>(entry.user_data);
+            read->Result = entry.res;
+            completed.push_back(read);
+        }
+        std::atomic_ref<unsigned>(*cqHead).store(head, std::memory_order_release);
+#endif
+    }
+
+private:
+    size_t depth;
+
+    ImageReader* reader = nullptr;
+    std::unique_ptr<MpmcQueue<Read*>> completions;
+    std::unique_ptr<WorkerPool> pool;
+
+#ifdef __linux__
+    int ringFd = -1;
+    int fileFd = -1;
+    uint8_t* sqRing = nullptr;
+    uint8_t* cqRing = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned unsubmitted = 0;
+#endif
+};
+
+AsyncReader::AsyncReader(ImageReader& reader, std::string path, AsyncReadOptions options)
+    : reader(reader), path(std::move(path)), options(options) {
+    this->options.QueueDepth = std::max<size_t>(1, options.QueueDepth);
+    this->options.ReadBytes = std::max<size_t>(4096, options.ReadBytes);
+    this->options.MaxBytesInFlight = std::max<uint64_t>(1, options.MaxBytesInFlight);
+    budget = std::make_shared<ByteBudget>(this->options.MaxBytesInFlight);
+
+    if (reader.Data() != nullptr) {
+        backend = AsyncBackend::Mapped;
+        return;
+    }
+    engine = std::make_unique<Engine>(this->options.QueueDepth);
+    if (options.UseIoUring && reader.ReadsFileDirectly() && engine->OpenUring(this->path)) {
+        backend = AsyncBackend::IoUring;
+    }
+    else {
+        engine->OpenThreads(reader);
+        backend = AsyncBackend::Threads;
+    }
+}
+
+AsyncReader::~AsyncReader() {
+    closing = true;
+    if (pipeline.joinable()) {
+        // Undelivered data still counts against the budget the pipeline may be waiting on.
+        while (!finished) {
+            Delivery delivery;
+            deliveries->Pop(delivery);
+            finished = delivery.Type != Delivery::Kind::Data;
+        }
+        pipeline.join();
+    }
+}
+
+void AsyncReader::Start(std::vector<AsyncReadRequest> newRequests) {
+    if (pipeline.joinable() || !requests.empty()) {
+        throw std::logic_error("AsyncReader::Start called twice.");
+    }
+    requests = std::move(newRequests);
+    std::stable_sort(requests.begin(), requests.end(), [](const AsyncReadRequest& a, const AsyncReadRequest& b) { return a.Offset < b.Offset; });
+
+    // No buffer may outgrow the budget, or it could never be admitted without breaking the cap.
+    const uint64_t mergeLimit = std::min(options.MergeBytes, options.MaxBytesInFlight);
+    for (size_t i = 0; i < requests.size(); i++) {
+        const AsyncReadRequest& request = requests[i];
+        if (request.Length > options.MaxBytesInFlight) {
+            throw std::logic_error("AsyncReader request larger than MaxBytesInFlight.");
+        }
+        uint64_t end = request.Offset + request.Length;
+        if (!batches.empty()) {
+            Batch& batch = batches.back();
+            uint64_t batchEnd = batch.Offset + batch.Length;
+            // Nested requests (archive members inside their .DAT) never grow the batch.
+            bool nested = end <= batchEnd;
+            bool adjacent = request.Offset <= batchEnd + MergeGap && end - batch.Offset <= mergeLimit;
+            if (nested || adjacent) {
+                batch.Length = std::max(batchEnd, end) - batch.Offset;
+                batch.RequestCount++;
+                continue;
+            }
+        }
+        batches.push_back({ request.Offset, request.Length, i, 1 });
+    }
+
+    LOG_DEBUG("Async reads: " << requests.size() << " requests in " << batches.size() << " buffers, "
+        << GetBackendName(backend) << " backend, queue depth " << options.QueueDepth);
+    if (backend != AsyncBackend::Mapped) {
+        deliveries = std::make_unique<MpmcQueue<Delivery>>(requests.size() + 1);
+        pipeline = std::thread(&AsyncReader::Run, this);
+    }
+}
+
+bool AsyncReader::Next(AsyncReadResult& result) {
+    // Let go of the previous result's buffer before waiting for the next one.
+    result = AsyncReadResult();
+    if (finished) {
+        return false;
+    }
+    if (backend == AsyncBackend::Mapped) {
+        if (nextRequest == requests.size()) {
+            finished = true;
+            return false;
+        }
+        const AsyncReadRequest& request = requests[nextRequest++];
+        result.Tag = request.Tag;
+        result.Data = reader.View(request.Offset, static_cast<size_t>(request.Length));
+        return true;
+    }
+
+    Delivery delivery;
+    deliveries->Pop(delivery);
+    if (delivery.Type != Delivery::Kind::Data) {
+        finished = true;
+        if (delivery.Type == Delivery::Kind::Failed) {
+            throw std::runtime_error("Failed to read from image.");
+        }
+        return false;
+    }
+    result = std::move(delivery.Result);
+    return true;
+}
+
+void AsyncReader::Run() {
+    struct Active {
+        const Batch* Source;
+        std::shared_ptr<std::vector<uint8_t>> Buffer;
+        std::vector<Engine::Read> Reads;
+        size_t Issued = 0;
+        size_t Outstanding = 0;
+        bool Failed = false;
+    };
+
+    // Batches being read, oldest first. A deque never moves its elements, so reads can point at them.
+    std::deque<Active> window;
+    std::vector<Engine::Read*> completed;
+    size_t nextBatch = 0;
+    size_t inFlight = 0;
+    bool failed = false;
+
+    try {
+        while (!closing) {
+            // Keep the queue full, opening the next batch once the previous one is all issued.
+            while (!failed && inFlight < engine->GetDepth()) {
+                if (window.empty() || window.back().Issued == window.back().Reads.size()) {
+                    if (nextBatch == batches.size()) {
+                        break;
+                    }
+                    const Batch& batch = batches[nextBatch];
+                    // With nothing of ours in flight, wait for the consumers to let go of enough.
+                    if (!budget->TryAcquire(batch.Length)) {
+                        if (!window.empty()) {
+                            break;
+                        }
+                        budget->Acquire(batch.Length);
+                    }
+                    nextBatch++;
+
+                    Active& active = window.emplace_back();
+                    active.Source = &batch;
+                    uint64_t length = batch.Length;
+                    active.Buffer = std::shared_ptr<std::vector<uint8_t>>(new std::vector<uint8_t>(static_cast<size_t>(length)),
+                        [budget = budget, length](std::vector<uint8_t>* buffer) {
+                            delete buffer;
+                            budget->Release(length);
+                        });
+                    for (uint64_t position = 0; position < length; position += options.ReadBytes) {
+                        size_t readLength = static_cast<size_t>(std::min<uint64_t>(options.ReadBytes, length - position));
+                        active.Reads.push_back({ active.Buffer->data() + position, batch.Offset + position, readLength, 0, &active });
+                    }
+                    active.Outstanding = active.Reads.size();
+                    continue;
+                }
+                Active& active = window.back();
+                engine->Issue(&active.Reads[active.Issued++]);
+                inFlight++;
+            }
+
+            // Hand finished batches to the consumers, in order.
+            while (!failed && !window.empty() && window.front().Issued == window.front().Reads.size() && window.front().Outstanding == 0) {
+                Active& active = window.front();
+                if (active.Failed) {
+                    failed = true;
+                    break;
+                }
+                for (size_t i = 0; i < active.Source->RequestCount; i++) {
+                    const AsyncReadRequest& request = requests[active.Source->FirstRequest + i];
+                    Delivery delivery;
+                    delivery.Result.Tag = request.Tag;
+                    delivery.Result.Data = FileView(active.Buffer, static_cast<size_t>(request.Offset - active.Source->Offset), static_cast<size_t>(request.Length));
+                    deliveries->Push(std::move(delivery));
+                }
+                window.pop_front();
+            }
+
+            if (inFlight == 0) {
+                if (failed || (window.empty() && nextBatch == batches.size())) {
+                    break;
+                }
+                // Only empty batches were opened; nothing to wait for.
+                continue;
+            }
+
+            completed.clear();
+            engine->Wait(completed);
+            for (Engine::Read* read : completed) {
+                inFlight--;
+                Active& owner = *static_cast<Active*>(read->Owner);
+                if (read->Result > 0 && static_cast<size_t>(read->Result) < read->Length) {
+                    // Short read: ask again for the rest.
+                    read->Destination += read->Result;
+                    read->Offset += static_cast<uint64_t>(read->Result);
+                    read->Length -= static_cast<size_t>(read->Result);
+                    engine->Issue(read);
+                    inFlight++;
+                    continue;
+                }
+                if (read->Result <= 0) {
+                    owner.Failed = true;
+                }
+                owner.Outstanding--;
+            }
+        }
+
+        // Buffers may not be freed under reads still in progress.
+        while (inFlight > 0) {
+            completed.clear();
+            engine->Wait(completed);
+            inFlight -= completed.size();
+        }
+    }
+    catch (const std::exception& ex) {
+        LOG_ERROR("Async read pipeline failed: " << ex.what());
+        failed = true;
+        if (inFlight > 0) {
+            // The kernel may still write into these; leak them rather than hand the memory back.
+            new std::deque<Active>(std::move(window));
+        }
+    }
+
+    Delivery last;
+    last.Type = failed ? Delivery::Kind::Failed : Delivery::Kind::End;
+    deliveries->Push(std::move(last));
+}
@@ -0,0 +1,106 @@
+#ifndef ASYNCREADER_H
+#define ASYNCREADER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileView.h"
+#include "ImageReader.h"
+#include "MpmcQueue.h"
+#include "WorkerPool.h"
+
+enum class AsyncBackend {
+    Mapped,     // Views straight into the mapping; consumers fault the pages in, in parallel
+    IoUring,    // Reads queued to the kernel through io_uring (Linux, plain image files)
+    Threads     // Blocking reads on a pool of QueueDepth threads
+};
+
+struct AsyncReadOptions {
+    size_t QueueDepth = 16;                         // Reads kept in flight
+    size_t ReadBytes = 1024 * 1024;                 // Largest single read
+    uint64_t MergeBytes = 4ull * 1024 * 1024;       // Neighbouring requests share one buffer up to this size
+    uint64_t MaxBytesInFlight = 256ull * 1024 * 1024; // Hard cap on buffers read but not yet released
+    bool UseIoUring = true;                         // false uses the thread pool even where io_uring works
+};
+
+struct AsyncReadRequest {
+    uint64_t Offset;
+    uint64_t Length;
+    uint64_t Tag;       // Handed back with the data
+};
+
+struct AsyncReadResult {
+    uint64_t Tag = 0;
+    FileView Data;
+};
+
+// Reads a known set of image ranges ahead of the code consuming them. Requests are sorted into
+// offset order, and requests that are adjacent (or no more than a sector apart, or nested inside
+// one another) are merged into one buffer of up to MergeBytes, or MaxBytesInFlight if smaller.
+// Each buffer is read with reads of up to ReadBytes, QueueDepth of them in flight at a time, by a
+// pipeline thread that passes the finished requests to consumers through a lock-free queue, still
+// in offset order.
+//
+// A buffer counts against MaxBytesInFlight until every view into it has been dropped, so
+// consumers bound memory simply by letting go of the data once it has been written or hashed.
+// Data must be let go of without waiting on Next(), or the pipeline can stall on the budget.
+class AsyncReader {
+public:
+    // `path` is the file behind `reader`; io_uring reads it directly when the reader serves the
+    // file's bytes unchanged. `reader` must outlive this object.
+    AsyncReader(ImageReader& reader, std::string path, AsyncReadOptions options = {});
+    ~AsyncReader();
+
+    AsyncReader(const AsyncReader&) = delete;
+    AsyncReader& operator=(const AsyncReader&) = delete;
+
+    // Starts reading. Call once. No request may be longer than MaxBytesInFlight; split larger
+    // ranges into chunks.
+    void Start(std::vector<AsyncReadRequest> requests);
+    // Blocks until the next request in offset order is read. Returns false once every request
+    // has been returned. Throws std::runtime_error if a read failed.
+    bool Next(AsyncReadResult& result);
+
+    AsyncBackend GetBackend() const { return backend; }
+    uint64_t GetPeakBytesInFlight() const { return budget->GetPeak(); }
+
+private:
+    // Issues single reads and reports them done: through io_uring or on a thread pool.
+    class Engine;
+
+    struct Delivery {
+        enum class Kind { Data, End, Failed };
+
+        Kind Type = Kind::Data;
+        AsyncReadResult Result;
+    };
+
+    struct Batch {
+        uint64_t Offset;
+        uint64_t Length;
+        size_t FirstRequest;    // Range of `requests` served from this batch
+        size_t RequestCount;
+    };
+
+    void Run();
+
+    ImageReader& reader;
+    std::string path;
+    AsyncReadOptions options;
+    AsyncBackend backend;
+    std::vector<AsyncReadRequest> requests;
+    std::vector<Batch> batches;
+    size_t nextRequest = 0;     // Mapped backend: next request to hand out
+    bool finished = false;
+    std::shared_ptr<ByteBudget> budget;
+    std::unique_ptr<Engine> engine;
+    std::unique_ptr<MpmcQueue<Delivery>> deliveries;
+    std::atomic<bool> closing{ false };
+    std::thread pipeline;
+};
+
+#endif // ASYNCREADER_H
@@ -0,0 +1,381 @@
+#include "ISO.h"
+#include "Extractor.h"
+#include "Log.h"
+#include "SyntheticISO.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Generates synthetic images of several shapes and times the parser against them. Every result
+// is one JSON object per line on stdout; timings are the median (and minimum) over --iterations.
+
+namespace {
+
+    struct Options {
+        bool Quick = false;
+        bool Keep = false;
+        bool Stress = false;
+        int Iterations = 5;
+        unsigned Threads = 8;
+        std::vector<std::string> Shapes;
+        std::filesystem::path WorkDirectory = std::filesystem::temp_directory_path() / "dcfm-bench";
+    };
+
+    struct Result {
+        std::string Shape;
+        std::string Benchmark;
+        std::string Backend;
+        std::vector<double> Milliseconds;
+        uint64_t Items = 0;
+        uint64_t Bytes = 0;
+    };
+
+    double Median(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+    }
+
+    void Print(const Result& result) {
+        double median = Median(result.Milliseconds);
+        double minimum = *std::min_element(result.Milliseconds.begin(), result.Milliseconds.end());
+        double seconds = median / 1000.0;
+
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(3)
+            << "{\"shape\": \"" << result.Shape << "\""
+            << ", \"benchmark\": \"" << result.Benchmark << "\""
+            << ", \"backend\": \"" << result.Backend << "\""
+            << ", \"iterations\": " << result.Milliseconds.size()
+            << ", \"median_ms\": " << median
+            << ", \"min_ms\": " << minimum
+            << ", \"items\": " << result.Items
+            << ", \"bytes\": " << result.Bytes
+            << ", \"items_per_second\": " << (seconds > 0.0 ? result.Items / seconds : 0.0)
+            << ", \"megabytes_per_second\": " << (seconds > 0.0 ? result.Bytes / (1024.0 * 1024.0) / seconds : 0.0)
+            << "}";
+        std::cout << line.str() << std::endl;
+    }
+
+    // Runs `body` once to warm up, then `iterations` timed times.
+    std::vector<double> Time(int iterations, const std::function<void()>& body) {
+        body();
+        std::vector<double> milliseconds;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            milliseconds.push_back(std::chrono::duration<double, std::milli>(elapsed).count());
+        }
+        return milliseconds;
+    }
+
+    const char* BackendName(ImageBackend backend) {
+        return backend == ImageBackend::Mapped ? "mapped" : "positional";
+    }
+
+    std::unique_ptr<ISO> Load(const std::string& path, ImageBackend backend, bool useCache) {
+        auto iso = std::make_unique<ISO>(path, backend);
+        iso->SetIndexCacheEnabled(useCache);
+        iso->LoadISO();
+        return iso;
+    }
+
+    void RunShape(const std::string& shape, const Options& options) {
+        uint32_t scale = options.Quick ? 50 : 1;
+        std::string imagePath = (options.WorkDirectory / (shape + ".iso")).string();
+        std::filesystem::remove(imagePath + ".dcfmidx");
+
+        SyntheticISO synthetic = SyntheticISO::CreateShape(shape, scale);
+        auto start = std::chrono::steady_clock::now();
+        synthetic.Write(imagePath);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        Print({ shape, "generate", "none", { std::chrono::duration<double, std::milli>(elapsed).count() },
+            synthetic.GetFileCount() + synthetic.GetDirectoryCount(), std::filesystem::file_size(imagePath) });
+
+        uint64_t entryCount = synthetic.GetFileCount() + synthetic.GetDirectoryCount();
+        for (ImageBackend backend : { ImageBackend::Mapped, ImageBackend::Positional }) {
+            Print({ shape, "load", BackendName(backend),
+                Time(options.Iterations, [&] { Load(imagePath, backend, false); }), entryCount, 0 });
+        }
+
+        // The warm-up run writes the sidecar cache; the timed runs load from it.
+        Print({ shape, "load_cached", "mapped",
+            Time(options.Iterations, [&] { Load(imagePath, ImageBackend::Mapped, true); }), entryCount, 0 });
+        std::filesystem::remove(imagePath + ".dcfmidx");
+
+        auto iso = Load(imagePath, ImageBackend::Mapped, false);
+        const FileIndex& index = iso->GetIndex();
+
+        std::vector<std::string> paths;
+        paths.reserve(index.Size());
+        for (uint32_t id = 1; id < index.Size(); id++) {
+            paths.push_back(index.GetPath(id, '/'));
+        }
+        Print({ shape, "lookup", "mapped", Time(options.Iterations, [&] {
+            for (const auto& path : paths) {
+                if (!iso->Find(path)) {
+                    throw std::runtime_error("Lookup failed: " + path);
+                }
+            }
+        }), paths.size(), 0 });
+
+        // What the list view does for every folder: children, display names and sizes.
+        uint64_t listed = 0;
+        auto listTimes = Time(options.Iterations, [&] {
+            listed = 0;
+            size_t nameLength = 0;
+            for (uint32_t id = 0; id < index.Size(); id++) {
+                if (!index.IsDirectory(id)) {
+                    continue;
+                }
+                for (uint32_t child : index.GetChildren(id)) {
+                    nameLength += std::wcslen(index.GetDisplayName(child)) + index.GetSize(child);
+                    listed++;
+                }
+            }
+            if (nameLength == 0) {
+                throw std::runtime_error("Empty listing.");
+            }
+        });
+        Print({ shape, "list", "mapped", listTimes, listed, 0 });
+
+        Print({ shape, "iterate", "mapped", Time(options.Iterations, [&] {
+            uint64_t totalSize = 0;
+            std::vector<uint32_t> stack = { FileIndex::RootId };
+            while (!stack.empty()) {
+                uint32_t id = stack.back();
+                stack.pop_back();
+                totalSize += index.GetSize(id);
+                for (uint32_t child : index.GetChildren(id)) {
+                    stack.push_back(child);
+                }
+            }
+            if (totalSize == 0) {
+                throw std::runtime_error("Empty tree.");
+            }
+        }), index.Size(), 0 });
+
+        // Reads every file in extent order and touches each page, so mapped views are faulted in too.
+        for (ImageBackend backend : { ImageBackend::Mapped, ImageBackend::Positional }) {
+            auto reader = Load(imagePath, backend, false);
+            Print({ shape, "read", BackendName(backend), Time(options.Iterations, [&] {
+                uint8_t checksum = 0;
+                for (uint32_t id : index.GetLBAOrder()) {
+                    if (index.IsDirectory(id)) {
+                        continue;
+                    }
+                    FileView view = reader->GetFileView(id);
+                    for (size_t offset = 0; offset < view.Size(); offset += 4096) {
+                        checksum ^= view.Data()[offset];
+                    }
+                }
+                volatile uint8_t sink = checksum;
+                (void)sink;
+            }), synthetic.GetFileCount(), synthetic.GetTotalFileBytes() });
+        }
+
+        std::filesystem::path outputDirectory = options.WorkDirectory / (shape + "-out");
+        ExtractionStats stats;
+        Print({ shape, "extract", "mapped", Time(std::min(options.Iterations, 3), [&] {
+            std::filesystem::remove_all(outputDirectory);
+            Extractor extractor(*iso);
+            stats = extractor.ExtractAll(outputDirectory);
+        }), synthetic.GetFileCount(), synthetic.GetTotalFileBytes() });
+        if (stats.Files != synthetic.GetFileCount()) {
+            throw std::runtime_error("Extraction wrote " + std::to_string(stats.Files) + " files, expected " +
+                std::to_string(synthetic.GetFileCount()) + ".");
+        }
+        std::filesystem::remove_all(outputDirectory);
+
+        iso.reset();
+        if (!options.Keep) {
+            std::filesystem::remove(imagePath);
+        }
+    }
+
+    // Hammers one ISO from several threads at once: file reads through ReadFileData and
+    // GetFileView, first use of the record maps, and fresh directory parses over the same reader.
+    // Every result is checked against a single-threaded pass, under both backends.
+    void RunStress(const Options& options) {
+        std::string imagePath = (options.WorkDirectory / "stress.iso").string();
+        SyntheticISO synthetic = SyntheticISO::CreateShape("multisector", 50);
+        synthetic.Write(imagePath);
+
+        for (ImageBackend backend : { ImageBackend::Mapped, ImageBackend::Positional }) {
+            auto iso = Load(imagePath, backend, false);
+            const FileIndex& index = iso->GetIndex();
+
+            std::vector<std::string> paths(index.Size());
+            std::vector<std::string> recordPaths(index.Size());
+            std::vector<std::vector<uint8_t>> contents(index.Size());
+            for (uint32_t id = 1; id < index.Size(); id++) {
+                paths[id] = index.GetPath(id, '/');
+                recordPaths[id] = iso->GetRootFolderName() + "\\" + index.GetPath(id);
+                if (!index.IsDirectory(id)) {
+                    contents[id] = iso->GetFileView(id).ToVector();
+                }
+            }
+            // Loaded after the reference pass, so the threads race to build the record maps.
+            auto shared = Load(imagePath, backend, false);
+
+            std::atomic<uint64_t> bytesChecked{ 0 };
+            std::atomic<uint64_t> mismatches{ 0 };
+            auto fail = [&](const std::string& what) {
+                if (mismatches.fetch_add(1) == 0) {
+                    std::cerr << "dcfm-bench: " << BackendName(backend) << ": " << what << std::endl;
+                }
+            };
+            auto hammer = [&](unsigned thread) {
+                try {
+                    // Each thread starts at a different file so they do not move in lockstep.
+                    uint32_t count = static_cast<uint32_t>(index.Size());
+                    for (uint32_t step = 1; step < count; step++) {
+                        uint32_t id = 1 + (step + thread * 997) % (count - 1);
+                        if (index.IsDirectory(id)) {
+                            continue;
+                        }
+                        const std::vector<uint8_t>& expected = contents[id];
+                        FileView view = shared->GetFileView(id);
+                        if (view.Size() != expected.size() || std::memcmp(view.Data(), expected.data(), expected.size()) != 0) {
+                            fail("GetFileView differs for " + paths[id]);
+                        }
+                        if (!expected.empty()) {
+                            size_t offset = (id * 131 + thread) % expected.size();
+                            size_t length = std::min<size_t>(expected.size() - offset, 3000);
+                            FileView slice = shared->GetFileView(id, offset, length);
+                            if (std::memcmp(slice.Data(), expected.data() + offset, length) != 0) {
+                                fail("GetFileView slice differs for " + paths[id]);
+                            }
+                        }
+                        if (step % 8 == thread % 8) {
+                            auto record = shared->GetFileRecords().find(recordPaths[id]);
+                            if (record == shared->GetFileRecords().end() || shared->ReadFileData(record->second) != expected) {
+                                fail("ReadFileData differs for " + paths[id]);
+                            }
+                        }
+                        bytesChecked += expected.size();
+                    }
+
+                    // A second ISO parsing the directories through the same reader.
+                    ISO parsed(imagePath, shared->GetReader());
+                    parsed.SetIndexCacheEnabled(false);
+                    parsed.LoadISO();
+                    const FileIndex& parsedIndex = parsed.GetIndex();
+                    if (parsedIndex.Size() != count) {
+                        fail("Directory parse found " + std::to_string(parsedIndex.Size()) + " entries");
+                        return;
+                    }
+                    for (uint32_t id = 1; id < count; id++) {
+                        if (parsedIndex.GetPath(id, '/') != paths[id] || parsedIndex.GetLBA(id) != index.GetLBA(id) ||
+                            parsedIndex.GetSize(id) != index.GetSize(id)) {
+                            fail("Directory parse differs at " + paths[id]);
+                            return;
+                        }
+                    }
+                }
+                catch (const std::exception& ex) {
+                    fail(ex.what());
+                }
+            };
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (unsigned thread = 0; thread < options.Threads; thread++) {
+                threads.emplace_back(hammer, thread);
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            if (mismatches > 0) {
+                throw std::runtime_error(std::to_string(mismatches.load()) + " concurrent reads differed from the reference.");
+            }
+            Print({ "stress", "concurrent_read", BackendName(backend), { std::chrono::duration<double, std::milli>(elapsed).count() },
+                synthetic.GetFileCount() * options.Threads, bytesChecked.load() });
+        }
+
+        if (!options.Keep) {
+            std::filesystem::remove(imagePath);
+        }
+    }
+
+    void PrintUsage() {
+        std::cerr <<
+            "Usage: dcfm-bench [--quick] [--iterations N] [--shape NAME]... [--work-dir DIR] [--keep]\n"
+            "       dcfm-bench --stress [--threads N] [--work-dir DIR] [--keep]\n"
+            "\n"
+            "Shapes: deep, wide, multisector, tiny, large (default: all)\n"
+            "  --quick        Scale every shape down (seconds instead of minutes, small disk use)\n"
+            "  --keep         Leave the generated images in the work directory\n"
+            "  --stress       Read one image from N threads (default: 8) and check every byte; exits 1 on a mismatch\n";
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Log::SetAllToStderr(true);
+    Log::SetLevel(LogLevel::Warning);
+
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--quick") {
+            options.Quick = true;
+        }
+        else if (argument == "--keep") {
+            options.Keep = true;
+        }
+        else if (argument == "--stress") {
+            options.Stress = true;
+        }
+        else if (argument == "--threads" && hasValue) {
+            options.Threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (argument == "--iterations" && hasValue) {
+            options.Iterations = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (argument == "--shape" && hasValue) {
+            options.Shapes.push_back(argv[++i]);
+        }
+        else if (argument == "--work-dir" && hasValue) {
+            options.WorkDirectory = argv[++i];
+        }
+        else {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (options.Shapes.empty()) {
+        options.Shapes = SyntheticISO::GetShapeNames();
+    }
+
+    try {
+        std::filesystem::create_directories(options.WorkDirectory);
+        if (options.Stress) {
+            RunStress(options);
+            return 0;
+        }
+        for (const auto& shape : options.Shapes) {
+            RunShape(shape, options);
+        }
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "dcfm-bench: " << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -2,7 +2,6 @@
 #define BOTHENDIANUINT16_H
 
 #include <cstdint>
-#include <intrin.h> // Use for _byteswap_ushort
 
 struct BothEndianUInt16 {
     uint16_t LittleEndian;
@@ -14,7 +13,8 @@ struct BothEndianUInt16 {
 
     void SetValue(uint16_t value) {
         LittleEndian = value;
-        BigEndian = _byteswap_ushort(value); // Use built-in function for byte swap
+        // Portable byte swap; compiles to a single rotate.
+        BigEndian = static_cast<uint16_t>((value >> 8) | (value << 8));
     }
 };
 
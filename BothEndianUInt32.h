@@ -2,7 +2,6 @@
 #define BOTHENDIANUINT32_H
 
 #include <cstdint>
-#include <intrin.h> // Use for _byteswap_ulong
 
 struct BothEndianUInt32 {
     uint32_t LittleEndian;
@@ -14,7 +13,8 @@ struct BothEndianUInt32 {
 
     void SetValue(uint32_t value) {
         LittleEndian = value;
-        BigEndian = _byteswap_ulong(value); // Use built-in function for byte swap
+        // Portable byte swap; MSVC, GCC and Clang all compile this to a single bswap.
+        BigEndian = (value >> 24) | ((value >> 8) & 0x0000FF00) | ((value << 8) & 0x00FF0000) | (value << 24);
     }
 };
 
@@ -1,5 +1,6 @@
 #include "Bytes.h"
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 
 namespace Bytes {
@@ -41,4 +42,32 @@ namespace Bytes {
         return *reinterpret_cast<uint16_t*>(bytes);
     }
 
+    uint32_t ReadUInt32(const uint8_t* data) {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint16_t ReadUInt16(const uint8_t* data) {
+        uint16_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint32_t ReadUInt32BigEndian(const uint8_t* data) {
+        return ReverseUInt32(ReadUInt32(data));
+    }
+
+    uint16_t ReadUInt16BigEndian(const uint8_t* data) {
+        return ReverseUInt16(ReadUInt16(data));
+    }
+
+    uint64_t HashFnv1a64(const uint8_t* data, size_t length) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++) {
+            hash = (hash ^ data[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
 } // namespace Bytes
\ No newline at end of file
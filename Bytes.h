@@ -13,6 +13,13 @@ namespace Bytes {
     uint32_t ReadUInt32BigEndian(std::ifstream& stream);
     uint16_t ReadUInt16BigEndian(std::ifstream& stream);
 
+    uint32_t ReadUInt32(const uint8_t* data);
+    uint16_t ReadUInt16(const uint8_t* data);
+    uint32_t ReadUInt32BigEndian(const uint8_t* data);
+    uint16_t ReadUInt16BigEndian(const uint8_t* data);
+
+    uint64_t HashFnv1a64(const uint8_t* data, size_t length);
+
 } // namespace Bytes
 
 #endif // BYTES_H
\ No newline at end of file
@@ -0,0 +1,399 @@
+#include "Checksum.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DCFM_CHECKSUM_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DCFM_TARGET(features)
+#else
+#include <cpuid.h>
+#define DCFM_TARGET(features) __attribute__((target(features)))
+#endif
+#endif
+
+namespace {
+
+    using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+    // Table 0 is the classic byte-at-a-time table for a reflected polynomial; table k advances a
+    // byte through k further zero bytes, so eight lookups fold in eight input bytes.
+    constexpr CrcTables MakeCrcTables(uint32_t polynomial) {
+        CrcTables tables{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (polynomial & (0u - (crc & 1u)));
+            }
+            tables[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (size_t k = 1; k < 8; k++) {
+                tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+            }
+        }
+        return tables;
+    }
+
+    constexpr CrcTables Crc32Table = MakeCrcTables(0xEDB88320u);
+    constexpr CrcTables EdcTable = MakeCrcTables(0xD8018001u);
+
+    // Multiplier constants for folding with carry-less multiplies: x^(4*128+32), x^(4*128-32),
+    // x^(128+32), x^(128-32) and x^64 modulo the polynomial, then the polynomial itself and
+    // floor(x^64 / polynomial) for the Barrett reduction, all bit-reflected to 33 bits.
+    struct FoldConstants {
+        int64_t K1, K2, K3, K4, K5, Polynomial, Mu;
+    };
+
+    constexpr FoldConstants Crc32Fold = { 0x0154442bd4, 0x01c6e41596, 0x01751997d0, 0x00ccaa009e, 0x0163cd6124, 0x01db710641, 0x01f7011641 };
+    constexpr FoldConstants EdcFold = { 0x01f8931102, 0x012e7928a2, 0x006c90c100, 0x01d5934102, 0x01f1030002, 0x01b0030003, 0x017000ffff };
+
+    uint32_t LoadLE32(const uint8_t* data) {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    uint32_t LoadBE32(const uint8_t* data) {
+        return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+    }
+
+    uint32_t RotateLeft(uint32_t value, int bits) {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    // Works on the raw CRC register; any inversion is the caller's.
+    uint32_t CrcSliced(const CrcTables& table, const uint8_t* data, size_t length, uint32_t crc) {
+        while (length >= 8) {
+            uint32_t low = LoadLE32(data) ^ crc;
+            uint32_t high = LoadLE32(data + 4);
+            crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+                table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+                table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+                table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+            data += 8;
+            length -= 8;
+        }
+        while (length-- > 0) {
+            crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+        }
+        return crc;
+    }
+
+    void Sha1BlocksScalar(uint32_t state[5], const uint8_t* data, size_t blocks) {
+        for (; blocks > 0; blocks--, data += 64) {
+            uint32_t w[80];
+            for (int i = 0; i < 16; i++) {
+                w[i] = LoadBE32(data + i * 4);
+            }
+            for (int i = 16; i < 80; i++) {
+                w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+            // One loop per round function keeps the rounds branch-free.
+            auto step = [&](uint32_t f, uint32_t k, uint32_t word) {
+                uint32_t temp = RotateLeft(a, 5) + f + e + k + word;
+                e = d;
+                d = c;
+                c = RotateLeft(b, 30);
+                b = a;
+                a = temp;
+            };
+            for (int i = 0; i < 20; i++) {
+                step(d ^ (b & (c ^ d)), 0x5A827999u, w[i]);
+            }
+            for (int i = 20; i < 40; i++) {
+                step(b ^ c ^ d, 0x6ED9EBA1u, w[i]);
+            }
+            for (int i = 40; i < 60; i++) {
+                step((b & c) | (d & (b | c)), 0x8F1BBCDCu, w[i]);
+            }
+            for (int i = 60; i < 80; i++) {
+                step(b ^ c ^ d, 0xCA62C1D6u, w[i]);
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    }
+
+#ifdef DCFM_CHECKSUM_X86
+    struct CpuFeatures {
+        bool Pclmul = false;    // PCLMULQDQ and SSE4.1
+        bool Sha = false;       // SHA extensions, SSSE3 and SSE4.1
+    };
+
+    CpuFeatures DetectCpuFeatures() {
+        unsigned int leaf1[4] = {};
+        unsigned int leaf7[4] = {};
+#ifdef _MSC_VER
+        int registers[4];
+        __cpuid(registers, 0);
+        unsigned int maxLeaf = static_cast<unsigned int>(registers[0]);
+        __cpuid(registers, 1);
+        std::memcpy(leaf1, registers, sizeof(leaf1));
+        if (maxLeaf >= 7) {
+            __cpuidex(registers, 7, 0);
+            std::memcpy(leaf7, registers, sizeof(leaf7));
+        }
+#else
+        unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+        __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+        if (maxLeaf >= 7) {
+            __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+        }
+#endif
+        const bool ssse3 = leaf1[2] & (1u << 9);
+        const bool sse41 = leaf1[2] & (1u << 19);
+        CpuFeatures features;
+        features.Pclmul = (leaf1[2] & (1u << 1)) && sse41;
+        features.Sha = (leaf7[1] & (1u << 29)) && ssse3 && sse41;
+        return features;
+    }
+
+    const CpuFeatures& GetCpuFeatures() {
+        static const CpuFeatures features = DetectCpuFeatures();
+        return features;
+    }
+
+    // Folds 64 bytes per step with carry-less multiplies, then Barrett-reduces to 32 bits (Intel,
+    // "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ"). `length` must be a multiple
+    // of 16 and at least 64; works on the raw CRC register.
+    DCFM_TARGET("pclmul,sse4.1")
+    uint32_t CrcPclmul(const FoldConstants& constants, const uint8_t* data, size_t length, uint32_t crc) {
+        const __m128i k1k2 = _mm_set_epi64x(constants.K2, constants.K1);
+        const __m128i k3k4 = _mm_set_epi64x(constants.K4, constants.K3);
+        const __m128i k5 = _mm_set_epi64x(0, constants.K5);
+        const __m128i poly = _mm_set_epi64x(constants.Mu, constants.Polynomial);
+        const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+        __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+        __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32));
+        __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48));
+        x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+        data += 64;
+        length -= 64;
+
+        auto fold = [](__m128i x, __m128i k, __m128i next) DCFM_TARGET("pclmul,sse4.1") {
+            __m128i low = _mm_clmulepi64_si128(x, k, 0x00);
+            __m128i high = _mm_clmulepi64_si128(x, k, 0x11);
+            return _mm_xor_si128(_mm_xor_si128(high, low), next);
+        };
+        while (length >= 64) {
+            x1 = fold(x1, k1k2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+            x2 = fold(x2, k1k2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)));
+            x3 = fold(x3, k1k2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)));
+            x4 = fold(x4, k1k2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)));
+            data += 64;
+            length -= 64;
+        }
+
+        x1 = fold(x1, k3k4, x2);
+        x1 = fold(x1, k3k4, x3);
+        x1 = fold(x1, k3k4, x4);
+        while (length >= 16) {
+            x1 = fold(x1, k3k4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+            data += 16;
+            length -= 16;
+        }
+
+        // 128 -> 64 bits.
+        x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_and_si128(x1, low32);
+        x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5, 0x00), x2);
+
+        // Barrett reduction to 32 bits.
+        x2 = _mm_and_si128(x1, low32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+        x2 = _mm_and_si128(x2, low32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+        return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+    }
+
+    // Four rounds with the SHA extensions: `e` absorbs the current message words while the
+    // schedule for later rounds advances in `next`, `after` and `last`.
+    template <int Function>
+    DCFM_TARGET("sha,ssse3,sse4.1")
+    inline void Sha1Rounds(__m128i& abcd, __m128i& e, __m128i& eNext, __m128i message, __m128i& next, __m128i& after, __m128i& last) {
+        e = _mm_sha1nexte_epu32(e, message);
+        eNext = abcd;
+        next = _mm_sha1msg2_epu32(next, message);
+        abcd = _mm_sha1rnds4_epu32(abcd, e, Function);
+        last = _mm_sha1msg1_epu32(last, message);
+        after = _mm_xor_si128(after, message);
+    }
+
+    DCFM_TARGET("sha,ssse3,sse4.1")
+    void Sha1BlocksSha(uint32_t state[5], const uint8_t* data, size_t blocks) {
+        const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ll, 0x08090a0b0c0d0e0fll);
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+        __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+        __m128i e1;
+
+        for (; blocks > 0; blocks--, data += 64) {
+            const __m128i abcdSaved = abcd;
+            const __m128i eSaved = e0;
+            __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), byteSwap);
+            __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), byteSwap);
+            __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), byteSwap);
+            __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), byteSwap);
+
+            // Rounds 0-15 take the message as loaded while the schedule starts filling in.
+            e0 = _mm_add_epi32(e0, m0);
+            e1 = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+            e1 = _mm_sha1nexte_epu32(e1, m1);
+            e0 = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+            m0 = _mm_sha1msg1_epu32(m0, m1);
+
+            e0 = _mm_sha1nexte_epu32(e0, m2);
+            e1 = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+            m1 = _mm_sha1msg1_epu32(m1, m2);
+            m0 = _mm_xor_si128(m0, m2);
+
+            e1 = _mm_sha1nexte_epu32(e1, m3);
+            e0 = abcd;
+            m0 = _mm_sha1msg2_epu32(m0, m3);
+            abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+            m2 = _mm_sha1msg1_epu32(m2, m3);
+            m1 = _mm_xor_si128(m1, m3);
+
+            // Rounds 16-75, four at a time, rotating through the message registers.
+            Sha1Rounds<0>(abcd, e0, e1, m0, m1, m2, m3);
+            Sha1Rounds<1>(abcd, e1, e0, m1, m2, m3, m0);
+            Sha1Rounds<1>(abcd, e0, e1, m2, m3, m0, m1);
+            Sha1Rounds<1>(abcd, e1, e0, m3, m0, m1, m2);
+            Sha1Rounds<1>(abcd, e0, e1, m0, m1, m2, m3);
+            Sha1Rounds<1>(abcd, e1, e0, m1, m2, m3, m0);
+            Sha1Rounds<2>(abcd, e0, e1, m2, m3, m0, m1);
+            Sha1Rounds<2>(abcd, e1, e0, m3, m0, m1, m2);
+            Sha1Rounds<2>(abcd, e0, e1, m0, m1, m2, m3);
+            Sha1Rounds<2>(abcd, e1, e0, m1, m2, m3, m0);
+            Sha1Rounds<2>(abcd, e0, e1, m2, m3, m0, m1);
+            Sha1Rounds<3>(abcd, e1, e0, m3, m0, m1, m2);
+            Sha1Rounds<3>(abcd, e0, e1, m0, m1, m2, m3);
+            Sha1Rounds<3>(abcd, e1, e0, m1, m2, m3, m0);
+            Sha1Rounds<3>(abcd, e0, e1, m2, m3, m0, m1);
+
+            // Rounds 76-79.
+            e1 = _mm_sha1nexte_epu32(e1, m3);
+            e0 = abcd;
+            abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+            e0 = _mm_sha1nexte_epu32(e0, eSaved);
+            abcd = _mm_add_epi32(abcd, abcdSaved);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+        state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+    }
+#endif
+
+    uint32_t Crc(const CrcTables& table, const FoldConstants& constants, const uint8_t* data, size_t length, uint32_t crc) {
+#ifdef DCFM_CHECKSUM_X86
+        if (length >= 64 && GetCpuFeatures().Pclmul) {
+            size_t folded = length & ~size_t(15);
+            crc = CrcPclmul(constants, data, folded, crc);
+            data += folded;
+            length -= folded;
+        }
+#else
+        (void)constants;
+#endif
+        return CrcSliced(table, data, length, crc);
+    }
+
+} // namespace
+
+uint32_t Checksum::Crc32(const uint8_t* data, size_t length, uint32_t crc) {
+    return ~Crc(Crc32Table, Crc32Fold, data, length, ~crc);
+}
+
+uint32_t Checksum::Edc(const uint8_t* data, size_t length, uint32_t edc) {
+    return Crc(EdcTable, EdcFold, data, length, edc);
+}
+
+Checksum::Sha1::Sha1()
+    : state{ 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u } {
+}
+
+void Checksum::Sha1::ProcessBlocks(const uint8_t* data, size_t blocks) {
+#ifdef DCFM_CHECKSUM_X86
+    if (GetCpuFeatures().Sha) {
+        Sha1BlocksSha(state, data, blocks);
+        return;
+    }
+#endif
+    Sha1BlocksScalar(state, data, blocks);
+}
+
+void Checksum::Sha1::Update(const uint8_t* data, size_t length) {
+    totalLength += length;
+    if (buffered > 0) {
+        size_t take = std::min(length, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, data, take);
+        buffered += take;
+        data += take;
+        length -= take;
+        if (buffered < sizeof(buffer)) {
+            return;
+        }
+        ProcessBlocks(buffer, 1);
+        buffered = 0;
+    }
+    // Whole blocks are hashed straight from the caller's memory.
+    size_t blocks = length / sizeof(buffer);
+    if (blocks > 0) {
+        ProcessBlocks(data, blocks);
+        data += blocks * sizeof(buffer);
+        length -= blocks * sizeof(buffer);
+    }
+    std::memcpy(buffer, data, length);
+    buffered = length;
+}
+
+Checksum::Sha1::Digest Checksum::Sha1::Finish() {
+    uint64_t bitLength = totalLength * 8;
+    uint8_t padding[72] = { 0x80 };
+    size_t paddingLength = (buffered < 56 ? 56 : 120) - buffered;
+    for (int i = 0; i < 8; i++) {
+        padding[paddingLength + i] = static_cast<uint8_t>(bitLength >> (56 - 8 * i));
+    }
+    Update(padding, paddingLength + 8);
+
+    Digest digest;
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+    return digest;
+}
+
+std::string Checksum::ToHex(const uint8_t* data, size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    std::string text(length * 2, '0');
+    for (size_t i = 0; i < length; i++) {
+        text[i * 2] = digits[data[i] >> 4];
+        text[i * 2 + 1] = digits[data[i] & 0xF];
+    }
+    return text;
+}
+
+std::string Checksum::ToHex(uint32_t value) {
+    uint8_t bytes[4] = {
+        static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+        static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) };
+    return ToHex(bytes, sizeof(bytes));
+}
@@ -0,0 +1,45 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Checksum {
+
+    // CRC-32 as used by zip, zlib and SFV hash lists. Pass the previous result to continue a
+    // running checksum. Uses carry-less multiply folding (PCLMULQDQ) when the CPU has it, eight
+    // table lookups per eight bytes otherwise.
+    uint32_t Crc32(const uint8_t* data, size_t length, uint32_t crc = 0);
+
+    // EDC of raw CD sectors (see EdcEcc): a CRC-32 with the polynomial x^32 + x^31 + x^16 + x^15 +
+    // x^4 + x^3 + x + 1, starting at zero and never inverted. Same kernels as Crc32.
+    uint32_t Edc(const uint8_t* data, size_t length, uint32_t edc = 0);
+
+    // Uses the SHA extensions when the CPU has them.
+    class Sha1 {
+    public:
+        using Digest = std::array<uint8_t, 20>;
+
+        Sha1();
+        void Update(const uint8_t* data, size_t length);
+        // Pads and returns the digest; the object must not be updated afterwards.
+        Digest Finish();
+
+    private:
+        void ProcessBlocks(const uint8_t* data, size_t blocks);
+
+        uint32_t state[5];
+        uint8_t buffer[64];
+        size_t buffered = 0;
+        uint64_t totalLength = 0;
+    };
+
+    // Lowercase hexadecimal.
+    std::string ToHex(const uint8_t* data, size_t length);
+    std::string ToHex(uint32_t value);
+
+} // namespace Checksum
+
+#endif // CHECKSUM_H
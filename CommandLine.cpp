@@ -0,0 +1,548 @@
+#include "ISO.h"
+#include "ArchiveExtractor.h"
+#include "ArchivePatcher.h"
+#include "ISOArchive.h"
+#include "ISOPatcher.h"
+#include "Extractor.h"
+#include "ImageDelta.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "SectorCache.h"
+#include "SectorScanner.h"
+#include "Verifier.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+    struct Options {
+        ImageBackend Backend = ImageBackend::Auto;
+        bool UseIndexCache = true;
+        bool Recursive = false;
+        bool ArchiveMembers = false;
+        bool Repair = false;
+        size_t Threads = 0;
+        uint64_t MaxMegabytesInFlight = 256;
+        size_t QueueDepth = 16;
+        std::string MetricsPath;
+        std::vector<std::string> Arguments;
+    };
+
+    void PrintUsage() {
+        std::cerr <<
+            "Usage: dcfm-cli [options] <command> <image> [arguments]\n"
+            "\n"
+            "Commands:\n"
+            "  ls <image> [path]               List a directory (the root by default)\n"
+            "  stat <image> <path>             Show the record of a file or directory\n"
+            "  cat <image> <path> [member]     Write a file, or a member of the archive at path, to stdout\n"
+            "  members <image> <index>         List the members of an .hd2/.hed archive inside the image\n"
+            "  extract <image> <dir> [path]    Extract the image, or the subtree at path, into dir\n"
+            "  unpack <index> <dir> [data]     Unpack the .dat described by an .hd2/.hed index into dir\n"
+            "  patch <index> <member> <file>...  Replace archive members (in place when they fit, else repack)\n"
+            "  replace <image> <path> <file>...  Replace files in the image (in place when they fit, else relocate)\n"
+            "  diff <source> <target> [delta]  List the files whose sectors differ; write a delta if given\n"
+            "  apply <image> <delta>           Patch the image in place with a delta from diff\n"
+            "  hash <image>                    Write a manifest (crc32 sha1 size path) of every file to stdout\n"
+            "  verify <image> <manifest>       Check the image against a manifest, sha1sum list or SFV file\n"
+            "  scan <image>                    Check the EDC/ECC of every sector of a raw (2352/2336-byte) image\n"
+            "\n"
+            "Options:\n"
+            "  -r, --recursive                 ls: descend into subdirectories\n"
+            "  --backend <mapped|positional>   Image backend (default: mapped, falling back to positional)\n"
+            "  --no-cache                      Neither read nor write the .dcfmidx index cache\n"
+            "  --members                       hash/verify: include the members of .hd2/.hed archives\n"
+            "  --repair                        scan: correct sectors that fail their EDC/ECC, else reseal those\n"
+            "                                  with a valid header; the rest are reported as unfixed\n"
+            "  --threads <n>                   extract/unpack/hash/verify/scan: worker threads (default: hardware threads)\n"
+            "  --max-in-flight <MB>            extract/unpack/hash/verify/scan: cap on buffered file data (default: 256)\n"
+            "  --queue-depth <n>               extract/hash/verify: image reads kept in flight (default: 16)\n"
+            "  --sector-cache <MB>             Sectors cached for positional and compressed images, 0 for none (default: 32)\n"
+            "  --log-level <level>             trace, debug, info, warning, error or off (default: warning)\n"
+            "  --metrics <file>                Write load metrics as JSON to file\n";
+    }
+
+    std::string RequireValue(int& i, int argc, char** argv) {
+        if (i + 1 >= argc) {
+            throw std::invalid_argument(std::string("Missing value for ") + argv[i] + ".");
+        }
+        return argv[++i];
+    }
+
+    Options ParseOptions(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            if (argument == "-r" || argument == "--recursive") {
+                options.Recursive = true;
+            }
+            else if (argument == "--members") {
+                options.ArchiveMembers = true;
+            }
+            else if (argument == "--repair") {
+                options.Repair = true;
+            }
+            else if (argument == "--backend") {
+                std::string backend = RequireValue(i, argc, argv);
+                if (backend == "mapped") {
+                    options.Backend = ImageBackend::Mapped;
+                }
+                else if (backend == "positional") {
+                    options.Backend = ImageBackend::Positional;
+                }
+                else {
+                    throw std::invalid_argument("Unknown backend: " + backend + ".");
+                }
+            }
+            else if (argument == "--no-cache") {
+                options.UseIndexCache = false;
+            }
+            else if (argument == "--threads") {
+                options.Threads = std::stoul(RequireValue(i, argc, argv));
+            }
+            else if (argument == "--max-in-flight") {
+                options.MaxMegabytesInFlight = std::stoull(RequireValue(i, argc, argv));
+            }
+            else if (argument == "--queue-depth") {
+                options.QueueDepth = std::stoul(RequireValue(i, argc, argv));
+            }
+            else if (argument == "--sector-cache") {
+                SectorCache::SetDefaultCapacity(std::stoull(RequireValue(i, argc, argv)) * 1024 * 1024);
+            }
+            else if (argument == "--log-level") {
+                LogLevel level;
+                std::string name = RequireValue(i, argc, argv);
+                if (!Log::ParseLevel(name, level)) {
+                    throw std::invalid_argument("Unknown log level: " + name + ".");
+                }
+                Log::SetLevel(level);
+            }
+            else if (argument == "--metrics") {
+                options.MetricsPath = RequireValue(i, argc, argv);
+            }
+            else if (argument.size() > 1 && argument[0] == '-') {
+                throw std::invalid_argument("Unknown option: " + argument + ".");
+            }
+            else {
+                options.Arguments.push_back(argument);
+            }
+        }
+        return options;
+    }
+
+    std::unique_ptr<ISO> OpenImage(const std::string& path, const Options& options) {
+        auto iso = std::make_unique<ISO>(path, options.Backend);
+        iso->SetIndexCacheEnabled(options.UseIndexCache);
+        iso->LoadISO();
+        return iso;
+    }
+
+    uint32_t FindEntry(const ISO& iso, const std::string& path) {
+        auto id = iso.Find(path);
+        if (!id) {
+            throw std::runtime_error("No such file or directory: " + path);
+        }
+        return *id;
+    }
+
+    void ListDirectory(const FileIndex& index, uint32_t directoryId, bool recursive) {
+        for (uint32_t id : index.GetChildren(directoryId)) {
+            std::cout << (index.IsDirectory(id) ? 'd' : '-') << ' '
+                << std::setw(12) << index.GetSize(id) << ' '
+                << std::setw(10) << index.GetLBA(id) << ' '
+                << index.GetPath(id, '/') << '\n';
+            if (recursive && index.IsDirectory(id)) {
+                ListDirectory(index, id, recursive);
+            }
+        }
+    }
+
+    int CommandList(const Options& options) {
+        if (options.Arguments.size() < 2 || options.Arguments.size() > 3) {
+            PrintUsage();
+            return 2;
+        }
+        auto iso = OpenImage(options.Arguments[1], options);
+        const FileIndex& index = iso->GetIndex();
+        uint32_t id = options.Arguments.size() == 3 ? FindEntry(*iso, options.Arguments[2]) : FileIndex::RootId;
+        if (!index.IsDirectory(id)) {
+            throw std::runtime_error("Not a directory: " + options.Arguments[2]);
+        }
+        ListDirectory(index, id, options.Recursive);
+        return 0;
+    }
+
+    int CommandStat(const Options& options) {
+        if (options.Arguments.size() != 3) {
+            PrintUsage();
+            return 2;
+        }
+        auto iso = OpenImage(options.Arguments[1], options);
+        const FileIndex& index = iso->GetIndex();
+        uint32_t id = FindEntry(*iso, options.Arguments[2]);
+        DirectoryRecord record = index.ToDirectoryRecord(id);
+
+        std::cout << "Path:     " << index.GetPath(id, '/') << '\n'
+            << "Type:     " << (index.IsDirectory(id) ? "directory" : "file") << '\n'
+            << "Size:     " << index.GetSize(id) << '\n'
+            << "LBA:      " << index.GetLBA(id) << '\n'
+            << "Sectors:  " << (static_cast<uint64_t>(index.GetSize(id)) + 2047) / 2048 << '\n'
+            << "Flags:    0x" << std::hex << static_cast<int>(index.GetFlags(id)) << std::dec << '\n'
+            << "Recorded: " << record.GetFormattedDateTime() << '\n';
+        return 0;
+    }
+
+    int CommandCat(const Options& options) {
+        if (options.Arguments.size() < 3 || options.Arguments.size() > 4) {
+            PrintUsage();
+            return 2;
+        }
+        auto iso = OpenImage(options.Arguments[1], options);
+        FileView view;
+        if (options.Arguments.size() == 4) {
+            ISOArchive archive(*iso, options.Arguments[2]);
+            view = archive.GetMemberView(options.Arguments[3]);
+        }
+        else {
+            uint32_t id = FindEntry(*iso, options.Arguments[2]);
+            if (iso->GetIndex().IsDirectory(id)) {
+                throw std::runtime_error("Is a directory: " + options.Arguments[2]);
+            }
+            view = iso->GetFileView(id);
+        }
+
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        if (std::fwrite(view.Data(), 1, view.Size(), stdout) != view.Size()) {
+            throw std::runtime_error("Failed to write to stdout.");
+        }
+        std::fflush(stdout);
+        return 0;
+    }
+
+    int CommandMembers(const Options& options) {
+        if (options.Arguments.size() != 3) {
+            PrintUsage();
+            return 2;
+        }
+        auto iso = OpenImage(options.Arguments[1], options);
+        ISOArchive archive(*iso, options.Arguments[2]);
+        const ArchiveIndex& index = archive.GetIndex();
+        for (uint32_t i = 0; i < index.Size(); i++) {
+            std::cout << std::setw(12) << index.GetSize(i) << ' '
+                << std::setw(12) << archive.GetImageOffset(i) << ' '
+                << index.GetName(i) << '\n';
+        }
+        return 0;
+    }
+
+    ExtractionOptions GetExtractionOptions(const Options& options) {
+        ExtractionOptions extractionOptions;
+        extractionOptions.ThreadCount = options.Threads;
+        extractionOptions.MaxBytesInFlight = options.MaxMegabytesInFlight * 1024 * 1024;
+        extractionOptions.QueueDepth = options.QueueDepth;
+        return extractionOptions;
+    }
+
+    void PrintStats(const ExtractionStats& stats) {
+        std::cout << stats.Files << " files, " << stats.Bytes << " bytes in " << stats.Seconds << " s ("
+            << stats.MegabytesPerSecond() << " MB/s, " << stats.FilesPerSecond() << " files/s)\n";
+    }
+
+    int CommandExtract(const Options& options) {
+        if (options.Arguments.size() < 3 || options.Arguments.size() > 4) {
+            PrintUsage();
+            return 2;
+        }
+        auto iso = OpenImage(options.Arguments[1], options);
+        Extractor extractor(*iso, GetExtractionOptions(options));
+
+        PrintStats(options.Arguments.size() == 4
+            ? extractor.ExtractSubtree(options.Arguments[3], options.Arguments[2])
+            : extractor.ExtractAll(options.Arguments[2]));
+        return 0;
+    }
+
+    int CommandUnpack(const Options& options) {
+        if (options.Arguments.size() < 3 || options.Arguments.size() > 4) {
+            PrintUsage();
+            return 2;
+        }
+        const std::string& indexPath = options.Arguments[1];
+        std::string dataPath = options.Arguments.size() == 4 ? options.Arguments[3] : ArchiveExtractor::FindDataFile(indexPath);
+        if (dataPath.empty()) {
+            throw std::runtime_error("No .dat found next to " + indexPath + "; pass it explicitly.");
+        }
+
+        ArchiveIndex index;
+        index.Load(indexPath);
+        ArchiveExtractor extractor(index, dataPath, GetExtractionOptions(options));
+        PrintStats(extractor.ExtractAll(options.Arguments[2]));
+        return 0;
+    }
+
+    std::vector<uint8_t> ReadInputFile(const std::string& path) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            throw std::runtime_error("Failed to open " + path + ".");
+        }
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(input), {});
+    }
+
+    int CommandPatch(const Options& options) {
+        if (options.Arguments.size() < 4 || options.Arguments.size() % 2 != 0) {
+            PrintUsage();
+            return 2;
+        }
+        ArchivePatcher patcher(options.Arguments[1]);
+        for (size_t i = 2; i + 1 < options.Arguments.size(); i += 2) {
+            patcher.Replace(options.Arguments[i], ReadInputFile(options.Arguments[i + 1]));
+        }
+
+        ArchivePatchResult result = patcher.Apply();
+        std::cout << (result.Repacked ? "Repacked: " : "Patched in place: ") << result.MembersReplaced << " members, "
+            << result.BytesWritten << " bytes written in " << result.Seconds << " s\n";
+        return 0;
+    }
+
+    int CommandReplace(const Options& options) {
+        if (options.Arguments.size() < 4 || options.Arguments.size() % 2 != 0) {
+            PrintUsage();
+            return 2;
+        }
+        ISOPatcher patcher(options.Arguments[1]);
+        for (size_t i = 2; i + 1 < options.Arguments.size(); i += 2) {
+            patcher.Replace(options.Arguments[i], ReadInputFile(options.Arguments[i + 1]));
+        }
+
+        ISOPatchResult result = patcher.Apply();
+        std::cout << result.FilesReplaced << " files replaced (" << result.FilesRelocated << " relocated, "
+            << result.SectorsAppended << " sectors appended), " << result.BytesWritten << " bytes written in "
+            << result.Seconds << " s\n";
+        return 0;
+    }
+
+    int CommandDiff(const Options& options) {
+        if (options.Arguments.size() < 3 || options.Arguments.size() > 4) {
+            PrintUsage();
+            return 2;
+        }
+        const std::string& sourcePath = options.Arguments[1];
+        const std::string& targetPath = options.Arguments[2];
+        auto source = ImageReader::Open(sourcePath, options.Backend);
+        auto target = ImageReader::Open(targetPath, options.Backend);
+        if (!source || !target) {
+            throw std::runtime_error("Failed to open " + (source ? targetPath : sourcePath) + ".");
+        }
+
+        ImageDiffResult diff = ImageDelta::Compare(*source, *target);
+        std::cout << diff.ChangedSectors << " changed sectors in " << diff.Runs.size() << " runs ("
+            << diff.BytesCompared << " bytes compared in " << diff.Seconds << " s)\n";
+
+        // Attribution is best effort; the delta itself does not depend on either image being an ISO.
+        if (!diff.Runs.empty()) {
+            try {
+                auto iso = OpenImage(targetPath, options);
+                uint64_t unattributed = 0;
+                for (const auto& file : ImageDelta::Attribute(*iso, diff.Runs, &unattributed)) {
+                    std::cout << std::setw(10) << file.Sectors << ' ' << (file.Path.empty() ? "/" : file.Path) << '\n';
+                }
+                if (unattributed > 0) {
+                    std::cout << std::setw(10) << unattributed << " (outside any file)\n";
+                }
+            }
+            catch (const std::exception& ex) {
+                LOG_WARNING("Changes not attributed to files: " << ex.what());
+            }
+        }
+
+        if (options.Arguments.size() == 4) {
+            uint64_t deltaSize = ImageDelta::Write(options.Arguments[3], *source, *target, diff);
+            std::cout << "Delta written: " << options.Arguments[3] << " (" << deltaSize << " bytes)\n";
+        }
+        return 0;
+    }
+
+    int CommandApply(const Options& options) {
+        if (options.Arguments.size() != 3) {
+            PrintUsage();
+            return 2;
+        }
+        DeltaApplyResult result = ImageDelta::Apply(options.Arguments[2], options.Arguments[1]);
+        std::cout << result.RunsApplied << " runs applied, " << result.BytesWritten << " bytes written in "
+            << result.Seconds << " s\n";
+        return 0;
+    }
+
+    VerificationOptions GetVerificationOptions(const Options& options) {
+        VerificationOptions verificationOptions;
+        verificationOptions.ThreadCount = options.Threads;
+        verificationOptions.MaxBytesInFlight = options.MaxMegabytesInFlight * 1024 * 1024;
+        verificationOptions.ArchiveMembers = options.ArchiveMembers;
+        verificationOptions.QueueDepth = options.QueueDepth;
+        return verificationOptions;
+    }
+
+    int CommandHash(const Options& options) {
+        if (options.Arguments.size() != 2) {
+            PrintUsage();
+            return 2;
+        }
+        auto iso = OpenImage(options.Arguments[1], options);
+        Verifier verifier(*iso, GetVerificationOptions(options));
+        Verifier::WriteManifest(std::cout, verifier.HashAll());
+        return 0;
+    }
+
+    int CommandVerify(const Options& options) {
+        if (options.Arguments.size() != 3) {
+            PrintUsage();
+            return 2;
+        }
+        std::vector<ManifestEntry> manifest = Verifier::LoadManifest(options.Arguments[2]);
+        auto iso = OpenImage(options.Arguments[1], options);
+        Verifier verifier(*iso, GetVerificationOptions(options));
+        VerificationReport report = Verifier::Compare(verifier.HashAll(), manifest);
+
+        for (const auto& path : report.Mismatched) {
+            std::cout << "MISMATCH " << path << '\n';
+        }
+        for (const auto& path : report.Missing) {
+            std::cout << "MISSING  " << path << '\n';
+        }
+        std::cout << report.Matched << " matched, " << report.Mismatched.size() << " mismatched, " << report.Missing.size()
+            << " missing, " << report.Unlisted.size() << " not in the manifest\n";
+        return report.Passed() ? 0 : 1;
+    }
+
+    void PrintSectors(const char* label, const std::vector<uint32_t>& sectors) {
+        constexpr size_t MaxListed = 16;
+        if (sectors.empty()) {
+            return;
+        }
+        std::cout << label << sectors.size() << " sectors:";
+        for (size_t i = 0; i < std::min(sectors.size(), MaxListed); i++) {
+            std::cout << ' ' << sectors[i];
+        }
+        std::cout << (sectors.size() > MaxListed ? " ...\n" : "\n");
+    }
+
+    int CommandScan(const Options& options) {
+        if (options.Arguments.size() != 2) {
+            PrintUsage();
+            return 2;
+        }
+        SectorScanOptions scanOptions;
+        scanOptions.Backend = options.Backend;
+        scanOptions.ThreadCount = options.Threads;
+        scanOptions.MaxBytesInFlight = options.MaxMegabytesInFlight * 1024 * 1024;
+        scanOptions.Repair = options.Repair;
+        SectorScanReport report = SectorScanner(options.Arguments[1], scanOptions).Scan();
+
+        std::cout << report.Layout.GetName() << ", " << report.VolumeSectors << " sectors in the volume, "
+            << report.ImageSectors << " in the image\n";
+        std::cout << report.SectorsChecked << " checked: " << report.Mode1 << " mode 1, " << report.Mode2Form1 << " mode 2 form 1, "
+            << report.Mode2Form2 << " mode 2 form 2, " << report.Empty << " mode 0\n";
+        if (report.SectorsChecked < report.VolumeSectors) {
+            std::cout << "TRUNCATED " << report.VolumeSectors - report.SectorsChecked << " sectors missing from the image\n";
+        }
+        PrintSectors("NO SYNC  ", report.NoSync);
+        PrintSectors("BAD MODE ", report.UnknownMode);
+        PrintSectors("BAD ADDR ", report.BadAddress);
+        PrintSectors("BAD EDC  ", report.BadEdc);
+        PrintSectors("BAD ECC  ", report.BadEcc);
+        PrintSectors("UNFIXED  ", report.Unrecoverable);
+        if (report.Repaired > 0) {
+            std::cout << "Repaired " << report.Repaired << " sectors, " << report.Corrected << " of them corrected by the ECC\n";
+        }
+        return report.Passed() ? 0 : 1;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // Keep stdout for command output; diagnostics go to stderr and default to warnings only.
+    Log::SetAllToStderr(true);
+    if (std::getenv("DCFM_LOG_LEVEL") == nullptr) {
+        Log::SetLevel(LogLevel::Warning);
+    }
+
+    try {
+        Options options = ParseOptions(argc, argv);
+        if (options.Arguments.empty()) {
+            PrintUsage();
+            return 2;
+        }
+        Metrics::SetEnabled(!options.MetricsPath.empty());
+
+        const std::string& command = options.Arguments[0];
+        int result;
+        if (command == "ls") {
+            result = CommandList(options);
+        }
+        else if (command == "stat") {
+            result = CommandStat(options);
+        }
+        else if (command == "cat") {
+            result = CommandCat(options);
+        }
+        else if (command == "members") {
+            result = CommandMembers(options);
+        }
+        else if (command == "extract") {
+            result = CommandExtract(options);
+        }
+        else if (command == "unpack") {
+            result = CommandUnpack(options);
+        }
+        else if (command == "patch") {
+            result = CommandPatch(options);
+        }
+        else if (command == "replace") {
+            result = CommandReplace(options);
+        }
+        else if (command == "diff") {
+            result = CommandDiff(options);
+        }
+        else if (command == "apply") {
+            result = CommandApply(options);
+        }
+        else if (command == "hash") {
+            result = CommandHash(options);
+        }
+        else if (command == "verify") {
+            result = CommandVerify(options);
+        }
+        else if (command == "scan") {
+            result = CommandScan(options);
+        }
+        else {
+            std::cerr << "Unknown command: " << command << "\n\n";
+            PrintUsage();
+            return 2;
+        }
+
+        if (!options.MetricsPath.empty() && !Metrics::WriteJson(options.MetricsPath)) {
+            LOG_ERROR("Could not write metrics to " << options.MetricsPath);
+        }
+        return result;
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "dcfm-cli: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,320 @@
+#include "CompressedImageReader.h"
+#include "Bytes.h"
+#include "Decompress.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+    constexpr size_t HeaderSize = 24;
+    constexpr uint32_t MaxBlockSize = 16 * 1024 * 1024;
+    constexpr uint32_t StoredFlag = 0x80000000;
+    // Index entries loaded per segment (64 KiB of index).
+    constexpr uint64_t IndexSegmentEntries = 16384;
+    // Decompressed bytes per batch handed to one thread.
+    constexpr uint64_t BatchBytes = 256 * 1024;
+
+    const char* GetFormatName(CompressedFormat format) {
+        switch (format) {
+        case CompressedFormat::CSO1: return "CSO v1";
+        case CompressedFormat::CSO2: return "CSO v2";
+        default: return "ZSO";
+        }
+    }
+
+} // namespace
+
+CompressedImageReader::CompressedImageReader(std::unique_ptr<ImageReader> base, CompressedImageOptions options)
+    : base(std::move(base)), options(options) {
+    if (!this->base) {
+        throw std::runtime_error("Failed to open image.");
+    }
+    uint8_t header[HeaderSize];
+    if (this->base->Size() < HeaderSize || !this->base->Read(0, header, HeaderSize)) {
+        throw std::runtime_error("Failed to read compressed image header.");
+    }
+
+    uint8_t version = header[20];
+    if (std::memcmp(header, "CISO", 4) == 0) {
+        format = version >= 2 ? CompressedFormat::CSO2 : CompressedFormat::CSO1;
+    }
+    else if (std::memcmp(header, "ZISO", 4) == 0) {
+        format = CompressedFormat::ZSO;
+    }
+    else {
+        throw std::runtime_error("Not a CSO or ZSO image.");
+    }
+    size = Bytes::ReadUInt32(header + 8) | static_cast<uint64_t>(Bytes::ReadUInt32(header + 12)) << 32;
+    blockSize = Bytes::ReadUInt32(header + 16);
+    indexShift = header[21];
+    if (version > 2 || blockSize < 512 || blockSize > MaxBlockSize || (blockSize & (blockSize - 1)) != 0 || indexShift > 31) {
+        throw std::runtime_error("Unsupported compressed image header.");
+    }
+
+    // The index holds one entry per block plus one marking the end of the last block.
+    blockCount = (size + blockSize - 1) / blockSize;
+    if (blockCount >= this->base->Size() / 4 || HeaderSize + (blockCount + 1) * 4 > this->base->Size()) {
+        throw std::runtime_error("Compressed image index is truncated.");
+    }
+    uint64_t segments = (blockCount + IndexSegmentEntries) / IndexSegmentEntries;
+    segmentLoaded = std::make_unique<std::once_flag[]>(segments);
+    indexSegments.resize(segments);
+
+    batchBlocks = std::max<uint64_t>(1, BatchBytes / blockSize);
+    readAheadBlocks = std::min(options.ReadAheadBytes, options.CacheBytes / 2) / blockSize;
+    windowBlocks = std::max<uint64_t>(1, options.CacheBytes / 2 / blockSize);
+
+    LOG_INFO("Compressed image: " << GetFormatName(format) << ", " << blockCount << " blocks of " << blockSize
+        << " bytes, " << size << " bytes uncompressed");
+}
+
+CompressedImageReader::~CompressedImageReader() {
+    // Queued batches are dropped rather than decoded for nobody.
+    closing = true;
+    pool.reset();
+}
+
+std::unique_ptr<ImageReader> CompressedImageReader::Wrap(std::unique_ptr<ImageReader> reader, CompressedImageOptions options) {
+    if (!reader) {
+        return nullptr;
+    }
+    char magic[4];
+    if (reader->Size() < HeaderSize || !reader->Read(0, magic, sizeof(magic)) ||
+        (std::memcmp(magic, "CISO", 4) != 0 && std::memcmp(magic, "ZISO", 4) != 0)) {
+        return reader;
+    }
+    return std::make_unique<CompressedImageReader>(std::move(reader), options);
+}
+
+uint32_t CompressedImageReader::GetIndexEntry(uint64_t entry) {
+    uint64_t segment = entry / IndexSegmentEntries;
+    std::call_once(segmentLoaded[segment], [&] {
+        uint64_t first = segment * IndexSegmentEntries;
+        size_t count = static_cast<size_t>(std::min(IndexSegmentEntries, blockCount + 1 - first));
+        std::vector<uint8_t> bytes(count * 4);
+        if (!base->Read(HeaderSize + first * 4, bytes.data(), bytes.size())) {
+            throw std::runtime_error("Failed to read compressed image index.");
+        }
+        std::vector<uint32_t> entries(count);
+        for (size_t i = 0; i < count; i++) {
+            entries[i] = Bytes::ReadUInt32(bytes.data() + i * 4);
+        }
+        indexSegments[segment] = std::move(entries);
+    });
+    return indexSegments[segment][entry % IndexSegmentEntries];
+}
+
+CompressedImageReader::BlockExtent CompressedImageReader::GetExtent(uint64_t block) {
+    uint32_t entry = GetIndexEntry(block);
+    uint32_t next = GetIndexEntry(block + 1);
+    uint64_t offset = static_cast<uint64_t>(entry & ~StoredFlag) << indexShift;
+    uint64_t end = static_cast<uint64_t>(next & ~StoredFlag) << indexShift;
+    // Alignment padding aside, no block takes much more room than its decompressed size.
+    uint64_t maxLength = static_cast<uint64_t>(blockSize) * 2 + (uint64_t(1) << indexShift);
+    if (end < offset || end > base->Size() || end - offset > maxLength) {
+        throw std::runtime_error("Compressed image index is corrupt.");
+    }
+    return { offset, end - offset, (entry & StoredFlag) != 0 };
+}
+
+CompressedImageReader::Block CompressedImageReader::DecodeBlock(uint64_t block, const BlockExtent& extent, const uint8_t* compressed) {
+    size_t length = static_cast<size_t>(std::min<uint64_t>(blockSize, size - block * blockSize));
+    auto data = std::make_shared<std::vector<uint8_t>>(length);
+
+    bool stored = extent.Flagged;
+    bool lz4 = format == CompressedFormat::ZSO;
+    if (format == CompressedFormat::CSO2) {
+        stored = extent.Length >= blockSize;
+        lz4 = extent.Flagged;
+    }
+    if (stored) {
+        if (extent.Length < length) {
+            return nullptr;
+        }
+        std::memcpy(data->data(), compressed, length);
+        return data;
+    }
+
+    auto decode = lz4 ? Decompress::Lz4Block : Decompress::Inflate;
+    if (decode(compressed, static_cast<size_t>(extent.Length), data->data(), length)) {
+        return data;
+    }
+    // Some tools compress the short last block padded out to the full block size.
+    if (length < blockSize) {
+        std::vector<uint8_t> full(blockSize);
+        if (decode(compressed, static_cast<size_t>(extent.Length), full.data(), full.size())) {
+            std::memcpy(data->data(), full.data(), length);
+            return data;
+        }
+    }
+    return nullptr;
+}
+
+CompressedImageReader::Block CompressedImageReader::LoadBlock(uint64_t block) {
+    BlockExtent extent = GetExtent(block);
+    std::vector<uint8_t> compressed(static_cast<size_t>(extent.Length));
+    if (!base->Read(extent.Offset, compressed.data(), compressed.size())) {
+        return nullptr;
+    }
+    return DecodeBlock(block, extent, compressed.data());
+}
+
+std::vector<CompressedImageReader::Run> CompressedImageReader::Claim(uint64_t first, uint64_t end) {
+    std::vector<Run> runs;
+    for (uint64_t block = first; block < end; block++) {
+        if (cache.count(block) != 0 || !pending.insert(block).second) {
+            continue;
+        }
+        if (!runs.empty() && runs.back().First + runs.back().Count == block && runs.back().Count < batchBlocks) {
+            runs.back().Count++;
+        }
+        else {
+            runs.push_back({ block, 1 });
+        }
+    }
+    return runs;
+}
+
+void CompressedImageReader::DecodeRun(Run run) {
+    std::vector<Block> blocks(static_cast<size_t>(run.Count));
+    if (!closing) {
+        try {
+            std::vector<BlockExtent> extents;
+            extents.reserve(blocks.size());
+            for (uint64_t i = 0; i < run.Count; i++) {
+                extents.push_back(GetExtent(run.First + i));
+            }
+            // Each block ends where the next one starts, so the run is one span of the file.
+            uint64_t start = extents.front().Offset;
+            std::vector<uint8_t> compressed(static_cast<size_t>(extents.back().Offset + extents.back().Length - start));
+            if (base->Read(start, compressed.data(), compressed.size())) {
+                for (size_t i = 0; i < blocks.size(); i++) {
+                    blocks[i] = DecodeBlock(run.First + i, extents[i], compressed.data() + (extents[i].Offset - start));
+                }
+            }
+        }
+        catch (const std::exception&) {
+            // Whatever did not decode is retried, and reported, by the read that needs it.
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (blocks[i]) {
+                Insert(run.First + i, std::move(blocks[i]));
+            }
+            pending.erase(run.First + i);
+        }
+    }
+    decoded.notify_all();
+}
+
+void CompressedImageReader::Submit(const std::vector<Run>& runs) {
+    if (runs.empty()) {
+        return;
+    }
+    std::call_once(poolStarted, [this] { pool = std::make_unique<WorkerPool>(options.ThreadCount); });
+    for (const Run& run : runs) {
+        pool->Submit([this, run] { DecodeRun(run); });
+    }
+}
+
+CompressedImageReader::Block CompressedImageReader::Acquire(uint64_t block) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        decoded.wait(lock, [&] { return pending.count(block) == 0; });
+        auto found = cache.find(block);
+        if (found != cache.end()) {
+            recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, found->second.Position);
+            return found->second.Data;
+        }
+    }
+
+    // Evicted before it was used, or its batch failed.
+    Block data;
+    try {
+        data = LoadBlock(block);
+    }
+    catch (const std::exception&) {
+        return nullptr;
+    }
+    if (data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Insert(block, data);
+    }
+    return data;
+}
+
+void CompressedImageReader::Insert(uint64_t block, Block data) {
+    if (cache.count(block) != 0) {
+        return;
+    }
+    cachedBytes += data->size();
+    recentlyUsed.push_front(block);
+    cache.emplace(block, CacheEntry{ std::move(data), recentlyUsed.begin() });
+    while (cachedBytes > options.CacheBytes && recentlyUsed.size() > 1) {
+        auto oldest = cache.find(recentlyUsed.back());
+        cachedBytes -= oldest->second.Data->size();
+        cache.erase(oldest);
+        recentlyUsed.pop_back();
+    }
+}
+
+bool CompressedImageReader::Read(uint64_t offset, void* buffer, size_t length) {
+    if (offset > size || length > size - offset) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+    uint64_t first = offset / blockSize;
+    uint64_t end = (offset + length - 1) / blockSize + 1;
+    // Extraction reads in LBA order, skipping at most the padding to the next sector, so a read
+    // starting at or just past the end of the previous one continues a sequential pass.
+    uint64_t previousEnd = previousReadEnd.exchange(offset + length, std::memory_order_relaxed);
+    bool sequential = offset >= previousEnd && offset - previousEnd <= blockSize;
+
+    uint8_t* destination = static_cast<uint8_t*>(buffer);
+    size_t within = static_cast<size_t>(offset % blockSize);
+    for (uint64_t windowFirst = first; windowFirst < end;) {
+        uint64_t windowEnd = std::min(end, windowFirst + windowBlocks);
+        std::vector<Run> runs;
+        std::vector<Run> readAhead;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            runs = Claim(windowFirst, windowEnd);
+            // Topped up once half the window has been consumed, not on every read.
+            if (windowEnd == end && sequential && readAheadBlocks > 0 && end + readAheadBlocks / 2 > readAheadEnd) {
+                uint64_t aheadEnd = std::min(blockCount, end + readAheadBlocks);
+                readAhead = Claim(std::max(end, readAheadEnd), aheadEnd);
+                readAheadEnd = aheadEnd;
+            }
+        }
+
+        // This thread decodes the first batch while the pool takes the others.
+        if (runs.size() > 1) {
+            Submit(std::vector<Run>(runs.begin() + 1, runs.end()));
+        }
+        Submit(readAhead);
+        if (!runs.empty()) {
+            DecodeRun(runs.front());
+        }
+
+        for (uint64_t block = windowFirst; block < windowEnd; block++) {
+            Block data = Acquire(block);
+            if (!data) {
+                return false;
+            }
+            size_t chunk = std::min(length, data->size() - within);
+            std::memcpy(destination, data->data() + within, chunk);
+            destination += chunk;
+            length -= chunk;
+            within = 0;
+        }
+        windowFirst = windowEnd;
+    }
+    return true;
+}
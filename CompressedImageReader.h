@@ -0,0 +1,120 @@
+#ifndef COMPRESSEDIMAGEREADER_H
+#define COMPRESSEDIMAGEREADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ImageReader.h"
+#include "WorkerPool.h"
+
+enum class CompressedFormat {
+    CSO1,   // Deflate blocks; bit 31 of an index entry marks a stored block
+    CSO2,   // Deflate or, with bit 31 set, LZ4 blocks; blocks as large as the block size are stored
+    ZSO     // LZ4 blocks; bit 31 marks a stored block
+};
+
+struct CompressedImageOptions {
+    uint64_t CacheBytes = 64ull * 1024 * 1024;      // Decompressed blocks kept, least recently used dropped first
+    uint64_t ReadAheadBytes = 4ull * 1024 * 1024;   // Decoded ahead of sequential reads
+    size_t ThreadCount = 0;                         // 0 = one decoding thread per hardware thread
+};
+
+// Presents a CSO or ZSO container (an image cut into fixed-size blocks, each compressed on its
+// own, with an offset index in front) as the plain image it holds. Opening reads only the header;
+// the index is loaded a segment at a time as blocks are first touched.
+//
+// Blocks are decoded on demand into a bounded LRU cache. A read whose blocks are missing decodes
+// the first batch itself and hands the rest to a worker pool, and a read following on from the
+// previous one also queues the blocks after it, so sequential extraction finds them ready. Each
+// batch of consecutive blocks is fetched from the file with a single read. Reads larger than half
+// the cache are served a window at a time, so their blocks are copied out before they can be evicted.
+class CompressedImageReader : public ImageReader {
+public:
+    // Throws std::runtime_error if `base` does not hold a valid container.
+    explicit CompressedImageReader(std::unique_ptr<ImageReader> base, CompressedImageOptions options = {});
+    ~CompressedImageReader() override;
+
+    // Returns `reader` itself unless it starts with a CSO or ZSO header.
+    static std::unique_ptr<ImageReader> Wrap(std::unique_ptr<ImageReader> reader, CompressedImageOptions options = {});
+
+    ImageBackend GetBackend() const override { return base->GetBackend(); }
+    uint64_t Size() const override { return size; }
+    bool Read(uint64_t offset, void* buffer, size_t length) override;
+    bool IsCompressed() const override { return true; }
+
+    CompressedFormat GetFormat() const { return format; }
+    uint32_t GetBlockSize() const { return blockSize; }
+    uint64_t GetBlockCount() const { return blockCount; }
+
+private:
+    using Block = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct BlockExtent {
+        uint64_t Offset;
+        uint64_t Length;
+        bool Flagged;       // Bit 31 of the index entry
+    };
+
+    struct Run {
+        uint64_t First;
+        uint64_t Count;
+    };
+
+    struct CacheEntry {
+        Block Data;
+        std::list<uint64_t>::iterator Position;
+    };
+
+    uint32_t GetIndexEntry(uint64_t entry);
+    BlockExtent GetExtent(uint64_t block);
+    Block DecodeBlock(uint64_t block, const BlockExtent& extent, const uint8_t* compressed);
+    Block LoadBlock(uint64_t block);
+
+    // Marks the missing blocks of [first, end) as pending and returns them as runs of at most
+    // batchBlocks consecutive blocks. Caller holds the mutex.
+    std::vector<Run> Claim(uint64_t first, uint64_t end);
+    // Decodes a claimed run into the cache and clears its pending marks, whether or not it worked.
+    void DecodeRun(Run run);
+    void Submit(const std::vector<Run>& runs);
+    // Waits out a pending decode, then takes the block from the cache or, if it is not there,
+    // decodes it on this thread. Returns nullptr if the block cannot be decoded.
+    Block Acquire(uint64_t block);
+    void Insert(uint64_t block, Block data);
+
+    std::unique_ptr<ImageReader> base;
+    CompressedImageOptions options;
+    CompressedFormat format = CompressedFormat::CSO1;
+    uint64_t size = 0;
+    uint32_t blockSize = 0;
+    uint32_t indexShift = 0;
+    uint64_t blockCount = 0;
+    uint64_t batchBlocks = 1;
+    uint64_t readAheadBlocks = 0;
+    uint64_t windowBlocks = 1;      // Most blocks one read claims at a time
+
+    std::unique_ptr<std::once_flag[]> segmentLoaded;
+    std::vector<std::vector<uint32_t>> indexSegments;
+
+    std::mutex mutex;
+    std::condition_variable decoded;
+    std::unordered_map<uint64_t, CacheEntry> cache;
+    std::list<uint64_t> recentlyUsed;   // Front is most recent
+    std::unordered_set<uint64_t> pending;
+    uint64_t cachedBytes = 0;
+    uint64_t readAheadEnd = 0;          // Blocks before this were already queued for read-ahead
+    std::atomic<uint64_t> previousReadEnd{ 0 };
+    std::atomic<bool> closing{ false };
+
+    // Started on first use. Declared last so its threads stop before the cache they fill goes away.
+    std::once_flag poolStarted;
+    std::unique_ptr<WorkerPool> pool;
+};
+
+#endif // COMPRESSEDIMAGEREADER_H
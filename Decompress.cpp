@@ -0,0 +1,367 @@
+#include "Decompress.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+    // LSB-first bit reader. Past the end of the input it feeds zeros and remembers that it did,
+    // so the hot path needs no bounds check per bit.
+    class BitReader {
+    public:
+        BitReader(const uint8_t* input, size_t length) : input(input), length(length) {}
+
+        // Tops the buffer up to more than 56 bits.
+        void Refill() {
+            while (count <= 56) {
+                uint64_t byte = position < length ? input[position] : 0;
+                position++;
+                bits |= byte << count;
+                count += 8;
+            }
+        }
+
+        uint32_t Peek(int n) const { return static_cast<uint32_t>(bits & ((uint64_t(1) << n) - 1)); }
+
+        void Skip(int n) {
+            bits >>= n;
+            count -= n;
+        }
+
+        uint32_t Take(int n) {
+            if (count < n) {
+                Refill();
+            }
+            uint32_t value = Peek(n);
+            Skip(n);
+            return value;
+        }
+
+        void AlignToByte() { Skip(count % 8); }
+
+        // True once more bits were consumed than the input holds.
+        bool Overrun() const { return position * 8 - count > length * 8; }
+
+    private:
+        const uint8_t* input;
+        size_t length;
+        size_t position = 0;
+        uint64_t bits = 0;
+        int count = 0;
+    };
+
+    // Canonical Huffman decoder: codes up to FastBits long resolve with one table lookup, longer
+    // ones are walked a bit at a time from the per-length counts.
+    class Huffman {
+    public:
+        static constexpr int MaxBits = 15;
+        static constexpr int FastBits = 9;
+
+        bool Build(const uint8_t* lengths, int symbols) {
+            std::fill(std::begin(count), std::end(count), uint16_t(0));
+            for (int i = 0; i < symbols; i++) {
+                count[lengths[i]]++;
+            }
+            count[0] = 0;
+            int left = 1;
+            for (int length = 1; length <= MaxBits; length++) {
+                left = (left << 1) - count[length];
+                if (left < 0) {
+                    return false;
+                }
+            }
+
+            uint16_t offsets[MaxBits + 2] = {};
+            for (int length = 1; length <= MaxBits; length++) {
+                offsets[length + 1] = static_cast<uint16_t>(offsets[length] + count[length]);
+            }
+            for (int i = 0; i < symbols; i++) {
+                if (lengths[i] != 0) {
+                    symbol[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+                }
+            }
+
+            // Deflate sends codes most significant bit first, so the table is indexed by the
+            // reversed code and every entry repeats for all values of the bits after it.
+            std::fill(std::begin(fast), std::end(fast), uint16_t(0));
+            uint32_t code = 0;
+            int index = 0;
+            for (int length = 1; length <= FastBits; length++) {
+                for (int i = 0; i < count[length]; i++, code++, index++) {
+                    uint32_t reversed = 0;
+                    for (int bit = 0; bit < length; bit++) {
+                        reversed |= ((code >> bit) & 1u) << (length - 1 - bit);
+                    }
+                    for (uint32_t entry = reversed; entry < (1u << FastBits); entry += 1u << length) {
+                        fast[entry] = static_cast<uint16_t>(symbol[index] | (length << 9));
+                    }
+                }
+                code <<= 1;
+            }
+            return true;
+        }
+
+        // Returns the symbol, or -1 for a code that is not in the table. Expects a refilled reader.
+        int Decode(BitReader& reader) const {
+            uint16_t entry = fast[reader.Peek(FastBits)];
+            if (entry != 0) {
+                reader.Skip(entry >> 9);
+                return entry & 0x1FF;
+            }
+            int code = 0;
+            int first = 0;
+            int index = 0;
+            for (int length = 1; length <= MaxBits; length++) {
+                code |= static_cast<int>(reader.Take(1));
+                int lengthCount = count[length];
+                if (code - lengthCount < first) {
+                    return symbol[index + (code - first)];
+                }
+                index += lengthCount;
+                first = (first + lengthCount) << 1;
+                code <<= 1;
+            }
+            return -1;
+        }
+
+    private:
+        uint16_t count[MaxBits + 1];
+        uint16_t symbol[288];
+        uint16_t fast[1 << FastBits];
+    };
+
+    constexpr uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    constexpr uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    constexpr uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    constexpr uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    constexpr uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    struct FixedCodes {
+        Huffman Literals;
+        Huffman Distances;
+
+        FixedCodes() {
+            uint8_t lengths[288];
+            std::fill(lengths, lengths + 144, uint8_t(8));
+            std::fill(lengths + 144, lengths + 256, uint8_t(9));
+            std::fill(lengths + 256, lengths + 280, uint8_t(7));
+            std::fill(lengths + 280, lengths + 288, uint8_t(8));
+            Literals.Build(lengths, 288);
+            std::fill(lengths, lengths + 30, uint8_t(5));
+            Distances.Build(lengths, 30);
+        }
+    };
+
+    bool ReadDynamicCodes(BitReader& reader, Huffman& literals, Huffman& distances) {
+        reader.Refill();
+        int literalCount = static_cast<int>(reader.Take(5)) + 257;
+        int distanceCount = static_cast<int>(reader.Take(5)) + 1;
+        int codeLengthCount = static_cast<int>(reader.Take(4)) + 4;
+        if (literalCount > 286 || distanceCount > 30) {
+            return false;
+        }
+
+        uint8_t lengths[286 + 30] = {};
+        for (int i = 0; i < codeLengthCount; i++) {
+            lengths[CodeLengthOrder[i]] = static_cast<uint8_t>(reader.Take(3));
+        }
+        Huffman codeLengths;
+        if (!codeLengths.Build(lengths, 19)) {
+            return false;
+        }
+
+        std::fill(std::begin(lengths), std::end(lengths), uint8_t(0));
+        for (int i = 0; i < literalCount + distanceCount;) {
+            reader.Refill();
+            int symbol = codeLengths.Decode(reader);
+            if (symbol < 0) {
+                return false;
+            }
+            if (symbol < 16) {
+                lengths[i++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+            uint8_t repeated = 0;
+            int repeat;
+            if (symbol == 16) {
+                if (i == 0) {
+                    return false;
+                }
+                repeated = lengths[i - 1];
+                repeat = 3 + static_cast<int>(reader.Take(2));
+            }
+            else if (symbol == 17) {
+                repeat = 3 + static_cast<int>(reader.Take(3));
+            }
+            else {
+                repeat = 11 + static_cast<int>(reader.Take(7));
+            }
+            if (i + repeat > literalCount + distanceCount) {
+                return false;
+            }
+            std::fill(lengths + i, lengths + i + repeat, repeated);
+            i += repeat;
+        }
+        if (lengths[256] == 0) {
+            return false;
+        }
+        return literals.Build(lengths, literalCount) && distances.Build(lengths + literalCount, distanceCount);
+    }
+
+    bool InflateCodes(BitReader& reader, const Huffman& literals, const Huffman& distances, uint8_t* output, size_t outputLength, size_t& produced) {
+        for (;;) {
+            reader.Refill();
+            int symbol = literals.Decode(reader);
+            if (symbol < 0) {
+                return false;
+            }
+            if (symbol < 256) {
+                if (produced == outputLength) {
+                    return false;
+                }
+                output[produced++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+            if (symbol == 256) {
+                return true;
+            }
+
+            symbol -= 257;
+            if (symbol >= 29) {
+                return false;
+            }
+            size_t length = LengthBase[symbol] + reader.Take(LengthExtra[symbol]);
+            reader.Refill();
+            int distanceSymbol = distances.Decode(reader);
+            if (distanceSymbol < 0 || distanceSymbol >= 30) {
+                return false;
+            }
+            size_t distance = DistanceBase[distanceSymbol] + reader.Take(DistanceExtra[distanceSymbol]);
+            if (distance > produced || length > outputLength - produced) {
+                return false;
+            }
+            // Overlapping copies repeat the last `distance` bytes, so they go a byte at a time.
+            const uint8_t* source = output + produced - distance;
+            uint8_t* destination = output + produced;
+            if (distance >= length) {
+                std::memcpy(destination, source, length);
+            }
+            else {
+                for (size_t i = 0; i < length; i++) {
+                    destination[i] = source[i];
+                }
+            }
+            produced += length;
+        }
+    }
+
+} // namespace
+
+namespace Decompress {
+
+    bool Inflate(const uint8_t* input, size_t inputLength, uint8_t* output, size_t outputLength) {
+        static const FixedCodes fixed;
+        BitReader reader(input, inputLength);
+        size_t produced = 0;
+        bool last = false;
+        while (!last) {
+            reader.Refill();
+            last = reader.Take(1) != 0;
+            uint32_t type = reader.Take(2);
+            if (type == 0) {
+                reader.AlignToByte();
+                reader.Refill();
+                uint32_t length = reader.Take(16);
+                uint32_t complement = reader.Take(16);
+                if ((length ^ 0xFFFF) != complement || length > outputLength - produced) {
+                    return false;
+                }
+                for (uint32_t i = 0; i < length; i++) {
+                    output[produced++] = static_cast<uint8_t>(reader.Take(8));
+                }
+            }
+            else if (type == 1) {
+                if (!InflateCodes(reader, fixed.Literals, fixed.Distances, output, outputLength, produced)) {
+                    return false;
+                }
+            }
+            else if (type == 2) {
+                Huffman literals;
+                Huffman distances;
+                if (!ReadDynamicCodes(reader, literals, distances) ||
+                    !InflateCodes(reader, literals, distances, output, outputLength, produced)) {
+                    return false;
+                }
+            }
+            else {
+                return false;
+            }
+            if (reader.Overrun()) {
+                return false;
+            }
+        }
+        return produced == outputLength;
+    }
+
+    bool Lz4Block(const uint8_t* input, size_t inputLength, uint8_t* output, size_t outputLength) {
+        const uint8_t* in = input;
+        const uint8_t* inEnd = input + inputLength;
+        size_t produced = 0;
+
+        while (in < inEnd) {
+            uint8_t token = *in++;
+            size_t literals = token >> 4;
+            // Lengths of 15 continue in the following bytes, each adding up to 255.
+            if (literals == 15) {
+                do {
+                    if (in == inEnd) {
+                        return false;
+                    }
+                    literals += *in;
+                } while (*in++ == 255);
+            }
+            if (literals > static_cast<size_t>(inEnd - in) || literals > outputLength - produced) {
+                return false;
+            }
+            std::memcpy(output + produced, in, literals);
+            in += literals;
+            produced += literals;
+            // The last sequence is literals only; anything after a full block is padding.
+            if (produced == outputLength) {
+                return true;
+            }
+
+            if (inEnd - in < 2) {
+                return false;
+            }
+            size_t distance = in[0] | (in[1] << 8);
+            in += 2;
+            size_t length = token & 15;
+            if (length == 15) {
+                do {
+                    if (in == inEnd) {
+                        return false;
+                    }
+                    length += *in;
+                } while (*in++ == 255);
+            }
+            length += 4;
+            if (distance == 0 || distance > produced || length > outputLength - produced) {
+                return false;
+            }
+            const uint8_t* source = output + produced - distance;
+            uint8_t* destination = output + produced;
+            if (distance >= length) {
+                std::memcpy(destination, source, length);
+            }
+            else {
+                for (size_t i = 0; i < length; i++) {
+                    destination[i] = source[i];
+                }
+            }
+            produced += length;
+        }
+        return produced == outputLength;
+    }
+
+} // namespace Decompress
@@ -0,0 +1,20 @@
+#ifndef DECOMPRESS_H
+#define DECOMPRESS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Block decoders for compressed image containers. Each fills exactly `outputLength` bytes and
+// returns false if the input is malformed, ends early or would produce more or less than that.
+// Bytes after the end of the compressed stream (alignment padding) are ignored.
+namespace Decompress {
+
+    // Raw deflate (RFC 1951), no zlib or gzip wrapper.
+    bool Inflate(const uint8_t* input, size_t inputLength, uint8_t* output, size_t outputLength);
+
+    // One LZ4 block (not the frame format).
+    bool Lz4Block(const uint8_t* input, size_t inputLength, uint8_t* output, size_t outputLength);
+
+} // namespace Decompress
+
+#endif // DECOMPRESS_H
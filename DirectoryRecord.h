@@ -29,7 +29,7 @@ struct DirectoryRecord {
     BothEndianUInt32 ExtentLocation;
     BothEndianUInt32 DataLength;
     uint8_t RecordingDateTime[7];
-    FileFlags FileFlags;
+    ::FileFlags FileFlags;
     uint8_t FileUnitSize;
     uint8_t InterleaveGapSize;
     BothEndianUInt16 VolumeSequenceNumber;
@@ -37,7 +37,7 @@ struct DirectoryRecord {
     char FileIdentifier[256]; // Ensure buffer is large enough for file names
 
     bool IsDirectory() const {
-        return HasFlags(FileFlags, FileFlags::Directory);
+        return HasFlags(FileFlags, ::FileFlags::Directory);
     }
 
     uint32_t GetSize() const {
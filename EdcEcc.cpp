@@ -0,0 +1,390 @@
+#include "EdcEcc.h"
+#include "Checksum.h"
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DCFM_EDCECC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    constexpr size_t EdcOffsetMode1 = 2064;
+    constexpr size_t EdcOffsetForm1 = 2072;
+    constexpr size_t EdcOffsetForm2 = 2348;
+    constexpr size_t HeaderOffset = 12;
+    constexpr size_t POffset = 2076;
+    constexpr size_t QOffset = 2248;
+    // P covers 86 columns of 24 bytes and Q 52 diagonals of 43 bytes, both starting at the header.
+    constexpr size_t PColumns = 86;
+    constexpr size_t PRows = 24;
+    constexpr size_t QDiagonals = 52;
+    constexpr size_t QLength = 43;
+    constexpr size_t QSpan = 2236;
+
+    constexpr uint8_t SyncPattern[12] = { 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+
+    // Multiplication by x (i.e. 2) in GF(2^8) modulo x^8 + x^4 + x^3 + x^2 + 1, applied to every
+    // byte lane of `value` at once.
+    template <typename T>
+    constexpr T MultiplyByTwo(T value) {
+        constexpr T ones = static_cast<T>(static_cast<T>(~T(0)) / 0xFF);
+        return static_cast<T>(((value & static_cast<T>(ones * 0x7F)) << 1) ^ (((value >> 7) & ones) * 0x1D));
+    }
+
+    // Inverse of multiplication by 3 (x + 1), which turns the two running sums of a vector into
+    // its first parity byte.
+    constexpr std::array<uint8_t, 256> MakeDivideByThree() {
+        std::array<uint8_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            table[static_cast<uint8_t>(i ^ MultiplyByTwo<uint8_t>(static_cast<uint8_t>(i)))] = static_cast<uint8_t>(i);
+        }
+        return table;
+    }
+
+    constexpr std::array<uint8_t, 256> DivideByThree = MakeDivideByThree();
+
+    uint32_t LoadLE32(const uint8_t* data) {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    void StoreLE32(uint8_t* data, uint32_t value) {
+        data[0] = static_cast<uint8_t>(value);
+        data[1] = static_cast<uint8_t>(value >> 8);
+        data[2] = static_cast<uint8_t>(value >> 16);
+        data[3] = static_cast<uint8_t>(value >> 24);
+    }
+
+    uint8_t ToBcd(uint32_t value) {
+        return static_cast<uint8_t>((value / 10) << 4 | (value % 10));
+    }
+
+    void WriteAddress(uint8_t* header, uint32_t lba) {
+        uint32_t frames = lba + EdcEcc::AddressOffset;
+        header[0] = ToBcd(frames / (60 * 75));
+        header[1] = ToBcd(frames / 75 % 60);
+        header[2] = ToBcd(frames % 75);
+    }
+
+    // GF(2^8) arithmetic on a register of byte lanes: sixteen per SSE2 register, which every x86-64
+    // CPU has, eight per 64-bit word elsewhere.
+#ifdef DCFM_EDCECC_SSE2
+    struct Lanes {
+        using Vector = __m128i;
+        static constexpr size_t Width = 16;
+
+        static Vector Zero() { return _mm_setzero_si128(); }
+        static Vector Load(const uint8_t* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+        static void Store(uint8_t* data, Vector value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), value); }
+        static Vector Xor(Vector a, Vector b) { return _mm_xor_si128(a, b); }
+        // Byte pairs at `offsets[0..7]`, straight into the register; going through memory would
+        // stall on store forwarding.
+        static Vector GatherPairs(const uint8_t* source, const uint16_t* offsets) {
+            auto pair = [&](size_t i) {
+                uint16_t value;
+                std::memcpy(&value, source + offsets[i], sizeof(value));
+                return static_cast<short>(value);
+            };
+            return _mm_set_epi16(pair(7), pair(6), pair(5), pair(4), pair(3), pair(2), pair(1), pair(0));
+        }
+        // Lanes with the top bit set compare below zero and pick up the reduction.
+        static Vector Double(Vector value) {
+            Vector carry = _mm_and_si128(_mm_cmplt_epi8(value, _mm_setzero_si128()), _mm_set1_epi8(0x1D));
+            return _mm_xor_si128(_mm_add_epi8(value, value), carry);
+        }
+    };
+#else
+    struct Lanes {
+        using Vector = uint64_t;
+        static constexpr size_t Width = 8;
+
+        static Vector Zero() { return 0; }
+        static Vector Load(const uint8_t* data) {
+            Vector value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        static void Store(uint8_t* data, Vector value) { std::memcpy(data, &value, sizeof(value)); }
+        static Vector Xor(Vector a, Vector b) { return a ^ b; }
+        static Vector GatherPairs(const uint8_t* source, const uint16_t* offsets) {
+            uint8_t pairs[Width];
+            for (size_t i = 0; i < Width / 2; i++) {
+                std::memcpy(pairs + i * 2, source + offsets[i], 2);
+            }
+            return Load(pairs);
+        }
+        static Vector Double(Vector value) { return MultiplyByTwo(value); }
+    };
+#endif
+
+    // Turns the running sums of each vector into its two parity bytes.
+    void FinishParity(const uint8_t* sumA, const uint8_t* sumB, size_t vectors, uint8_t* parity) {
+        for (size_t i = 0; i < vectors; i++) {
+            uint8_t first = DivideByThree[MultiplyByTwo(sumA[i]) ^ sumB[i]];
+            parity[i] = first;
+            parity[i + vectors] = first ^ sumB[i];
+        }
+    }
+
+    // Each P column is a run of 24 bytes 86 apart, so a row of the 24 holds one byte of every
+    // column and a handful of registers carry all 86 columns through the row at once.
+    void ComputeP(const uint8_t* source, uint8_t* parity) {
+        constexpr size_t Vectors = (PColumns + Lanes::Width - 1) / Lanes::Width;
+        Lanes::Vector a[Vectors];
+        Lanes::Vector b[Vectors];
+        for (size_t i = 0; i < Vectors; i++) {
+            a[i] = b[i] = Lanes::Zero();
+        }
+        for (size_t row = 0; row < PRows; row++) {
+            // The lanes past the 86th run into the next row; they are never used.
+            const uint8_t* data = source + row * PColumns;
+            for (size_t i = 0; i < Vectors; i++) {
+                Lanes::Vector value = Lanes::Load(data + i * Lanes::Width);
+                a[i] = Lanes::Double(Lanes::Xor(a[i], value));
+                b[i] = Lanes::Xor(b[i], value);
+            }
+        }
+        uint8_t sumA[Vectors * Lanes::Width];
+        uint8_t sumB[Vectors * Lanes::Width];
+        for (size_t i = 0; i < Vectors; i++) {
+            Lanes::Store(sumA + i * Lanes::Width, a[i]);
+            Lanes::Store(sumB + i * Lanes::Width, b[i]);
+        }
+        FinishParity(sumA, sumB, PColumns, parity);
+    }
+
+    // Q diagonal pairs step 88 bytes at a time through the 2236 bytes of header, data and P
+    // parity, wrapping around. Both bytes at each step belong to neighbouring diagonals, so each
+    // step gathers the two bytes of every pair and works all 52 diagonals at once, like P.
+    constexpr size_t QVectors = (QDiagonals + Lanes::Width - 1) / Lanes::Width;
+    // Padded to whole registers; the spare lanes gather offset 0 and are never used.
+    using QOffsets = std::array<std::array<uint16_t, QVectors * Lanes::Width / 2>, QLength>;
+
+    constexpr QOffsets MakeQOffsets() {
+        QOffsets offsets{};
+        for (size_t step = 0; step < QLength; step++) {
+            for (size_t pair = 0; pair < QDiagonals / 2; pair++) {
+                offsets[step][pair] = static_cast<uint16_t>((pair * PColumns + step * (PColumns + 2)) % QSpan);
+            }
+        }
+        return offsets;
+    }
+
+    constexpr QOffsets QGather = MakeQOffsets();
+
+    void ComputeQ(const uint8_t* source, uint8_t* parity) {
+        constexpr size_t Vectors = QVectors;
+        Lanes::Vector a[Vectors];
+        Lanes::Vector b[Vectors];
+        for (size_t i = 0; i < Vectors; i++) {
+            a[i] = b[i] = Lanes::Zero();
+        }
+        for (size_t step = 0; step < QLength; step++) {
+            for (size_t i = 0; i < Vectors; i++) {
+                Lanes::Vector value = Lanes::GatherPairs(source, QGather[step].data() + i * Lanes::Width / 2);
+                a[i] = Lanes::Double(Lanes::Xor(a[i], value));
+                b[i] = Lanes::Xor(b[i], value);
+            }
+        }
+        uint8_t sumA[Vectors * Lanes::Width];
+        uint8_t sumB[Vectors * Lanes::Width];
+        for (size_t i = 0; i < Vectors; i++) {
+            Lanes::Store(sumA + i * Lanes::Width, a[i]);
+            Lanes::Store(sumB + i * Lanes::Width, b[i]);
+        }
+        FinishParity(sumA, sumB, QDiagonals, parity);
+    }
+
+    bool IsForm2(const uint8_t* sector) {
+        return (sector[18] & 0x20) != 0;
+    }
+
+    struct GaloisTables {
+        std::array<uint8_t, 255> Exp{};
+        std::array<uint8_t, 256> Log{};
+    };
+
+    constexpr GaloisTables MakeGaloisTables() {
+        GaloisTables tables;
+        uint8_t value = 1;
+        for (uint32_t i = 0; i < 255; i++) {
+            tables.Exp[i] = value;
+            tables.Log[value] = static_cast<uint8_t>(i);
+            value = MultiplyByTwo(value);
+        }
+        return tables;
+    }
+
+    constexpr GaloisTables Galois = MakeGaloisTables();
+
+    enum class CodewordState { Clean, Fixed, Failed };
+
+    // Each P and Q codeword can locate and fix one wrong byte: the first syndrome is its value and
+    // the second, divided by the first, gives its position. `offsetOf(j)` is the position of the
+    // codeword's j-th byte, counted from the header, with the two parity bytes last.
+    template <typename OffsetOf>
+    CodewordState CorrectCodeword(uint8_t* region, size_t length, OffsetOf offsetOf) {
+        uint8_t s0 = 0;
+        uint8_t s1 = 0;
+        for (size_t j = 0; j < length; j++) {
+            uint8_t value = region[offsetOf(j)];
+            s0 ^= value;
+            s1 = static_cast<uint8_t>(MultiplyByTwo(s1) ^ value);
+        }
+        if (s0 == 0 && s1 == 0) {
+            return CodewordState::Clean;
+        }
+        if (s0 == 0 || s1 == 0) {
+            return CodewordState::Failed;
+        }
+        size_t fromEnd = (Galois.Log[s1] + 255 - Galois.Log[s0]) % 255;
+        if (fromEnd >= length) {
+            return CodewordState::Failed;
+        }
+        region[offsetOf(length - 1 - fromEnd)] ^= s0;
+        return CodewordState::Fixed;
+    }
+
+    // P and Q cross, so a byte one of them cannot fix may be fixable once the other has removed
+    // the rest of the errors in its codeword.
+    constexpr int CorrectionPasses = 4;
+
+} // namespace
+
+namespace EdcEcc {
+
+    SectorCheck Check(const uint8_t* sector, uint32_t lba) {
+        SectorCheck check;
+        if (std::memcmp(sector, SyncPattern, sizeof(SyncPattern)) != 0) {
+            return check;
+        }
+        uint8_t address[3];
+        WriteAddress(address, lba);
+        check.AddressValid = std::memcmp(sector + HeaderOffset, address, sizeof(address)) == 0;
+
+        switch (sector[15]) {
+        case 0:
+            check.Kind = SectorKind::Empty;
+            check.EdcValid = check.EccValid = true;
+            return check;
+        case 1:
+            check.Kind = SectorKind::Mode1;
+            check.EdcValid = Checksum::Edc(sector, EdcOffsetMode1) == LoadLE32(sector + EdcOffsetMode1);
+            break;
+        case 2:
+            if (IsForm2(sector)) {
+                check.Kind = SectorKind::Mode2Form2;
+                uint32_t stored = LoadLE32(sector + EdcOffsetForm2);
+                check.EdcValid = stored == 0 || Checksum::Edc(sector + 16, EdcOffsetForm2 - 16) == stored;
+                check.EccValid = true;
+                return check;
+            }
+            check.Kind = SectorKind::Mode2Form1;
+            check.EdcValid = Checksum::Edc(sector + 16, EdcOffsetForm1 - 16) == LoadLE32(sector + EdcOffsetForm1);
+            break;
+        default:
+            check.Kind = SectorKind::Unknown;
+            return check;
+        }
+
+        // Mode 2 computes the ECC as if the header were zero.
+        uint8_t copy[RawSectorSize];
+        const uint8_t* source = sector;
+        if (check.Kind == SectorKind::Mode2Form1) {
+            std::memcpy(copy, sector, RawSectorSize);
+            std::memset(copy + HeaderOffset, 0, 4);
+            source = copy;
+        }
+        uint8_t p[PColumns * 2];
+        uint8_t q[QDiagonals * 2];
+        ComputeP(source + HeaderOffset, p);
+        ComputeQ(source + HeaderOffset, q);
+        check.EccValid = std::memcmp(p, sector + POffset, sizeof(p)) == 0 && std::memcmp(q, sector + QOffset, sizeof(q)) == 0;
+        return check;
+    }
+
+    void Regenerate(uint8_t* sector) {
+        uint8_t header[4];
+        switch (sector[15]) {
+        case 1:
+            StoreLE32(sector + EdcOffsetMode1, Checksum::Edc(sector, EdcOffsetMode1));
+            std::memset(sector + EdcOffsetMode1 + 4, 0, POffset - EdcOffsetMode1 - 4);
+            ComputeP(sector + HeaderOffset, sector + POffset);
+            ComputeQ(sector + HeaderOffset, sector + QOffset);
+            break;
+        case 2:
+            if (IsForm2(sector)) {
+                StoreLE32(sector + EdcOffsetForm2, Checksum::Edc(sector + 16, EdcOffsetForm2 - 16));
+                break;
+            }
+            StoreLE32(sector + EdcOffsetForm1, Checksum::Edc(sector + 16, EdcOffsetForm1 - 16));
+            std::memcpy(header, sector + HeaderOffset, sizeof(header));
+            std::memset(sector + HeaderOffset, 0, sizeof(header));
+            ComputeP(sector + HeaderOffset, sector + POffset);
+            ComputeQ(sector + HeaderOffset, sector + QOffset);
+            std::memcpy(sector + HeaderOffset, header, sizeof(header));
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool Correct(uint8_t* sector) {
+        if (sector[15] != 1 && (sector[15] != 2 || IsForm2(sector))) {
+            return false;
+        }
+        const bool mode2 = sector[15] == 2;
+        uint8_t copy[RawSectorSize];
+        std::memcpy(copy, sector, RawSectorSize);
+        if (mode2) {
+            std::memset(copy + HeaderOffset, 0, 4);
+        }
+
+        uint8_t* region = copy + HeaderOffset;
+        for (int pass = 0; pass < CorrectionPasses; pass++) {
+            bool changed = false;
+            bool clean = true;
+            auto note = [&](CodewordState state) {
+                changed |= state == CodewordState::Fixed;
+                clean &= state == CodewordState::Clean;
+            };
+            for (size_t column = 0; column < PColumns; column++) {
+                note(CorrectCodeword(region, PRows + 2, [column](size_t j) { return j * PColumns + column; }));
+            }
+            for (size_t diagonal = 0; diagonal < QDiagonals; diagonal++) {
+                note(CorrectCodeword(region, QLength + 2, [diagonal](size_t j) {
+                    if (j >= QLength) {
+                        return QSpan + (j - QLength) * QDiagonals + diagonal;
+                    }
+                    return (diagonal / 2 * PColumns + j * (PColumns + 2)) % QSpan + diagonal % 2;
+                }));
+            }
+            if (clean || !changed) {
+                break;
+            }
+        }
+
+        if (mode2) {
+            std::memcpy(copy + HeaderOffset, sector + HeaderOffset, 4);
+        }
+        SectorCheck check = Check(copy, 0);
+        if (!check.EdcValid || !check.EccValid) {
+            return false;
+        }
+        std::memcpy(sector, copy, RawSectorSize);
+        return true;
+    }
+
+    void WriteHeader(uint8_t* sector, uint32_t lba, uint8_t mode) {
+        std::memcpy(sector, SyncPattern, sizeof(SyncPattern));
+        WriteAddress(sector + HeaderOffset, lba);
+        sector[15] = mode;
+    }
+
+    void Encode(uint8_t* sector, uint32_t lba, uint8_t mode) {
+        WriteHeader(sector, lba, mode);
+        Regenerate(sector);
+    }
+
+} // namespace EdcEcc
@@ -0,0 +1,51 @@
+#ifndef EDCECC_H
+#define EDCECC_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Error detection and correction codes of raw 2352-byte CD sectors (ECMA-130): the EDC, a CRC-32
+// over the sector, and the ECC, Reed-Solomon product code P and Q parity over GF(2^8).
+namespace EdcEcc {
+
+    constexpr size_t RawSectorSize = 2352;
+    // LBA 0 sits two seconds (150 frames) into the disc.
+    constexpr uint32_t AddressOffset = 150;
+
+    enum class SectorKind {
+        NoSync,         // No sync pattern, e.g. a sector the drive could not read
+        Empty,          // Mode 0
+        Mode1,
+        Mode2Form1,
+        Mode2Form2,     // EDC only, no ECC; an EDC of zero means none was recorded
+        Unknown         // A mode other than 0, 1 or 2
+    };
+
+    struct SectorCheck {
+        SectorKind Kind = SectorKind::NoSync;
+        bool AddressValid = false;  // The header holds the sector's own address
+        bool EdcValid = false;
+        bool EccValid = false;      // Also true for sectors without ECC
+    };
+
+    SectorCheck Check(const uint8_t* sector, uint32_t lba);
+
+    // Recomputes the EDC and ECC of a sector for the mode in its header, after its user data or
+    // subheader changed. Sectors of other modes are left alone.
+    void Regenerate(uint8_t* sector);
+
+    // Fixes what the P and Q parity can of a mode 1 or mode 2 form 1 sector: one wrong byte per
+    // codeword, alternating between the two until nothing changes. Returns true, with the sector
+    // corrected, if its EDC and ECC then match; otherwise the sector is left as it was.
+    bool Correct(uint8_t* sector);
+
+    // Writes the sync pattern and a header for `lba` in `mode`.
+    void WriteHeader(uint8_t* sector, uint32_t lba, uint8_t mode);
+
+    // WriteHeader, then Regenerate. The user data and, for mode 2, the subheader must already be
+    // in place.
+    void Encode(uint8_t* sector, uint32_t lba, uint8_t mode);
+
+} // namespace EdcEcc
+
+#endif // EDCECC_H
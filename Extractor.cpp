@@ -0,0 +1,217 @@
+#include "Extractor.h"
+#include "AsyncReader.h"
+#include "WorkerPool.h"
+#include "Log.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    constexpr uint64_t ChunkSize = 4 * 1024 * 1024;
+
+    // Splits a record or user path into components, accepting both '\' and '/'.
+    std::vector<std::string> SplitPath(const std::string& path) {
+        std::vector<std::string> components;
+        std::string current;
+        for (char c : path) {
+            if (c == '\\' || c == '/') {
+                if (!current.empty()) {
+                    components.push_back(std::move(current));
+                    current.clear();
+                }
+            }
+            else {
+                current += c;
+            }
+        }
+        if (!current.empty()) {
+            components.push_back(std::move(current));
+        }
+        return components;
+    }
+
+    std::string StripVersion(const std::string& name) {
+        size_t separator = name.rfind(';');
+        return separator == std::string::npos ? name : name.substr(0, separator);
+    }
+
+    bool IsUnderSubtree(const std::vector<std::string>& components, const std::vector<std::string>& subtree) {
+        if (subtree.size() > components.size()) {
+            return false;
+        }
+        return std::equal(subtree.begin(), subtree.end(), components.begin());
+    }
+
+} // namespace
+
+Extractor::Extractor(ISO& iso, ExtractionOptions options)
+    : iso(iso), options(options) {
+}
+
+ExtractionStats Extractor::ExtractAll(const std::filesystem::path& outputDirectory) {
+    return Extract(std::string(), outputDirectory);
+}
+
+ExtractionStats Extractor::ExtractSubtree(const std::string& subtreePath, const std::filesystem::path& outputDirectory) {
+    return Extract(subtreePath, outputDirectory);
+}
+
+std::filesystem::path Extractor::GetRelativeOutputPath(const std::string& recordPath) const {
+    std::vector<std::string> components = SplitPath(recordPath);
+    std::filesystem::path relativePath;
+    for (const auto& component : components) {
+        relativePath /= StripVersion(component);
+    }
+    return relativePath;
+}
+
+ExtractionStats Extractor::Extract(const std::string& subtreePath, const std::filesystem::path& outputDirectory) {
+    Metrics::ScopedTimer timer(Phase::Extraction);
+    auto startTime = std::chrono::steady_clock::now();
+    const FileIndex& index = iso.GetIndex();
+    std::vector<std::string> subtree = SplitPath(subtreePath);
+    std::vector<ExtractionTarget> work;
+
+    // Sequential source reads: visit extents in the order they sit in the image.
+    for (uint32_t id : index.GetLBAOrder()) {
+        if (index.IsDirectory(id)) {
+            continue;
+        }
+        std::string path = index.GetPath(id);
+        if (!IsUnderSubtree(SplitPath(path), subtree)) {
+            continue;
+        }
+        work.push_back({ iso.GetImageOffset(id), index.GetSize(id), outputDirectory / GetRelativeOutputPath(path) });
+    }
+
+    if (work.empty() && !subtree.empty()) {
+        throw std::runtime_error("No files found under " + subtreePath + ".");
+    }
+
+    // Create the output tree up front so writers never race on directory creation.
+    std::filesystem::create_directories(outputDirectory);
+    for (const auto& item : work) {
+        std::filesystem::create_directories(item.OutputPath.parent_path());
+    }
+
+    ExtractionStats stats = WriteFiles(*iso.GetReader(), iso.GetFileName(), work, options);
+    stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    Metrics::Add(Counter::FilesExtracted, stats.Files);
+    Metrics::Add(Counter::BytesExtracted, stats.Bytes);
+    LOG_INFO("Extracted " << stats.Files << " files (" << stats.Bytes << " bytes) in " << stats.Seconds << " s: "
+        << stats.MegabytesPerSecond() << " MB/s, " << stats.FilesPerSecond() << " files/s");
+    return stats;
+}
+
+ExtractionStats Extractor::WriteFiles(ImageReader& reader, const std::string& path,
+    const std::vector<ExtractionTarget>& targets, const ExtractionOptions& options) {
+    struct WriteState {
+        std::mutex Mutex;
+        std::deque<FileView> Pending;
+        bool Busy = false;
+        bool Failed = false;
+        std::unique_ptr<std::ofstream> Output;  // Open from the first chunk to the last
+        uint64_t Written = 0;
+    };
+
+    // Chunks are tagged with their target; sorting keeps each target's chunks in order. Empty
+    // files still get one (empty) chunk, so they are created.
+    const uint64_t chunkSize = std::max<uint64_t>(1, std::min<uint64_t>(ChunkSize, options.MaxBytesInFlight));
+    std::vector<AsyncReadRequest> requests;
+    requests.reserve(targets.size());
+    for (size_t i = 0; i < targets.size(); i++) {
+        uint64_t position = 0;
+        do {
+            uint64_t length = std::min(targets[i].Size - position, chunkSize);
+            requests.push_back({ targets[i].Offset + position, length, i });
+            position += length;
+        } while (position < targets[i].Size);
+    }
+
+    // The reader's buffers are released as the writes finish, so the pool must go first.
+    std::vector<WriteState> states(targets.size());
+    AsyncReadOptions readOptions;
+    readOptions.QueueDepth = options.QueueDepth;
+    readOptions.MaxBytesInFlight = options.MaxBytesInFlight;
+    AsyncReader source(reader, path, readOptions);
+    WorkerPool pool(options.ThreadCount);
+    source.Start(std::move(requests));
+
+    auto drain = [&states, &targets](size_t target) {
+        WriteState& state = states[target];
+        const std::filesystem::path& outputPath = targets[target].OutputPath;
+        bool failed = false;
+        for (;;) {
+            FileView chunk;
+            {
+                std::lock_guard<std::mutex> lock(state.Mutex);
+                if (state.Pending.empty()) {
+                    state.Busy = false;
+                    break;
+                }
+                chunk = std::move(state.Pending.front());
+                state.Pending.pop_front();
+            }
+            // The rest of a file that failed is dropped, so its buffers still go back to the reader.
+            if (state.Failed) {
+                continue;
+            }
+            if (!state.Output) {
+                state.Output = std::make_unique<std::ofstream>(outputPath, std::ios::binary | std::ios::trunc);
+            }
+            bool written = state.Output->is_open() &&
+                state.Output->write(reinterpret_cast<const char*>(chunk.Data()), static_cast<std::streamsize>(chunk.Size()));
+            state.Written += chunk.Size();
+            if (written && state.Written == targets[target].Size) {
+                state.Output->close();
+                written = static_cast<bool>(*state.Output);
+                state.Output.reset();
+            }
+            if (!written) {
+                state.Failed = failed = true;
+                state.Output.reset();
+            }
+        }
+        if (failed) {
+            throw std::runtime_error("Failed to write " + outputPath.string() + ".");
+        }
+    };
+
+    ExtractionStats stats;
+    AsyncReadResult read;
+    try {
+        while (source.Next(read)) {
+            size_t target = static_cast<size_t>(read.Tag);
+            bool start;
+            {
+                std::lock_guard<std::mutex> lock(states[target].Mutex);
+                states[target].Pending.push_back(std::move(read.Data));
+                start = !states[target].Busy;
+                states[target].Busy = true;
+            }
+            if (start) {
+                pool.Submit([&drain, target]() { drain(target); });
+            }
+        }
+    }
+    catch (...) {
+        pool.Wait();
+        throw;
+    }
+    pool.Wait();
+
+    stats.Files = targets.size();
+    for (const auto& target : targets) {
+        stats.Bytes += target.Size;
+    }
+    stats.PeakBytesInFlight = source.GetPeakBytesInFlight();
+    return stats;
+}
@@ -0,0 +1,61 @@
+#ifndef EXTRACTOR_H
+#define EXTRACTOR_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "ImageReader.h"
+#include "ISO.h"
+
+struct ExtractionOptions {
+    size_t ThreadCount = 0;                         // 0 = one writer per hardware thread
+    uint64_t MaxBytesInFlight = 256ull * 1024 * 1024; // Hard cap on file data held by queued writes
+    size_t QueueDepth = 16;                         // Image reads kept in flight (see AsyncReader)
+};
+
+struct ExtractionStats {
+    uint64_t Files = 0;
+    uint64_t Bytes = 0;
+    uint64_t PeakBytesInFlight = 0;
+    double Seconds = 0.0;
+
+    double MegabytesPerSecond() const { return Seconds > 0.0 ? Bytes / (1024.0 * 1024.0) / Seconds : 0.0; }
+    double FilesPerSecond() const { return Seconds > 0.0 ? Files / Seconds : 0.0; }
+};
+
+// A range of an image to be written out as a file of its own.
+struct ExtractionTarget {
+    uint64_t Offset;
+    uint64_t Size;
+    std::filesystem::path OutputPath;
+};
+
+// Writes the files of a loaded ISO to disk. Files are read from the image in ExtentLocation
+// order by an AsyncReader, so the source is scanned front to back with several reads in flight,
+// while the writes fan out over a worker pool. Files are read in chunks no larger than the
+// in-flight cap and each one's chunks are appended in order, so no file is ever held whole.
+class Extractor {
+public:
+    Extractor(ISO& iso, ExtractionOptions options = {});
+
+    ExtractionStats ExtractAll(const std::filesystem::path& outputDirectory);
+    // `subtreePath` is relative to the image root, e.g. "DATA" or "DATA\\SUB"; either separator works.
+    ExtractionStats ExtractSubtree(const std::string& subtreePath, const std::filesystem::path& outputDirectory);
+
+    // Output location of an index path (see FileIndex::GetPath) with ";1" version suffixes removed.
+    std::filesystem::path GetRelativeOutputPath(const std::string& recordPath) const;
+
+    // The pipeline behind Extract(), for any image: writes every target's range of `reader` (the
+    // file at `path`), whose output directories must already exist. Seconds is left at 0.
+    static ExtractionStats WriteFiles(ImageReader& reader, const std::string& path,
+        const std::vector<ExtractionTarget>& targets, const ExtractionOptions& options);
+
+private:
+    ExtractionStats Extract(const std::string& subtreePath, const std::filesystem::path& outputDirectory);
+
+    ISO& iso;
+    ExtractionOptions options;
+};
+
+#endif // EXTRACTOR_H
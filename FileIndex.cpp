@@ -0,0 +1,377 @@
+#include "FileIndex.h"
+#include "ImageReader.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+namespace {
+
+    constexpr uint64_t FnvOffsetBasis = 14695981039346656037ull;
+    constexpr uint64_t FnvPrime = 1099511628211ull;
+    constexpr uint32_t EmptySlot = 0xFFFFFFFF;
+
+    // Identifier without its version suffix or empty extension: "README.;1" -> "README".
+    std::string_view TrimComponent(std::string_view name) {
+        size_t version = name.rfind(';');
+        if (version != std::string_view::npos) {
+            name = name.substr(0, version);
+        }
+        if (!name.empty() && name.back() == '.') {
+            name.remove_suffix(1);
+        }
+        return name;
+    }
+
+    char FoldCase(char c) {
+        return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+    }
+
+    uint64_t HashComponent(uint64_t hash, std::string_view component, bool first) {
+        if (!first) {
+            hash = (hash ^ static_cast<uint8_t>('/')) * FnvPrime;
+        }
+        for (char c : component) {
+            hash = (hash ^ static_cast<uint8_t>(FoldCase(c))) * FnvPrime;
+        }
+        return hash;
+    }
+
+    bool ComponentsEqual(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return FoldCase(x) == FoldCase(y);
+        });
+    }
+
+    std::vector<std::string_view> SplitQuery(std::string_view path) {
+        std::vector<std::string_view> components;
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = path.find_first_of("/\\", start);
+            if (end == std::string_view::npos) {
+                end = path.size();
+            }
+            std::string_view component = TrimComponent(path.substr(start, end - start));
+            if (!component.empty()) {
+                components.push_back(component);
+            }
+            start = end + 1;
+        }
+        return components;
+    }
+
+    constexpr char CacheMagic[8] = { 'D', 'C', 'F', 'M', 'I', 'D', 'X', '\0' };
+    constexpr uint32_t CacheVersion = 1;
+
+    struct CacheHeader {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t EntryCount;
+        uint64_t ImageSize;
+        int64_t ImageModifiedTime;
+        uint64_t DescriptorHash;
+        uint64_t NamesSize;
+    };
+
+    size_t AlignCacheOffset(size_t offset) {
+        return (offset + 7) & ~size_t(7);
+    }
+
+} // namespace
+
+void FileIndex::Clear() {
+    lbas.clear();
+    sizes.clear();
+    parents.clear();
+    nameOffsets.clear();
+    nameLengths.clear();
+    flags.clear();
+    recordingDateTimes.clear();
+    names.clear();
+    lbaOrder.clear();
+    childOffsets.clear();
+    childIds.clear();
+    displayNameOffsets.clear();
+    displayNames.clear();
+    lookupSlots.clear();
+}
+
+void FileIndex::Reserve(size_t entryCount, size_t nameBytes) {
+    lbas.reserve(entryCount);
+    sizes.reserve(entryCount);
+    parents.reserve(entryCount);
+    nameOffsets.reserve(entryCount);
+    nameLengths.reserve(entryCount);
+    flags.reserve(entryCount);
+    recordingDateTimes.reserve(entryCount);
+    names.reserve(nameBytes);
+}
+
+uint32_t FileIndex::Add(uint32_t parent, std::string_view name, const DirectoryRecord& record) {
+    uint32_t id = static_cast<uint32_t>(lbas.size());
+    size_t nameLength = std::min<size_t>(name.size(), 255);
+
+    lbas.push_back(record.ExtentLocation.Value());
+    sizes.push_back(record.DataLength.Value());
+    parents.push_back(parent);
+    nameOffsets.push_back(static_cast<uint32_t>(names.size()));
+    nameLengths.push_back(static_cast<uint8_t>(nameLength));
+    flags.push_back(record.FileFlags);
+
+    std::array<uint8_t, 7> dateTime;
+    std::memcpy(dateTime.data(), record.RecordingDateTime, dateTime.size());
+    recordingDateTimes.push_back(dateTime);
+
+    names.append(name.data(), nameLength);
+    return id;
+}
+
+void FileIndex::Finalize() {
+    lbaOrder.resize(lbas.size());
+    std::iota(lbaOrder.begin(), lbaOrder.end(), 0u);
+    std::stable_sort(lbaOrder.begin(), lbaOrder.end(), [this](uint32_t a, uint32_t b) {
+        return lbas[a] < lbas[b];
+    });
+
+    // Children as one flat array grouped by parent; counting first keeps each group in tree order.
+    const size_t count = lbas.size();
+    childOffsets.assign(count + 1, 0);
+    for (uint32_t id = 0; id < count; id++) {
+        if (parents[id] != NoParent) {
+            childOffsets[parents[id] + 1]++;
+        }
+    }
+    std::partial_sum(childOffsets.begin(), childOffsets.end(), childOffsets.begin());
+    childIds.resize(childOffsets[count]);
+    std::vector<uint32_t> cursor(childOffsets.begin(), childOffsets.end() - 1);
+    for (uint32_t id = 0; id < count; id++) {
+        if (parents[id] != NoParent) {
+            childIds[cursor[parents[id]]++] = id;
+        }
+    }
+
+    // ISO9660 identifiers are single-byte d-characters, so widening is a per-byte copy.
+    displayNameOffsets.resize(count);
+    displayNames.clear();
+    displayNames.reserve(names.size() + count);
+    for (uint32_t id = 0; id < count; id++) {
+        std::string_view name = TrimComponent(GetName(id));
+
+        displayNameOffsets[id] = static_cast<uint32_t>(displayNames.size());
+        for (char c : name) {
+            displayNames += static_cast<wchar_t>(static_cast<unsigned char>(c));
+        }
+        displayNames += L'\0';
+    }
+
+    // Hash every path once, reusing the parent's hash (parents always have lower ids).
+    size_t slotCount = 16;
+    while (slotCount < count * 2) {
+        slotCount <<= 1;
+    }
+    lookupSlots.assign(slotCount, EmptySlot);
+    std::vector<uint64_t> pathHashes(count, FnvOffsetBasis);
+    for (uint32_t id = 0; id < count; id++) {
+        if (parents[id] == NoParent) {
+            continue;
+        }
+        uint32_t parent = parents[id];
+        pathHashes[id] = HashComponent(pathHashes[parent], TrimComponent(GetName(id)), parent == RootId);
+
+        size_t slot = pathHashes[id] & (slotCount - 1);
+        while (lookupSlots[slot] != EmptySlot) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        lookupSlots[slot] = id;
+    }
+}
+
+std::optional<uint32_t> FileIndex::Find(std::string_view path) const {
+    std::vector<std::string_view> components = SplitQuery(path);
+    if (components.empty()) {
+        return lbas.empty() ? std::nullopt : std::optional<uint32_t>(RootId);
+    }
+    if (lookupSlots.empty()) {
+        return std::nullopt;
+    }
+
+    uint64_t hash = FnvOffsetBasis;
+    for (size_t i = 0; i < components.size(); i++) {
+        hash = HashComponent(hash, components[i], i == 0);
+    }
+
+    const size_t mask = lookupSlots.size() - 1;
+    for (size_t slot = hash & mask; lookupSlots[slot] != EmptySlot; slot = (slot + 1) & mask) {
+        // Confirm the candidate by walking its parent chain against the query from the leaf up.
+        uint32_t current = lookupSlots[slot];
+        size_t depth = components.size();
+        while (depth > 0 && current != RootId && current != NoParent &&
+            ComponentsEqual(TrimComponent(GetName(current)), components[depth - 1])) {
+            current = parents[current];
+            depth--;
+        }
+        if (depth == 0 && current == RootId) {
+            return lookupSlots[slot];
+        }
+    }
+    return std::nullopt;
+}
+
+std::string FileIndex::GetPath(uint32_t id, char separator) const {
+    // Collect the chain up to (but excluding) the root, then emit it top-down.
+    uint32_t chain[256];
+    size_t depth = 0;
+    for (uint32_t current = id; current != RootId && current != NoParent && depth < 256; current = parents[current]) {
+        chain[depth++] = current;
+    }
+
+    std::string path;
+    while (depth > 0) {
+        path.append(GetName(chain[--depth]));
+        if (depth > 0) {
+            path += separator;
+        }
+    }
+    return path;
+}
+
+DirectoryRecord FileIndex::ToDirectoryRecord(uint32_t id) const {
+    DirectoryRecord record = {};
+    std::string_view name = GetName(id);
+
+    record.FileIdentifierLength = static_cast<uint8_t>(name.size());
+    record.Length = static_cast<uint8_t>(33 + name.size() + ((name.size() & 1) == 0 ? 1 : 0));
+    record.ExtentLocation.SetValue(lbas[id]);
+    record.DataLength.SetValue(sizes[id]);
+    std::memcpy(record.RecordingDateTime, recordingDateTimes[id].data(), 7);
+    record.FileFlags = flags[id];
+    record.VolumeSequenceNumber.SetValue(1);
+    std::memcpy(record.FileIdentifier, name.data(), name.size());
+    record.FileIdentifier[name.size()] = '\0';
+    return record;
+}
+
+size_t FileIndex::GetMemoryUsage() const {
+    return lbas.capacity() * sizeof(uint32_t) +
+        sizes.capacity() * sizeof(uint32_t) +
+        parents.capacity() * sizeof(uint32_t) +
+        nameOffsets.capacity() * sizeof(uint32_t) +
+        nameLengths.capacity() * sizeof(uint8_t) +
+        flags.capacity() * sizeof(FileFlags) +
+        recordingDateTimes.capacity() * sizeof(std::array<uint8_t, 7>) +
+        names.capacity() +
+        lbaOrder.capacity() * sizeof(uint32_t) +
+        childOffsets.capacity() * sizeof(uint32_t) +
+        childIds.capacity() * sizeof(uint32_t) +
+        displayNameOffsets.capacity() * sizeof(uint32_t) +
+        displayNames.capacity() * sizeof(wchar_t) +
+        lookupSlots.capacity() * sizeof(uint32_t);
+}
+
+bool FileIndex::SaveCache(const std::string& path, const IndexCacheKey& key) const {
+    CacheHeader header = {};
+    std::memcpy(header.Magic, CacheMagic, sizeof(CacheMagic));
+    header.Version = CacheVersion;
+    header.EntryCount = static_cast<uint32_t>(lbas.size());
+    header.ImageSize = key.ImageSize;
+    header.ImageModifiedTime = key.ImageModifiedTime;
+    header.DescriptorHash = key.DescriptorHash;
+    header.NamesSize = names.size();
+
+    std::vector<uint8_t> buffer;
+    auto append = [&buffer](const void* data, size_t size) {
+        buffer.resize(AlignCacheOffset(buffer.size()));
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    };
+    append(&header, sizeof(header));
+    append(lbas.data(), lbas.size() * sizeof(uint32_t));
+    append(sizes.data(), sizes.size() * sizeof(uint32_t));
+    append(parents.data(), parents.size() * sizeof(uint32_t));
+    append(nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t));
+    append(nameLengths.data(), nameLengths.size());
+    append(flags.data(), flags.size() * sizeof(FileFlags));
+    append(recordingDateTimes.data(), recordingDateTimes.size() * sizeof(std::array<uint8_t, 7>));
+    append(names.data(), names.size());
+
+    // Write next to the target and rename, so readers never see a half-written cache.
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!output.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()))) {
+            output.close();
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+bool FileIndex::LoadCache(const std::string& path, const IndexCacheKey& key) {
+    MappedImageReader file;
+    if (!file.Open(path) || file.Size() < sizeof(CacheHeader)) {
+        return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.Magic, CacheMagic, sizeof(CacheMagic)) != 0 || header.Version != CacheVersion ||
+        header.ImageSize != key.ImageSize || header.ImageModifiedTime != key.ImageModifiedTime ||
+        header.DescriptorHash != key.DescriptorHash || header.EntryCount == 0) {
+        return false;
+    }
+
+    // Size the arrays only once the file is known to hold them, so a damaged count cannot make
+    // the allocations below throw.
+    const size_t count = header.EntryCount;
+    const uint64_t bytesPerEntry = 4 * sizeof(uint32_t) + 1 + sizeof(FileFlags) + sizeof(std::array<uint8_t, 7>);
+    const uint64_t available = file.Size() - sizeof(CacheHeader);
+    if (header.NamesSize > available || count * bytesPerEntry > available - header.NamesSize) {
+        return false;
+    }
+
+    size_t offset = sizeof(CacheHeader);
+    bool truncated = false;
+    auto take = [&](void* destination, size_t size) {
+        offset = AlignCacheOffset(offset);
+        if (truncated || offset > file.Size() || size > file.Size() - offset) {
+            truncated = true;
+            return;
+        }
+        std::memcpy(destination, file.Data() + offset, size);
+        offset += size;
+    };
+
+    Clear();
+    lbas.resize(count);
+    sizes.resize(count);
+    parents.resize(count);
+    nameOffsets.resize(count);
+    nameLengths.resize(count);
+    flags.resize(count);
+    recordingDateTimes.resize(count);
+    names.resize(header.NamesSize);
+    take(lbas.data(), count * sizeof(uint32_t));
+    take(sizes.data(), count * sizeof(uint32_t));
+    take(parents.data(), count * sizeof(uint32_t));
+    take(nameOffsets.data(), count * sizeof(uint32_t));
+    take(nameLengths.data(), count);
+    take(flags.data(), count * sizeof(FileFlags));
+    take(recordingDateTimes.data(), count * sizeof(std::array<uint8_t, 7>));
+    take(names.data(), names.size());
+
+    // Structural checks so a corrupt cache can never produce out-of-range ids or names.
+    bool valid = !truncated && parents[RootId] == NoParent;
+    for (uint32_t id = 0; valid && id < count; id++) {
+        valid = (id == RootId || parents[id] < id) && static_cast<uint64_t>(nameOffsets[id]) + nameLengths[id] <= names.size();
+    }
+    if (!valid) {
+        Clear();
+        return false;
+    }
+
+    Finalize();
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef FILEINDEX_H
+#define FILEINDEX_H
+
+#include <array>
+#include <optional>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DirectoryRecord.h"
+
+// Identifies the exact image an on-disk index cache was built from.
+struct IndexCacheKey {
+    uint64_t ImageSize = 0;
+    int64_t ImageModifiedTime = 0;
+    uint64_t DescriptorHash = 0; // FNV-1a of the Primary Volume Descriptor sector
+
+    bool operator==(const IndexCacheKey& other) const {
+        return ImageSize == other.ImageSize && ImageModifiedTime == other.ImageModifiedTime &&
+            DescriptorHash == other.DescriptorHash;
+    }
+};
+
+// Compact structure-of-arrays index over every directory and file in an image. Entries are
+// numbered in tree order: the root is entry 0, and the contents of each directory occupy a
+// contiguous id range in the order they appear in its extent. Identifiers are stored once in a
+// single name arena instead of a 256-byte buffer per record.
+class FileIndex {
+public:
+    static constexpr uint32_t RootId = 0;
+    static constexpr uint32_t NoParent = 0xFFFFFFFF;
+
+    void Clear();
+    void Reserve(size_t entryCount, size_t nameBytes);
+    uint32_t Add(uint32_t parent, std::string_view name, const DirectoryRecord& record);
+    // Builds the LBA-ordered view, the children index, the display names and the path lookup table;
+    // call once all entries have been added.
+    void Finalize();
+
+    size_t Size() const { return lbas.size(); }
+    uint32_t GetLBA(uint32_t id) const { return lbas[id]; }
+    uint32_t GetSize(uint32_t id) const { return sizes[id]; }
+    FileFlags GetFlags(uint32_t id) const { return flags[id]; }
+    bool IsDirectory(uint32_t id) const { return HasFlags(flags[id], FileFlags::Directory); }
+    uint32_t GetParent(uint32_t id) const { return parents[id]; }
+    std::string_view GetName(uint32_t id) const { return std::string_view(names).substr(nameOffsets[id], nameLengths[id]); }
+
+    // Direct contents of a directory, in the order they appear in its extent.
+    std::span<const uint32_t> GetChildren(uint32_t id) const {
+        return std::span<const uint32_t>(childIds).subspan(childOffsets[id], childOffsets[id + 1] - childOffsets[id]);
+    }
+    // Identifier without the ";1" version suffix, widened for the UI and null-terminated.
+    const wchar_t* GetDisplayName(uint32_t id) const { return displayNames.c_str() + displayNameOffsets[id]; }
+
+    // Looks up an entry by its path below the image root, e.g. "DATA/DATA.DAT". Matching ignores case,
+    // accepts '/' or '\\' as separators and ignores ";1" version suffixes on either side.
+    std::optional<uint32_t> Find(std::string_view path) const;
+
+    // Path below the image root, e.g. "DATA\\DATA.DAT;1". The root itself has an empty path.
+    std::string GetPath(uint32_t id, char separator = '\\') const;
+    // Rebuilds a full DirectoryRecord for APIs that still take one.
+    DirectoryRecord ToDirectoryRecord(uint32_t id) const;
+
+    // Sidecar cache: a versioned header followed by each array at an 8-byte aligned offset, so the
+    // file can be mapped and copied out in bulk. LoadCache() fails (returning false) on any mismatch.
+    bool SaveCache(const std::string& path, const IndexCacheKey& key) const;
+    bool LoadCache(const std::string& path, const IndexCacheKey& key);
+
+    // Entry ids sorted by extent location (ties keep tree order).
+    const std::vector<uint32_t>& GetLBAOrder() const { return lbaOrder; }
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<uint32_t> lbas;
+    std::vector<uint32_t> sizes;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> nameOffsets;
+    std::vector<uint8_t> nameLengths;
+    std::vector<FileFlags> flags;
+    std::vector<std::array<uint8_t, 7>> recordingDateTimes;
+    std::string names;
+    std::vector<uint32_t> lbaOrder;
+    std::vector<uint32_t> childOffsets;
+    std::vector<uint32_t> childIds;
+    std::vector<uint32_t> displayNameOffsets;
+    std::wstring displayNames;
+    std::vector<uint32_t> lookupSlots; // Open-addressed table of ids keyed by normalized path hash
+};
+
+#endif // FILEINDEX_H
@@ -0,0 +1,57 @@
+#ifndef FILEVIEW_H
+#define FILEVIEW_H
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// Read-only view of a byte range of an image. Memory-mapped images are viewed in place without
+// copying; other backends hand the view a buffer it shares ownership of. Either way the bytes
+// stay valid for as long as the view and the ISO it came from are alive.
+class FileView {
+public:
+    FileView() = default;
+
+    FileView(const uint8_t* data, size_t size)
+        : data(data), size(size) {
+    }
+
+    explicit FileView(std::shared_ptr<std::vector<uint8_t>> buffer)
+        : data(buffer->data()), size(buffer->size()), owner(std::move(buffer)) {
+    }
+
+    // `length` bytes at `offset` within a buffer shared with other views.
+    FileView(std::shared_ptr<std::vector<uint8_t>> buffer, size_t offset, size_t length)
+        : data(buffer->data() + offset), size(length), owner(std::move(buffer)) {
+    }
+
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+    bool Empty() const { return size == 0; }
+    bool IsOwning() const { return owner != nullptr; }
+    std::span<const uint8_t> Span() const { return { data, size }; }
+
+    const uint8_t* begin() const { return data; }
+    const uint8_t* end() const { return data + size; }
+
+    // Copies the bytes into a vector, stealing the buffer instead when this view is its sole owner
+    // and covers all of it.
+    std::vector<uint8_t> ToVector() && {
+        if (owner && owner.use_count() == 1 && data == owner->data() && size == owner->size()) {
+            std::vector<uint8_t> result = std::move(*owner);
+            owner.reset();
+            data = nullptr;
+            size = 0;
+            return result;
+        }
+        return std::vector<uint8_t>(begin(), end());
+    }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<std::vector<uint8_t>> owner;
+};
+
+#endif // FILEVIEW_H
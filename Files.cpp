@@ -1,10 +1,38 @@
 #include "Files.h"
+#include "ArchiveIndex.h"
 #include "Bytes.h"
-#include <iostream>
+#include "Log.h"
+#include <algorithm>
 #include <fstream>
+#include <stdexcept>
 
 namespace Files {
 
+    namespace {
+
+        int ReadArchiveIndex(const std::string& filepath, ArchiveFormat format) {
+            ArchiveIndex index;
+            try {
+                index.Load(filepath, format);
+            }
+            catch (const std::exception& ex) {
+                LOG_ERROR("Failed to read archive index " << filepath << ": " << ex.what());
+                return -1;
+            }
+            LOG_DEBUG("Read " << index.Size() << " entries from " << filepath);
+            return 0;
+        }
+
+        std::streamoff GetStreamLength(std::ifstream& stream) {
+            std::streampos position = stream.tellg();
+            stream.seekg(0, std::ios::end);
+            std::streamoff length = stream.tellg();
+            stream.seekg(position);
+            return length;
+        }
+
+    } // namespace
+
     std::string IdentifyFileType(const std::vector<uint8_t>& headerBytes) {
         if (!headerBytes.empty() && headerBytes[0] == 0x01) {
             return "ISO File";
@@ -12,45 +40,33 @@ namespace Files {
         return "Unknown Type";
     }
 
-    int ReadFile(const std::vector<uint8_t>& bytes, int64_t offset, int64_t length) {
-        std::cout << "Reading file from offset " << offset << ", length " << length << std::endl;
+    int ReadFile([[maybe_unused]] const std::vector<uint8_t>& bytes, int64_t offset, int64_t length) {
+        LOG_DEBUG("Reading file from offset " << offset << ", length " << length);
         return 0;
     }
 
     int ReadHED(const std::string& filepath) {
-        std::ifstream stream(filepath, std::ios::binary);
-        if (!stream) {
-            std::cerr << "Failed to open HED file: " << filepath << std::endl;
-            return -1;
-        }
-
-        auto entries = ReadHEDEntries(stream);
-        // Process entries
-        return 0;
+        return ReadArchiveIndex(filepath, ArchiveFormat::HED);
     }
 
     int ReadHD2(const std::string& filepath) {
-        std::ifstream stream(filepath, std::ios::binary);
-        if (!stream) {
-            std::cerr << "Failed to open HD2 file: " << filepath << std::endl;
-            return -1;
-        }
-
-        auto entries = ReadHD2Entries(stream);
-        // Process entries
-        return 0;
+        return ReadArchiveIndex(filepath, ArchiveFormat::HD2);
     }
 
     std::vector<HED> ReadHEDEntries(std::ifstream& stream) {
         std::vector<HED> hedEntries;
+        const std::streamoff end = GetStreamLength(stream);
 
-        while (stream.tellg() < stream.end) {
+        while (stream && static_cast<std::streamoff>(stream.tellg()) + static_cast<std::streamoff>(sizeof(HED)) <= end) {
             HED entry;
             stream.read(entry.Name, 64);
             entry.Offset = Bytes::ReadUInt32(stream);
             entry.Size = Bytes::ReadUInt32(stream);
             entry.ID = Bytes::ReadUInt32(stream);
             entry.SomeID = Bytes::ReadUInt32(stream);
+            if (entry.Name[0] == '\0') {
+                break;
+            }
             hedEntries.push_back(entry);
         }
 
@@ -59,8 +75,10 @@ namespace Files {
 
     std::vector<HD2> ReadHD2Entries(std::ifstream& stream) {
         std::vector<HD2> hd2Entries;
+        // The entries end where the string table their NameOffsets point into begins.
+        std::streamoff end = GetStreamLength(stream);
 
-        while (stream.tellg() < stream.end) {
+        while (stream && static_cast<std::streamoff>(stream.tellg()) + static_cast<std::streamoff>(sizeof(HD2)) <= end) {
             HD2 entry;
             entry.NameOffset = Bytes::ReadUInt32(stream);
             entry.Zero1 = Bytes::ReadUInt32(stream);
@@ -70,6 +88,10 @@ namespace Files {
             entry.Size = Bytes::ReadUInt32(stream);
             entry.LBAOffset = Bytes::ReadUInt32(stream);
             entry.LBAExtent = Bytes::ReadUInt32(stream);
+            if (entry.NameOffset == 0 && entry.Offset == 0 && entry.Size == 0) {
+                break;
+            }
+            end = std::min<std::streamoff>(end, entry.NameOffset);
             hd2Entries.push_back(entry);
         }
 
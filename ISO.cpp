@@ -1,18 +1,31 @@
 #include "ISO.h"
 #include "DirectoryRecord.h"
-#include <iostream>
+#include "Log.h"
+#include "Metrics.h"
+#include "RawSectorReader.h"
 #include <stdexcept>
 #include <filesystem>
-#include <unordered_set>
 #include <algorithm>
-#include <Windows.h>
+#include <cstring>
+#include <cstddef>
+#include <utility>
 
-ISO::ISO(const std::string& isoPath)
-    : reader(isoPath, std::ios::binary), isoFileName(isoPath) {
-    if (!reader.is_open()) {
+ISO::ISO(const std::string& isoPath, ImageBackend backend)
+    : reader(ImageReader::OpenImage(isoPath, backend)), isoFileName(isoPath) {
+    if (!reader) {
+        throw std::runtime_error("Failed to open ISO file.");
+    }
+    const auto* raw = dynamic_cast<const RawSectorReader*>(reader.get());
+    LOG_INFO("ISO file opened successfully: " << isoPath
+        << (reader->GetBackend() == ImageBackend::Mapped ? " (memory-mapped" : " (positional reads")
+        << (raw ? ", " + raw->GetLayout().GetName() + " sectors)" : ")"));
+}
+
+ISO::ISO(const std::string& isoPath, std::shared_ptr<ImageReader> imageReader)
+    : reader(std::move(imageReader)), isoFileName(isoPath) {
+    if (!reader) {
         throw std::runtime_error("Failed to open ISO file.");
     }
-    std::cout << "ISO file opened successfully: " << isoPath << std::endl;
 }
 
 ISO::~ISO() {
@@ -21,36 +34,80 @@ ISO::~ISO() {
 
 void ISO::LoadISO() {
     ReadPrimaryVolumeDescriptor();
+
+    // The cache key describes the file on disk, not pending edits layered over it.
+    const bool useCache = indexCacheEnabled && !reader->IsModified();
+    if (useCache) {
+        Metrics::ScopedTimer timer(Phase::IndexCacheLoad);
+        if (Index.LoadCache(GetIndexCachePath(), GetIndexCacheKey())) {
+            indexFromCache = true;
+            LOG_INFO("Index loaded from cache: " << GetIndexCachePath());
+            return;
+        }
+    }
+
     ReadPathTable();
     BuildDirectoryRecords();
+
+    // Failing to write the cache (read-only media, permissions) only costs the next open a full parse.
+    if (useCache) {
+        Metrics::ScopedTimer timer(Phase::IndexCacheSave);
+        if (!Index.SaveCache(GetIndexCachePath(), GetIndexCacheKey())) {
+            LOG_WARNING("Could not write index cache: " << GetIndexCachePath());
+        }
+    }
+}
+
+IndexCacheKey ISO::GetIndexCacheKey() const {
+    IndexCacheKey key;
+    key.ImageSize = reader->Size();
+    std::error_code error;
+    auto modifiedTime = std::filesystem::last_write_time(isoFileName, error);
+    key.ImageModifiedTime = error ? 0 : static_cast<int64_t>(modifiedTime.time_since_epoch().count());
+    key.DescriptorHash = descriptorHash;
+    return key;
 }
 
 void ISO::ReadPrimaryVolumeDescriptor() {
+    Metrics::ScopedTimer timer(Phase::PrimaryVolumeDescriptor);
     const int primaryVolumeDescriptorLBA = 16;
     const int logicalBlockSize = 2048;
+    const size_t rootDirectoryRecordOffset = offsetof(::PrimaryVolumeDescriptor, RootDirectoryRecord);
 
-    reader.seekg(primaryVolumeDescriptorLBA * logicalBlockSize, std::ios::beg);
-    reader.read(reinterpret_cast<char*>(&PrimaryVolumeDescriptor), sizeof(PrimaryVolumeDescriptor));
+    std::vector<uint8_t> scratch;
+    const uint8_t* sector = reader->ReadSpan(primaryVolumeDescriptorLBA * logicalBlockSize, logicalBlockSize, scratch);
+    if (sector == nullptr) {
+        throw std::runtime_error("Failed to read Primary Volume Descriptor.");
+    }
+
+    descriptorHash = Bytes::HashFnv1a64(sector, logicalBlockSize);
+
+    // Every field before the root directory record matches the on-disc layout byte for byte.
+    std::memcpy(&PrimaryVolumeDescriptor, sector, rootDirectoryRecordOffset);
 
     if (strncmp(PrimaryVolumeDescriptor.Header.Identifier, "CD001", 5) != 0) {
         throw std::runtime_error("Invalid Primary Volume Descriptor.");
     }
+    if (PrimaryVolumeDescriptor.LogicalBlockSize.Value() == 0) {
+        throw std::runtime_error("Invalid logical block size in Primary Volume Descriptor.");
+    }
 
     DirectoryRecord rootDirRecord;
-    if (!TryReadDirectoryRecord(rootDirRecord)) {
+    if (!TryReadDirectoryRecord(sector + rootDirectoryRecordOffset, logicalBlockSize - rootDirectoryRecordOffset, rootDirRecord)) {
         throw std::runtime_error("Failed to read root directory record.");
     }
     PrimaryVolumeDescriptor.RootDirectoryRecord = rootDirRecord;
 
-    std::cout << "Primary Volume Descriptor read successfully." << std::endl;
+    LOG_DEBUG("Primary Volume Descriptor read successfully.");
 }
 
 void ISO::ReadPathTable() {
+    Metrics::ScopedTimer timer(Phase::PathTable);
     uint32_t pathTableLocation = PrimaryVolumeDescriptor.PathTableLocationLE;
     bool isBigEndian = false;
 
     if (pathTableLocation == 0) {
-        pathTableLocation = PrimaryVolumeDescriptor.PathTableLocationBE;
+        pathTableLocation = Bytes::ReverseUInt32(PrimaryVolumeDescriptor.PathTableLocationBE);
         isBigEndian = true;
     }
 
@@ -58,40 +115,43 @@ void ISO::ReadPathTable() {
         throw std::runtime_error("No valid Path Table Location found.");
     }
 
-    uint32_t pathTableSize = isBigEndian
-        ? PrimaryVolumeDescriptor.PathTableSize.BigEndian
-        : PrimaryVolumeDescriptor.PathTableSize.LittleEndian;
-    int64_t pathTableOffset = pathTableLocation * PrimaryVolumeDescriptor.LogicalBlockSize.LittleEndian;
+    uint32_t pathTableSize = PrimaryVolumeDescriptor.PathTableSize.Value();
+
+    std::vector<uint8_t> scratch;
+    const uint8_t* pathTable = reader->ReadSpan(BlockOffset(pathTableLocation), pathTableSize, scratch);
+    if (pathTable == nullptr) {
+        throw std::runtime_error("Failed to read Path Table.");
+    }
 
-    reader.seekg(pathTableOffset, std::ios::beg);
     PathTableEntries.clear();
-    int64_t bytesRead = 0;
+    uint32_t position = 0;
 
-    while (bytesRead < pathTableSize) {
+    while (position + 8 <= pathTableSize) {
+        const uint8_t* entryData = pathTable + position;
         PathTableEntry entry;
-        entry.NameLength = reader.get();
-        entry.ExtendedAttributeRecordLength = reader.get();
-        bytesRead += 2;
+        entry.NameLength = entryData[0];
+        entry.ExtendedAttributeRecordLength = entryData[1];
 
         if (isBigEndian) {
-            entry.ExtentLocation = Bytes::ReadUInt32BigEndian(reader);
-            entry.ParentDirectoryNumber = Bytes::ReadUInt16BigEndian(reader);
+            entry.ExtentLocation = Bytes::ReadUInt32BigEndian(entryData + 2);
+            entry.ParentDirectoryNumber = Bytes::ReadUInt16BigEndian(entryData + 6);
         }
         else {
-            entry.ExtentLocation = Bytes::ReadUInt32(reader);
-            entry.ParentDirectoryNumber = Bytes::ReadUInt16(reader);
+            entry.ExtentLocation = Bytes::ReadUInt32(entryData + 2);
+            entry.ParentDirectoryNumber = Bytes::ReadUInt16(entryData + 6);
         }
-        bytesRead += 6;
+        position += 8;
 
         if (entry.NameLength > 0) {
-            std::vector<char> nameBuffer(entry.NameLength);
-            reader.read(nameBuffer.data(), entry.NameLength);
-            entry.DirectoryIdentifier.assign(nameBuffer.begin(), nameBuffer.end());
-            bytesRead += entry.NameLength;
+            if (entry.NameLength > pathTableSize - position) {
+                throw std::runtime_error("Truncated path table entry.");
+            }
+            entry.DirectoryIdentifier.assign(reinterpret_cast<const char*>(pathTable + position), entry.NameLength);
+            position += entry.NameLength;
 
+            // Identifiers of odd length are followed by a pad byte.
             if ((entry.NameLength & 1) == 1) {
-                reader.ignore(1);
-                bytesRead++;
+                position++;
             }
         }
         else {
@@ -105,139 +165,250 @@ void ISO::ReadPathTable() {
         PathTableEntries.push_back(entry);
     }
 
-    std::cout << "Path Table read successfully." << std::endl;
+    LOG_DEBUG("Path Table read successfully: " << PathTableEntries.size() << " directories.");
+}
+
+uint64_t ISO::BlockOffset(uint32_t lba) const {
+    return static_cast<uint64_t>(lba) * PrimaryVolumeDescriptor.LogicalBlockSize.Value();
 }
 
 std::string ISO::GetRootFolderName() const {
     return std::filesystem::path(isoFileName).stem().string();
 }
 
-std::string ISO::GetFullPath(const PathTableEntry& entry) {
-    // Base case: if this entry's parent is the root (ISO spec defines the root's ParentDirectoryNumber as 1),
-    // then return the ISO's root folder name plus the entry's identifier (if nonempty).
-    if (entry.ParentDirectoryNumber == 1) {
-        std::string root = GetRootFolderName();
-        if (!entry.DirectoryIdentifier.empty() &&
-            entry.DirectoryIdentifier != "\0" &&
-            entry.DirectoryIdentifier != "\u0001")
-        {
-            return root + "\\" + entry.DirectoryIdentifier;
+std::vector<std::string> ISO::ResolvePathTablePaths() const {
+    // Path table entries are sorted so that every parent precedes its children, which lets each
+    // path be built from its parent's already-resolved one in a single pass.
+    std::vector<std::string> paths;
+    paths.reserve(PathTableEntries.size());
+
+    for (size_t i = 0; i < PathTableEntries.size(); i++) {
+        const auto& entry = PathTableEntries[i];
+        size_t parentIndex = entry.ParentDirectoryNumber - 1;
+
+        // The root is the first entry and names itself as its parent.
+        if (i == 0) {
+            paths.push_back(GetRootFolderName());
+            continue;
+        }
+        if (parentIndex >= i) {
+            throw std::runtime_error("Invalid ParentDirectoryNumber in path table entry.");
         }
-        return root;
-    }
 
-    int parentIndex = entry.ParentDirectoryNumber - 1;
-    if (parentIndex < 0 || parentIndex >= PathTableEntries.size()) {
-        throw std::runtime_error("Invalid ParentDirectoryNumber in path table entry.");
+        std::string path;
+        path.reserve(paths[parentIndex].size() + 1 + entry.DirectoryIdentifier.size());
+        path.append(paths[parentIndex]).append(1, '\\').append(entry.DirectoryIdentifier);
+        paths.push_back(std::move(path));
     }
+    return paths;
+}
 
-    const auto& parentEntry = PathTableEntries[parentIndex];
-    std::filesystem::path fullPath = std::filesystem::path(GetFullPath(parentEntry)) / entry.DirectoryIdentifier;
-    return fullPath.string();
+std::optional<uint32_t> ISO::Find(std::string_view path) const {
+    return Index.Find(path);
 }
 
 void ISO::BuildDirectoryRecords() {
+    Metrics::ScopedTimer timer(Phase::DirectoryWalk);
     if (PathTableEntries.empty()) {
         throw std::runtime_error("PathTableEntries are empty. Unable to build directory records.");
     }
 
-    std::unordered_set<uint32_t> seenLBAs;
-    for (const auto& pathEntry : PathTableEntries) {
-        std::string fullPath = GetFullPath(pathEntry);
+    Index.Clear();
+    Index.Reserve(PathTableEntries.size() * 16, PathTableEntries.size() * 16 * 12);
+
+    // Directory entries keyed by extent location. The path table has no sizes, so each extent's
+    // length comes from the directory record that points at it; parents precede their children
+    // in the path table, so that record has always been indexed before the extent is read.
+    std::unordered_map<uint32_t, uint32_t> directoryIds;
+    const DirectoryRecord& rootRecord = PrimaryVolumeDescriptor.RootDirectoryRecord;
+    directoryIds[rootRecord.ExtentLocation.Value()] = Index.Add(FileIndex::NoParent, std::string_view(), rootRecord);
+
+    std::vector<std::string> fullPaths = ResolvePathTablePaths();
+    std::vector<uint32_t> pathEntryIds;
+    pathEntryIds.reserve(PathTableEntries.size());
+    std::vector<uint8_t> scratch;
+    for (size_t entryIndex = 0; entryIndex < PathTableEntries.size(); entryIndex++) {
+        const auto& pathEntry = PathTableEntries[entryIndex];
+        const std::string& fullPath = fullPaths[entryIndex];
+
+        auto known = directoryIds.find(pathEntry.ExtentLocation);
+        uint32_t knownLength = known != directoryIds.end() ? Index.GetSize(known->second) : 0;
+        uint32_t dirDataLength = GetDirectoryExtentLength(pathEntry.ExtentLocation, knownLength);
+        const uint8_t* dirData = reader->ReadSpan(BlockOffset(pathEntry.ExtentLocation), dirDataLength, scratch);
+        if (dirData == nullptr) {
+            throw std::runtime_error("Failed to read directory extent for " + fullPath + ".");
+        }
+        auto records = ReadDirectoryRecords(dirData, dirDataLength);
+        Metrics::Add(Counter::DirectoriesParsed);
+        Metrics::Add(Counter::RecordsParsed, records.size());
 
-        reader.seekg(pathEntry.ExtentLocation * PrimaryVolumeDescriptor.LogicalBlockSize.Value(), std::ios::beg);
-        uint32_t dirDataLength = PrimaryVolumeDescriptor.LogicalBlockSize.Value();
-        auto records = ReadDirectoryRecords(dirDataLength);
+        uint32_t directoryId;
+        if (known != directoryIds.end()) {
+            directoryId = known->second;
+        }
+        else {
+            // Listed in the path table but not referenced by its parent: index it from its own "." entry.
+            uint16_t parentNumber = pathEntry.ParentDirectoryNumber;
+            uint32_t parentId = parentNumber <= pathEntryIds.size() ? pathEntryIds[parentNumber - 1] : FileIndex::RootId;
+            if (records.empty()) {
+                throw std::runtime_error("Directory extent for " + fullPath + " has no records.");
+            }
+            directoryId = Index.Add(parentId, pathEntry.DirectoryIdentifier, records.front());
+            directoryIds.emplace(pathEntry.ExtentLocation, directoryId);
+        }
+        pathEntryIds.push_back(directoryId);
 
         for (const auto& record : records) {
-            std::string recordName(record.FileIdentifier, record.FileIdentifierLength);
-            std::cout << "Raw Record Name: [" << recordName << "]" << std::endl;
-
-            // Build the record path relative to the directory.
-            std::string recordPath = (std::filesystem::path(fullPath) / recordName).string();
-            if (!recordPath.empty() && recordPath.back() == '\\') {
-                recordPath.pop_back();
-            }
+            std::string_view recordName(record.FileIdentifier, record.FileIdentifierLength);
+            LOG_TRACE("Raw Record Name: [" << recordName << "]");
 
-            if (!seenLBAs.insert(record.ExtentLocation.Value()).second) {
+            // Skip the "." and ".." entries every directory starts with.
+            if (record.FileIdentifierLength == 1 && (record.FileIdentifier[0] == '\0' || record.FileIdentifier[0] == '\1')) {
                 continue;
             }
 
+            uint32_t id = Index.Add(directoryId, recordName, record);
             if (record.IsDirectory()) {
-                DirectoryRecords[recordPath] = record;
-                //std::cout << "Folder Record: " << recordPath << " at LBA " << record.ExtentLocation.Value() << std::endl;
+                directoryIds.emplace(record.ExtentLocation.Value(), id);
             }
-            else {
-                FileRecords[recordPath] = record;
-                //std::cout << "File Record: " << recordPath << " at LBA " << record.ExtentLocation.Value() << std::endl;
+        }
+    }
+    Index.Finalize();
+
+    LOG_DEBUG("Directory records built successfully. Index entries: " << Index.Size()
+        << " (" << Index.GetMemoryUsage() << " bytes)");
+    if (Log::IsEnabled(LogLevel::Trace)) {
+        for (uint32_t id : Index.GetLBAOrder()) {
+            if (!Index.IsDirectory(id)) {
+                LOG_TRACE("File: " << Index.GetPath(id) << " Size: " << Index.GetSize(id) << " bytes");
             }
         }
     }
+}
 
-    std::cout << "Directory records built successfully." << std::endl;
-    std::cout << "File Records count: " << FileRecords.size() << std::endl;
-    for (const auto& fileRecord : FileRecords) {
-        std::cout << "File: " << fileRecord.first << " Size: " << fileRecord.second.DataLength.Value() << " bytes" << std::endl;
+void ISO::BuildRecordMaps() const {
+    std::string root = GetRootFolderName();
+    for (uint32_t id = FileIndex::RootId + 1; id < Index.Size(); id++) {
+        std::string recordPath = root + "\\" + Index.GetPath(id);
+        if (Index.IsDirectory(id)) {
+            DirectoryRecords[recordPath] = Index.ToDirectoryRecord(id);
+        }
+        else {
+            FileRecords[recordPath] = Index.ToDirectoryRecord(id);
+        }
     }
 }
 
-bool ISO::TryReadDirectoryRecord(DirectoryRecord& dirRecord) {
-    int64_t startPos = reader.tellg();
-    dirRecord.Length = reader.get();
-    if (dirRecord.Length == 0) {
-        return false;
+const std::unordered_map<std::string, DirectoryRecord>& ISO::GetDirectoryRecords() const {
+    std::call_once(recordMapsBuilt, &ISO::BuildRecordMaps, this);
+    return DirectoryRecords;
+}
+
+const std::unordered_map<std::string, DirectoryRecord>& ISO::GetFileRecords() const {
+    std::call_once(recordMapsBuilt, &ISO::BuildRecordMaps, this);
+    return FileRecords;
+}
+
+uint32_t ISO::GetDirectoryExtentLength(uint32_t lba, uint32_t knownLength) {
+    const uint32_t logicalBlockSize = PrimaryVolumeDescriptor.LogicalBlockSize.Value();
+
+    if (knownLength >= logicalBlockSize) {
+        return knownLength;
     }
 
-    dirRecord.ExtendedAttributeRecordLength = reader.get();
-    dirRecord.ExtentLocation.LittleEndian = Bytes::ReadUInt32(reader);
-    dirRecord.ExtentLocation.BigEndian = Bytes::ReadUInt32BigEndian(reader);
-    dirRecord.DataLength.LittleEndian = Bytes::ReadUInt32(reader);
-    dirRecord.DataLength.BigEndian = Bytes::ReadUInt32BigEndian(reader);
-    reader.read(reinterpret_cast<char*>(dirRecord.RecordingDateTime), 7);
-    dirRecord.FileFlags = static_cast<FileFlags>(reader.get());
-    dirRecord.FileUnitSize = reader.get();
-    dirRecord.InterleaveGapSize = reader.get();
-    dirRecord.VolumeSequenceNumber.LittleEndian = Bytes::ReadUInt16(reader);
-    dirRecord.VolumeSequenceNumber.BigEndian = Bytes::ReadUInt16BigEndian(reader);
-    dirRecord.FileIdentifierLength = reader.get();
-
-    reader.read(dirRecord.FileIdentifier, dirRecord.FileIdentifierLength);
-    dirRecord.FileIdentifier[dirRecord.FileIdentifierLength] = '\0'; // null-terminate
+    // Not referenced by any record seen so far: fall back to the "." entry that opens the extent.
+    std::vector<uint8_t> scratch;
+    const uint8_t* firstBlock = reader->ReadSpan(BlockOffset(lba), logicalBlockSize, scratch);
+    DirectoryRecord selfRecord;
+    if (firstBlock != nullptr && TryReadDirectoryRecord(firstBlock, logicalBlockSize, selfRecord) &&
+        selfRecord.ExtentLocation.Value() == lba && selfRecord.DataLength.Value() >= logicalBlockSize) {
+        return selfRecord.DataLength.Value();
+    }
+    return logicalBlockSize;
+}
+
+bool ISO::TryReadDirectoryRecord(const uint8_t* data, size_t available, DirectoryRecord& dirRecord) {
+    const size_t fixedLength = 33; // Bytes before the File Identifier
 
-    // According to ISO 9660, if the File Identifier Length is even, a pad byte is present.
-    if ((dirRecord.FileIdentifierLength & 1) == 0) {
-        reader.ignore(1);
+    if (available == 0) {
+        return false;
+    }
+    dirRecord.Length = data[0];
+    if (dirRecord.Length == 0) {
+        return false;
+    }
+    if (dirRecord.Length < fixedLength || dirRecord.Length > available) {
+        throw std::runtime_error("Malformed directory record.");
     }
 
-    int64_t endPos = startPos + dirRecord.Length;
-    reader.seekg(endPos, std::ios::beg);
+    // Both-endian fields keep their big-endian half exactly as stored on disc, as SetValue() does.
+    dirRecord.ExtendedAttributeRecordLength = data[1];
+    dirRecord.ExtentLocation.LittleEndian = Bytes::ReadUInt32(data + 2);
+    dirRecord.ExtentLocation.BigEndian = Bytes::ReadUInt32(data + 6);
+    dirRecord.DataLength.LittleEndian = Bytes::ReadUInt32(data + 10);
+    dirRecord.DataLength.BigEndian = Bytes::ReadUInt32(data + 14);
+    std::memcpy(dirRecord.RecordingDateTime, data + 18, 7);
+    dirRecord.FileFlags = static_cast<FileFlags>(data[25]);
+    dirRecord.FileUnitSize = data[26];
+    dirRecord.InterleaveGapSize = data[27];
+    dirRecord.VolumeSequenceNumber.LittleEndian = Bytes::ReadUInt16(data + 28);
+    dirRecord.VolumeSequenceNumber.BigEndian = Bytes::ReadUInt16(data + 30);
+    dirRecord.FileIdentifierLength = data[32];
+
+    if (dirRecord.FileIdentifierLength > dirRecord.Length - fixedLength) {
+        throw std::runtime_error("Directory record identifier exceeds record length.");
+    }
+    std::memcpy(dirRecord.FileIdentifier, data + fixedLength, dirRecord.FileIdentifierLength);
+    dirRecord.FileIdentifier[dirRecord.FileIdentifierLength] = '\0'; // null-terminate
 
     return true;
 }
 
 
-std::vector<DirectoryRecord> ISO::ReadDirectoryRecords(uint32_t directorySize) {
+std::vector<DirectoryRecord> ISO::ReadDirectoryRecords(const uint8_t* data, uint32_t directorySize) {
+    const uint32_t logicalBlockSize = PrimaryVolumeDescriptor.LogicalBlockSize.Value();
+
     std::vector<DirectoryRecord> records;
-    int64_t bytesRead = 0;
-    while (bytesRead < directorySize) {
+    uint32_t position = 0;
+    while (position < directorySize) {
+        // Records never straddle a sector; the tail of a sector that cannot hold the next record is zero-filled.
+        uint32_t sectorEnd = std::min((position / logicalBlockSize + 1) * logicalBlockSize, directorySize);
         DirectoryRecord record;
-        if (!TryReadDirectoryRecord(record)) {
-            break;
+        if (!TryReadDirectoryRecord(data + position, sectorEnd - position, record)) {
+            position = sectorEnd;
+            continue;
         }
         records.push_back(record);
-        bytesRead += record.Length;
+        position += record.Length;
     }
     return records;
 }
 
+FileView ISO::GetFileView(const DirectoryRecord& fileRecord) {
+    return reader->View(BlockOffset(fileRecord.ExtentLocation.Value()), fileRecord.DataLength.Value());
+}
+
+FileView ISO::GetFileView(uint32_t entryId) {
+    return reader->View(BlockOffset(Index.GetLBA(entryId)), Index.GetSize(entryId));
+}
+
+FileView ISO::GetFileView(uint32_t entryId, uint64_t offset, size_t length) {
+    uint32_t fileSize = Index.GetSize(entryId);
+    if (offset > fileSize || length > fileSize - offset) {
+        throw std::out_of_range("Requested range lies outside " + Index.GetPath(entryId) + ".");
+    }
+    return reader->View(GetImageOffset(entryId) + offset, length);
+}
+
+uint64_t ISO::GetImageOffset(uint32_t entryId) const {
+    return BlockOffset(Index.GetLBA(entryId));
+}
+
 std::vector<uint8_t> ISO::ReadFileData(const DirectoryRecord& fileRecord) {
-    reader.seekg(fileRecord.ExtentLocation.Value() * PrimaryVolumeDescriptor.LogicalBlockSize.Value(), std::ios::beg);
-    std::vector<uint8_t> data(fileRecord.DataLength.Value());
-    reader.read(reinterpret_cast<char*>(data.data()), fileRecord.DataLength.Value());
-    return data;
+    return GetFileView(fileRecord).ToVector();
 }
 
 void ISO::Close() {
-    reader.close();
-    std::cout << "ISO file closed." << std::endl;
+    reader.reset();
+    LOG_DEBUG("ISO file closed.");
 }
\ No newline at end of file
@@ -6,36 +6,74 @@
 #include <vector>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
 #include "ISO9660.h"
 #include "Bytes.h"
+#include "ImageReader.h"
+#include "FileIndex.h"
 
 class ISO {
 public:
-    ISO(const std::string& isoPath);
+    ISO(const std::string& isoPath, ImageBackend backend = ImageBackend::Auto);
+    // Reads the image through `imageReader` (e.g. a SectorOverlay), which several ISOs may share.
+    ISO(const std::string& isoPath, std::shared_ptr<ImageReader> imageReader);
     ~ISO();
 
     void LoadISO();
+    // The parsed index is cached in a sidecar next to the image (see GetIndexCachePath) and reused
+    // by LoadISO while the image's size, mtime and PVD are unchanged. Enabled by default; skipped
+    // while the reader holds uncommitted edits.
+    void SetIndexCacheEnabled(bool enabled) { indexCacheEnabled = enabled; }
+    std::string GetIndexCachePath() const { return isoFileName + ".dcfmidx"; }
+    bool IsIndexFromCache() const { return indexFromCache; }
+    FileView GetFileView(const DirectoryRecord& fileRecord);
+    FileView GetFileView(uint32_t entryId);
+    // `length` bytes starting `offset` bytes into a file; throws std::out_of_range past its end.
+    FileView GetFileView(uint32_t entryId, uint64_t offset, size_t length);
+    // Byte offset of a file's first sector within the image.
+    uint64_t GetImageOffset(uint32_t entryId) const;
+    // Raw bytes of the image itself, e.g. volume descriptors or directory extents.
+    FileView ViewImage(uint64_t offset, size_t length) { return reader->View(offset, length); }
+    uint64_t GetImageSize() const { return reader->Size(); }
+    uint32_t GetLogicalBlockSize() const { return PrimaryVolumeDescriptor.LogicalBlockSize.Value(); }
     std::vector<uint8_t> ReadFileData(const DirectoryRecord& fileRecord);
     std::string GetFileName() const { return isoFileName; }
+    ImageBackend GetBackend() const { return reader->GetBackend(); }
+    const std::shared_ptr<ImageReader>& GetReader() const { return reader; }
     std::string GetRootFolderName() const;
-    const std::unordered_map<std::string, DirectoryRecord>& GetDirectoryRecords() const { return DirectoryRecords; }
-    const std::unordered_map<std::string, DirectoryRecord>& GetFileRecords() const { return FileRecords; }
+    const FileIndex& GetIndex() const { return Index; }
+    // Index id of the entry at `path` below the image root; see FileIndex::Find.
+    std::optional<uint32_t> Find(std::string_view path) const;
+    // Path-keyed record maps, materialized from the index on first use.
+    const std::unordered_map<std::string, DirectoryRecord>& GetDirectoryRecords() const;
+    const std::unordered_map<std::string, DirectoryRecord>& GetFileRecords() const;
 
 private:
     void ReadPrimaryVolumeDescriptor();
     void ReadPathTable();
     void BuildDirectoryRecords();
-    std::string GetFullPath(const PathTableEntry& entry);
-    bool TryReadDirectoryRecord(DirectoryRecord& dirRecord);
-    std::vector<DirectoryRecord> ReadDirectoryRecords(uint32_t directorySize);
+    std::vector<std::string> ResolvePathTablePaths() const;
+    uint64_t BlockOffset(uint32_t lba) const;
+    void BuildRecordMaps() const;
+    IndexCacheKey GetIndexCacheKey() const;
+    uint32_t GetDirectoryExtentLength(uint32_t lba, uint32_t knownLength);
+    bool TryReadDirectoryRecord(const uint8_t* data, size_t available, DirectoryRecord& dirRecord);
+    std::vector<DirectoryRecord> ReadDirectoryRecords(const uint8_t* data, uint32_t directorySize);
     void Close();
 
-    std::ifstream reader;
-    PrimaryVolumeDescriptor PrimaryVolumeDescriptor;
+    std::shared_ptr<ImageReader> reader;
+    ::PrimaryVolumeDescriptor PrimaryVolumeDescriptor;
     std::vector<PathTableEntry> PathTableEntries;
-    std::unordered_map<std::string, DirectoryRecord> DirectoryRecords;
-    std::unordered_map<std::string, DirectoryRecord> FileRecords;
+    FileIndex Index;
+    mutable std::once_flag recordMapsBuilt;
+    mutable std::unordered_map<std::string, DirectoryRecord> DirectoryRecords;
+    mutable std::unordered_map<std::string, DirectoryRecord> FileRecords;
     std::string isoFileName;
+    uint64_t descriptorHash = 0;
+    bool indexCacheEnabled = true;
+    bool indexFromCache = false;
 };
 
 #endif // ISO_H
\ No newline at end of file
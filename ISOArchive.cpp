@@ -0,0 +1,58 @@
+#include "ISOArchive.h"
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    uint32_t FindFile(const ISO& iso, std::string_view path) {
+        auto id = iso.Find(path);
+        if (!id || iso.GetIndex().IsDirectory(*id)) {
+            throw std::runtime_error("No such file in the image: " + std::string(path));
+        }
+        return *id;
+    }
+
+    std::string DefaultDataPath(std::string_view indexPath) {
+        size_t separator = indexPath.find_last_of("/\\");
+        size_t extension = indexPath.rfind('.');
+        if (extension == std::string_view::npos || (separator != std::string_view::npos && extension < separator)) {
+            extension = indexPath.size();
+        }
+        return std::string(indexPath.substr(0, extension)) + ".DAT";
+    }
+
+} // namespace
+
+ISOArchive::ISOArchive(ISO& iso, std::string_view indexPath)
+    : ISOArchive(iso, indexPath, DefaultDataPath(indexPath)) {
+}
+
+ISOArchive::ISOArchive(ISO& iso, std::string_view indexPath, std::string_view dataPath)
+    : iso(iso), dataEntryId(FindFile(iso, dataPath)) {
+    uint32_t indexEntryId = FindFile(iso, indexPath);
+    index.Load(iso.GetFileView(indexEntryId), ArchiveIndex::FormatFromPath(iso.GetIndex().GetPath(indexEntryId)));
+
+    uint64_t dataSize = iso.GetIndex().GetSize(dataEntryId);
+    for (uint32_t i = 0; i < index.Size(); i++) {
+        if (static_cast<uint64_t>(index.GetOffset(i)) + index.GetSize(i) > dataSize) {
+            throw std::runtime_error("Archive member " + std::string(index.GetName(i)) + " lies outside " +
+                std::string(dataPath) + ".");
+        }
+    }
+}
+
+uint64_t ISOArchive::GetImageOffset(uint32_t member) const {
+    return iso.GetImageOffset(dataEntryId) + index.GetOffset(member);
+}
+
+FileView ISOArchive::GetMemberView(uint32_t member) {
+    return iso.GetFileView(dataEntryId, index.GetOffset(member), index.GetSize(member));
+}
+
+FileView ISOArchive::GetMemberView(std::string_view name) {
+    auto member = index.Find(name);
+    if (!member) {
+        throw std::runtime_error("No such archive member: " + std::string(name));
+    }
+    return GetMemberView(*member);
+}
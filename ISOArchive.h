@@ -0,0 +1,34 @@
+#ifndef ISOARCHIVE_H
+#define ISOARCHIVE_H
+
+#include <cstdint>
+#include <string_view>
+#include "ArchiveIndex.h"
+#include "ISO.h"
+
+// An HD2/HED archive read in place from inside an ISO. The index is a view of its file in the
+// image, and members are addressed by absolute image offset (the .dat's first sector plus the
+// entry's Offset), so reading one asset is a single read of just its bytes.
+class ISOArchive {
+public:
+    // `indexPath` names the .hd2/.hed inside the image (e.g. "DATA/DATA.HD2"); the data file
+    // defaults to the entry with the same name and a .DAT extension. Throws std::runtime_error if
+    // either is missing or a member lies outside the data file.
+    ISOArchive(ISO& iso, std::string_view indexPath);
+    ISOArchive(ISO& iso, std::string_view indexPath, std::string_view dataPath);
+
+    const ArchiveIndex& GetIndex() const { return index; }
+    uint32_t GetDataEntryId() const { return dataEntryId; }
+
+    uint64_t GetImageOffset(uint32_t member) const;
+    FileView GetMemberView(uint32_t member);
+    // Throws std::runtime_error if no member has this name (see ArchiveIndex::Find).
+    FileView GetMemberView(std::string_view name);
+
+private:
+    ISO& iso;
+    ArchiveIndex index;
+    uint32_t dataEntryId;
+};
+
+#endif // ISOARCHIVE_H
@@ -0,0 +1,316 @@
+#include "ISOPatcher.h"
+#include "Log.h"
+#include "RawSectorReader.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+namespace {
+
+    constexpr uint32_t FirstVolumeDescriptorLBA = 16;
+    constexpr uint32_t MaxVolumeDescriptors = 64;
+    constexpr size_t VolumeSpaceSizeOffset = 80;
+    constexpr size_t RootRecordOffset = 156;
+
+    void PutBothEndian32(uint8_t* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+            out[7 - i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint64_t SectorsFor(uint64_t bytes, uint64_t blockSize) {
+        return (bytes + blockSize - 1) / blockSize;
+    }
+
+    // Byte offset of `id`'s directory record, found by walking its parent's extent.
+    uint64_t FindRecordOffset(ISO& iso, uint32_t id) {
+        const FileIndex& index = iso.GetIndex();
+        const uint32_t blockSize = iso.GetLogicalBlockSize();
+        const uint32_t parent = index.GetParent(id);
+        const std::string_view name = index.GetName(id);
+
+        FileView extent = iso.GetFileView(parent);
+        const uint8_t* data = extent.Data();
+        size_t position = 0;
+        while (position < extent.Size()) {
+            size_t sectorEnd = std::min<size_t>((position / blockSize + 1) * blockSize, extent.Size());
+            uint8_t length = data[position];
+            if (length < 34 || position + length > sectorEnd) {
+                position = sectorEnd;
+                continue;
+            }
+            uint8_t nameLength = data[position + 32];
+            if (33u + nameLength <= length && Bytes::ReadUInt32(data + position + 2) == index.GetLBA(id) &&
+                std::string_view(reinterpret_cast<const char*>(data + position + 33), nameLength) == name) {
+                return iso.GetImageOffset(parent) + position;
+            }
+            position += length;
+        }
+        throw std::runtime_error("Directory record not found for " + index.GetPath(id) + ".");
+    }
+
+    // A file record in a supplementary (Joliet) tree, which has its own copy of every extent
+    // location and data length.
+    struct SupplementaryRecord {
+        uint64_t Offset;
+        uint32_t Size;
+    };
+
+    // The file records of the tree below a supplementary descriptor's root, keyed by extent
+    // location. Records never straddle a sector; extents outside the image are skipped.
+    void CollectSupplementaryRecords(ISO& iso, uint64_t descriptorOffset, std::multimap<uint32_t, SupplementaryRecord>& records) {
+        const uint64_t blockSize = iso.GetLogicalBlockSize();
+        FileView root = iso.ViewImage(descriptorOffset + RootRecordOffset, 34);
+        std::vector<std::pair<uint32_t, uint32_t>> pending = { { Bytes::ReadUInt32(root.Data() + 2), Bytes::ReadUInt32(root.Data() + 10) } };
+        std::set<uint32_t> visited;
+        while (!pending.empty()) {
+            auto [lba, size] = pending.back();
+            pending.pop_back();
+            if (!visited.insert(lba).second || lba * blockSize + size > iso.GetImageSize()) {
+                continue;
+            }
+            FileView extent = iso.ViewImage(lba * blockSize, size);
+            const uint8_t* data = extent.Data();
+            size_t position = 0;
+            while (position < extent.Size()) {
+                size_t sectorEnd = std::min<size_t>((position / blockSize + 1) * blockSize, extent.Size());
+                uint8_t length = data[position];
+                if (length < 34 || position + length > sectorEnd) {
+                    position = sectorEnd;
+                    continue;
+                }
+                uint32_t recordLBA = Bytes::ReadUInt32(data + position + 2);
+                uint32_t recordSize = Bytes::ReadUInt32(data + position + 10);
+                uint8_t nameLength = data[position + 32];
+                bool self = nameLength == 1 && data[position + 33] <= 1;
+                if (data[position + 25] & 0x02) {
+                    if (!self) {
+                        pending.push_back({ recordLBA, recordSize });
+                    }
+                }
+                else {
+                    records.insert({ recordLBA, { lba * blockSize + position, recordSize } });
+                }
+                position += length;
+            }
+        }
+    }
+
+    struct Gap {
+        uint64_t Start;
+        uint64_t Sectors;
+    };
+
+    bool IsZero(ISO& iso, uint64_t offset, uint64_t length) {
+        FileView view = iso.ViewImage(offset, static_cast<size_t>(length));
+        return std::all_of(view.begin(), view.end(), [](uint8_t b) { return b == 0; });
+    }
+
+} // namespace
+
+ISOPatcher::ISOPatcher(std::string imagePath)
+    : imagePath(std::move(imagePath)) {
+}
+
+void ISOPatcher::Replace(std::string_view path, std::vector<uint8_t> data) {
+    replacements.emplace_back(std::string(path), std::move(data));
+}
+
+std::vector<ImageWrite> ISOPatcher::Plan(ISO& iso, ISOPatchResult* result) const {
+    const FileIndex& index = iso.GetIndex();
+    const uint64_t blockSize = iso.GetLogicalBlockSize();
+
+    std::map<uint32_t, const std::vector<uint8_t>*> targets;
+    for (const auto& [path, data] : replacements) {
+        auto id = iso.Find(path);
+        if (!id || index.IsDirectory(*id)) {
+            throw std::runtime_error("No such file in the image: " + path);
+        }
+        if (data.size() > 0xFFFFFFFFull) {
+            throw std::runtime_error(path + " is too large for an ISO9660 extent.");
+        }
+        targets[*id] = &data;
+    }
+
+    // Volume descriptors (primary and supplementary) each carry the volume space size.
+    std::vector<uint64_t> descriptorOffsets;
+    std::multimap<uint32_t, SupplementaryRecord> supplementaryRecords;
+    bool hasSupplementaryTree = false;
+    uint32_t volumeSectors = 0;
+    for (uint32_t lba = FirstVolumeDescriptorLBA; lba < FirstVolumeDescriptorLBA + MaxVolumeDescriptors; lba++) {
+        uint64_t offset = lba * blockSize;
+        if (offset + blockSize > iso.GetImageSize()) {
+            break;
+        }
+        FileView descriptor = iso.ViewImage(offset, static_cast<size_t>(blockSize));
+        uint8_t type = descriptor.Data()[0];
+        if (type == 255) {
+            break;
+        }
+        if (type == 1 || type == 2) {
+            descriptorOffsets.push_back(offset);
+            if (type == 2) {
+                hasSupplementaryTree = true;
+                CollectSupplementaryRecords(iso, offset, supplementaryRecords);
+            }
+            if (type == 1) {
+                volumeSectors = Bytes::ReadUInt32(descriptor.Data() + VolumeSpaceSizeOffset);
+            }
+        }
+    }
+
+    // Unused space between extents, beginning at the root directory (after the descriptors and path tables).
+    const std::vector<uint32_t>& lbaOrder = index.GetLBAOrder();
+    std::vector<Gap> gaps;
+    uint64_t allocatedEnd = index.GetLBA(FileIndex::RootId);
+    for (uint32_t id : lbaOrder) {
+        uint64_t sectors = SectorsFor(index.GetSize(id), blockSize);
+        if (sectors == 0) {
+            continue;
+        }
+        if (index.GetLBA(id) > allocatedEnd && index.GetLBA(id) <= volumeSectors) {
+            gaps.push_back({ allocatedEnd, index.GetLBA(id) - allocatedEnd });
+        }
+        allocatedEnd = std::max<uint64_t>(allocatedEnd, index.GetLBA(id) + sectors);
+    }
+    uint64_t appendLBA = std::max<uint64_t>(std::max<uint64_t>(volumeSectors, allocatedEnd), SectorsFor(iso.GetImageSize(), blockSize));
+
+    ISOPatchResult stats;
+    std::vector<ImageWrite> writes;
+    bool appended = false;
+    for (const auto& [id, data] : targets) {
+        uint64_t oldSectors = SectorsFor(index.GetSize(id), blockSize);
+        uint64_t newSectors = SectorsFor(data->size(), blockSize);
+
+        // Any other extent overlapping this one (an alias, one nested inside it, or one it sits
+        // inside) would see an in-place overwrite too.
+        uint64_t lba = index.GetLBA(id);
+        bool shared = false;
+        for (uint32_t other : lbaOrder) {
+            if (index.GetLBA(other) >= lba + oldSectors) {
+                break;
+            }
+            shared = other != id && index.GetLBA(other) + SectorsFor(index.GetSize(other), blockSize) > lba;
+            if (shared) {
+                break;
+            }
+        }
+
+        if (newSectors > oldSectors || (shared && newSectors > 0)) {
+            auto gap = std::find_if(gaps.begin(), gaps.end(), [&](const Gap& candidate) {
+                return candidate.Sectors >= newSectors && IsZero(iso, candidate.Start * blockSize, newSectors * blockSize);
+            });
+            if (gap != gaps.end()) {
+                lba = gap->Start;
+                gap->Start += newSectors;
+                gap->Sectors -= newSectors;
+            }
+            else {
+                lba = appendLBA;
+                appendLBA += newSectors;
+                appended = true;
+            }
+            if (lba > 0xFFFFFFFFull - newSectors) {
+                throw std::runtime_error("Relocated extent lies beyond the 32-bit sector range.");
+            }
+            stats.FilesRelocated++;
+            LOG_DEBUG("Relocating " << index.GetPath(id) << " from LBA " << index.GetLBA(id) << " to " << lba);
+        }
+
+        if (newSectors > 0) {
+            ImageWrite contents{ lba * blockSize, std::vector<uint8_t>(static_cast<size_t>(newSectors * blockSize), 0) };
+            std::copy(data->begin(), data->end(), contents.Data.begin());
+            writes.push_back(std::move(contents));
+        }
+
+        ImageWrite record{ FindRecordOffset(iso, id) + 2, std::vector<uint8_t>(16) };
+        PutBothEndian32(record.Data.data(), static_cast<uint32_t>(lba));
+        PutBothEndian32(record.Data.data() + 8, static_cast<uint32_t>(data->size()));
+
+        // The Joliet twin is the supplementary record with the same extent and length.
+        bool twinFound = false;
+        auto twins = supplementaryRecords.equal_range(index.GetLBA(id));
+        for (auto twin = twins.first; twin != twins.second; ++twin) {
+            if (twin->second.Size == index.GetSize(id)) {
+                writes.push_back({ twin->second.Offset + 2, record.Data });
+                twinFound = true;
+            }
+        }
+        if (hasSupplementaryTree && !twinFound) {
+            LOG_WARNING("No Joliet record found for " << index.GetPath(id) << "; Joliet readers will see its old contents.");
+        }
+        writes.push_back(std::move(record));
+        stats.FilesReplaced++;
+    }
+
+    if (appended && appendLBA > volumeSectors) {
+        uint64_t newVolumeSectors = appendLBA;
+        stats.SectorsAppended = newVolumeSectors - volumeSectors;
+        for (uint64_t offset : descriptorOffsets) {
+            ImageWrite volumeSize{ offset + VolumeSpaceSizeOffset, std::vector<uint8_t>(8) };
+            PutBothEndian32(volumeSize.Data.data(), static_cast<uint32_t>(newVolumeSectors));
+            writes.push_back(std::move(volumeSize));
+        }
+    }
+
+    if (result != nullptr) {
+        *result = stats;
+    }
+    return writes;
+}
+
+uint64_t ISOPatcher::ApplyWrites(const std::string& path, const std::vector<ImageWrite>& writes) {
+    std::fstream image(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!image) {
+        throw std::runtime_error("Failed to open " + path + " for writing.");
+    }
+    uint64_t bytesWritten = 0;
+    for (const auto& write : writes) {
+        image.seekp(static_cast<std::streamoff>(write.Offset));
+        if (!image.write(reinterpret_cast<const char*>(write.Data.data()), static_cast<std::streamsize>(write.Data.size()))) {
+            throw std::runtime_error("Failed to write " + path + ".");
+        }
+        bytesWritten += write.Data.size();
+    }
+    image.close();
+    if (!image) {
+        throw std::runtime_error("Failed to write " + path + ".");
+    }
+    return bytesWritten;
+}
+
+ISOPatchResult ISOPatcher::Apply() {
+    auto startTime = std::chrono::steady_clock::now();
+    ISOPatchResult result;
+    std::vector<ImageWrite> writes;
+    std::string indexCachePath;
+    {
+        // The image must be unmapped before it can be opened for writing on Windows.
+        ISO iso(imagePath);
+        iso.SetIndexCacheEnabled(false);
+        if (iso.GetReader()->IsCompressed()) {
+            throw std::runtime_error("Compressed images cannot be patched in place.");
+        }
+        iso.LoadISO();
+        writes = Plan(iso, &result);
+        // Raw images take whole sectors, with their EDC/ECC regenerated.
+        if (auto* raw = dynamic_cast<RawSectorReader*>(iso.GetReader().get())) {
+            writes = raw->ToRawWrites(writes);
+        }
+        indexCachePath = iso.GetIndexCachePath();
+    }
+
+    result.BytesWritten = ApplyWrites(imagePath, writes);
+    std::error_code error;
+    std::filesystem::remove(indexCachePath, error);
+
+    result.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    LOG_INFO("Patched " << imagePath << ": " << result.FilesReplaced << " files replaced (" << result.FilesRelocated
+        << " relocated), " << result.BytesWritten << " bytes written in " << result.Seconds << " s");
+    return result;
+}
@@ -0,0 +1,55 @@
+#ifndef ISOPATCHER_H
+#define ISOPATCHER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "ISO.h"
+
+// One contiguous write into an image.
+struct ImageWrite {
+    uint64_t Offset;
+    std::vector<uint8_t> Data;
+};
+
+struct ISOPatchResult {
+    uint64_t FilesReplaced = 0;
+    uint64_t FilesRelocated = 0;    // Files that outgrew their sectors and were moved
+    uint64_t SectorsAppended = 0;   // Growth of the volume
+    uint64_t BytesWritten = 0;
+    double Seconds = 0.0;
+};
+
+// Replaces file contents inside an ISO9660 image without rewriting it. A file whose new contents
+// fit in the sectors it already occupies is overwritten in place; one that grows is moved to a
+// zero-filled gap between extents large enough for it, or else appended after the end of the
+// volume, with the volume space size of every volume descriptor raised to match. Either way its
+// directory record's extent location and both-endian data length are updated, along with those
+// of its twin in a supplementary (Joliet) tree. Directories never move, so the path tables stay
+// valid.
+class ISOPatcher {
+public:
+    explicit ISOPatcher(std::string imagePath);
+
+    // Queues a replacement for the file at `path` (see FileIndex::Find). Replacing a file twice
+    // keeps the last contents.
+    void Replace(std::string_view path, std::vector<uint8_t> data);
+
+    // Computes the writes that perform the queued replacements on a loaded image, without
+    // touching it. Throws std::runtime_error if a path is not a file or a record cannot be found.
+    std::vector<ImageWrite> Plan(ISO& iso, ISOPatchResult* result = nullptr) const;
+
+    // Plans against the image, then writes it in place and drops its stale index cache.
+    ISOPatchResult Apply();
+
+    // Writes `writes` into the file at `path`, extending it where they reach past its end.
+    static uint64_t ApplyWrites(const std::string& path, const std::vector<ImageWrite>& writes);
+
+private:
+    std::string imagePath;
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> replacements;
+};
+
+#endif // ISOPATCHER_H
@@ -0,0 +1,356 @@
+#include "ImageDelta.h"
+#include "Log.h"
+#include "RawSectorReader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+    constexpr char Magic[8] = { 'D', 'C', 'F', 'M', 'D', 'L', 'T', '2' };
+    constexpr size_t HeaderSize = 48;
+    constexpr size_t RunEntrySize = 12;
+    constexpr size_t ChunkSize = 4 * 1024 * 1024;
+    constexpr uint64_t FnvPrime = 1099511628211ull;
+
+    static_assert(ChunkSize % ImageDelta::SectorSize == 0, "Chunks must hold whole sectors.");
+
+    void PutUInt32(uint8_t* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    void PutUInt64(uint8_t* out, uint64_t value) {
+        PutUInt32(out, static_cast<uint32_t>(value));
+        PutUInt32(out + 4, static_cast<uint32_t>(value >> 32));
+    }
+
+    uint64_t ReadUInt64(const uint8_t* data) {
+        return Bytes::ReadUInt32(data) | (static_cast<uint64_t>(Bytes::ReadUInt32(data + 4)) << 32);
+    }
+
+    bool IsZero(const uint8_t* data, size_t length) {
+        static const uint8_t zeros[ImageDelta::SectorSize] = {};
+        for (size_t position = 0; position < length; position += sizeof(zeros)) {
+            size_t span = std::min(length - position, sizeof(zeros));
+            if (std::memcmp(data + position, zeros, span) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Bytes of `run` that lie within an image of `imageSize` bytes.
+    uint64_t RunBytes(const DeltaRun& run, uint64_t imageSize) {
+        uint64_t begin = run.Sector * ImageDelta::SectorSize;
+        if (begin >= imageSize) {
+            return 0;
+        }
+        return std::min<uint64_t>(static_cast<uint64_t>(run.Count) * ImageDelta::SectorSize, imageSize - begin);
+    }
+
+    uint64_t AddToDigest(uint64_t digest, const uint8_t* data, size_t length) {
+        return (digest ^ Bytes::HashFnv1a64(data, length)) * FnvPrime;
+    }
+
+    // Digest of the bytes the runs cover in `image`, hashed in fixed chunks so both sides agree.
+    uint64_t DigestRuns(ImageReader& image, const std::vector<DeltaRun>& runs) {
+        uint64_t digest = 0;
+        std::vector<uint8_t> scratch;
+        for (const auto& run : runs) {
+            uint64_t begin = run.Sector * ImageDelta::SectorSize;
+            uint64_t length = RunBytes(run, image.Size());
+            for (uint64_t position = 0; position < length; position += ChunkSize) {
+                size_t span = static_cast<size_t>(std::min<uint64_t>(length - position, ChunkSize));
+                const uint8_t* data = image.ReadSpan(begin + position, span, scratch);
+                if (data == nullptr) {
+                    throw std::runtime_error("Failed to read the image.");
+                }
+                digest = AddToDigest(digest, data, span);
+            }
+        }
+        return digest;
+    }
+
+    void WriteBytes(std::ostream& output, const uint8_t* data, size_t length, const std::string& path) {
+        if (!output.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(length))) {
+            throw std::runtime_error("Failed to write " + path + ".");
+        }
+    }
+
+    void ReadBytes(std::istream& input, uint8_t* data, size_t length, const std::string& path) {
+        if (!input.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(length))) {
+            throw std::runtime_error("Truncated delta file: " + path);
+        }
+    }
+
+} // namespace
+
+ImageDiffResult ImageDelta::Compare(ImageReader& source, ImageReader& target) {
+    auto startTime = std::chrono::steady_clock::now();
+    ImageDiffResult result;
+    result.SourceSize = source.Size();
+    result.TargetSize = target.Size();
+
+    auto markChanged = [&result](uint64_t sector) {
+        if (!result.Runs.empty() && result.Runs.back().Sector + result.Runs.back().Count == sector &&
+            result.Runs.back().Count < 0xFFFFFFFFu) {
+            result.Runs.back().Count++;
+        }
+        else {
+            result.Runs.push_back({ sector, 1 });
+        }
+        result.ChangedSectors++;
+    };
+
+    std::vector<uint8_t> sourceScratch;
+    std::vector<uint8_t> targetScratch;
+    for (uint64_t chunk = 0; chunk < result.TargetSize; chunk += ChunkSize) {
+        size_t length = static_cast<size_t>(std::min<uint64_t>(ChunkSize, result.TargetSize - chunk));
+        size_t sourceLength = chunk < result.SourceSize ? static_cast<size_t>(std::min<uint64_t>(length, result.SourceSize - chunk)) : 0;
+        const uint8_t* targetData = target.ReadSpan(chunk, length, targetScratch);
+        const uint8_t* sourceData = sourceLength > 0 ? source.ReadSpan(chunk, sourceLength, sourceScratch) : nullptr;
+        if (targetData == nullptr || (sourceLength > 0 && sourceData == nullptr)) {
+            throw std::runtime_error("Failed to read the images being compared.");
+        }
+        result.BytesCompared += length;
+
+        if (sourceLength == length && std::memcmp(sourceData, targetData, length) == 0) {
+            continue;
+        }
+        for (size_t offset = 0; offset < length; offset += SectorSize) {
+            size_t span = std::min<size_t>(SectorSize, length - offset);
+            size_t common = offset < sourceLength ? std::min(span, sourceLength - offset) : 0;
+            if ((common > 0 && std::memcmp(sourceData + offset, targetData + offset, common) != 0) ||
+                !IsZero(targetData + offset + common, span - common)) {
+                markChanged((chunk + offset) / SectorSize);
+            }
+        }
+    }
+
+    result.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    LOG_INFO("Compared " << result.BytesCompared << " bytes: " << result.ChangedSectors << " changed sectors in "
+        << result.Runs.size() << " runs (" << result.Seconds << " s)");
+    return result;
+}
+
+std::vector<ChangedFile> ImageDelta::Attribute(const ISO& iso, const std::vector<DeltaRun>& runs, uint64_t* unattributedSectors) {
+    const ImageReader& reader = *iso.GetReader();
+    if (reader.IsCompressed()) {
+        throw std::runtime_error("a compressed image's sectors do not map to its blocks.");
+    }
+    SectorLayout layout;
+    if (const auto* raw = dynamic_cast<const RawSectorReader*>(&reader)) {
+        layout = raw->GetLayout();
+    }
+
+    const FileIndex& index = iso.GetIndex();
+    const uint64_t blockSize = iso.GetLogicalBlockSize();
+    const std::vector<uint32_t>& lbaOrder = index.GetLBAOrder();
+    auto extentBegin = [&](uint32_t id) { return index.GetLBA(id) * blockSize; };
+    auto extentEnd = [&](uint32_t id) { return extentBegin(id) + (index.GetSize(id) + blockSize - 1) / blockSize * blockSize; };
+
+    // Extents can nest or overlap, so the furthest end reached by any extent starting at or before
+    // each position says how far back a sector's owners can start.
+    std::vector<uint64_t> furthestEnd(lbaOrder.size());
+    for (size_t i = 0; i < lbaOrder.size(); i++) {
+        furthestEnd[i] = std::max(i > 0 ? furthestEnd[i - 1] : 0, extentEnd(lbaOrder[i]));
+    }
+
+    std::map<uint32_t, uint64_t> sectorsById;
+    std::vector<uint32_t> owners;
+    uint64_t unattributed = 0;
+    for (const auto& run : runs) {
+        for (uint64_t sector = run.Sector; sector < run.Sector + run.Count; sector++) {
+            owners.clear();
+            uint64_t firstBlock = sector * SectorSize / layout.SectorSize;
+            uint64_t lastBlock = ((sector + 1) * SectorSize - 1) / layout.SectorSize;
+            for (uint64_t block = firstBlock; block <= lastBlock; block++) {
+                uint64_t offset = block * RawSectorReader::UserDataSize;
+                auto next = std::upper_bound(lbaOrder.begin(), lbaOrder.end(), offset, [&](uint64_t value, uint32_t id) {
+                    return value < extentBegin(id);
+                });
+                for (size_t i = static_cast<size_t>(next - lbaOrder.begin()); i > 0 && furthestEnd[i - 1] > offset; i--) {
+                    uint32_t candidate = lbaOrder[i - 1];
+                    if (offset < extentEnd(candidate)) {
+                        owners.push_back(candidate);
+                    }
+                }
+            }
+            // A sector straddling two raw sectors of one file still counts once for it.
+            std::sort(owners.begin(), owners.end());
+            owners.erase(std::unique(owners.begin(), owners.end()), owners.end());
+            for (uint32_t id : owners) {
+                sectorsById[id]++;
+            }
+            unattributed += owners.empty() ? 1 : 0;
+        }
+    }
+
+    std::vector<ChangedFile> files;
+    files.reserve(sectorsById.size());
+    for (const auto& [id, sectors] : sectorsById) {
+        files.push_back({ id, index.GetPath(id, '/'), sectors });
+    }
+    std::sort(files.begin(), files.end(), [&](const ChangedFile& a, const ChangedFile& b) {
+        return index.GetLBA(a.Id) < index.GetLBA(b.Id) || (index.GetLBA(a.Id) == index.GetLBA(b.Id) && a.Id < b.Id);
+    });
+    if (unattributedSectors != nullptr) {
+        *unattributedSectors = unattributed;
+    }
+    return files;
+}
+
+uint64_t ImageDelta::Write(const std::string& deltaPath, ImageReader& source, ImageReader& target, const ImageDiffResult& diff) {
+    if (diff.Runs.size() > 0xFFFFFFFFull) {
+        throw std::runtime_error("Too many changed runs for a delta file.");
+    }
+    std::vector<uint8_t> header(HeaderSize + diff.Runs.size() * RunEntrySize);
+    std::memcpy(header.data(), Magic, sizeof(Magic));
+    PutUInt32(header.data() + 8, SectorSize);
+    PutUInt32(header.data() + 12, static_cast<uint32_t>(diff.Runs.size()));
+    PutUInt64(header.data() + 16, diff.SourceSize);
+    PutUInt64(header.data() + 24, diff.TargetSize);
+    PutUInt64(header.data() + 32, DigestRuns(source, diff.Runs));
+    PutUInt64(header.data() + 40, DigestRuns(target, diff.Runs));
+    for (size_t i = 0; i < diff.Runs.size(); i++) {
+        PutUInt64(header.data() + HeaderSize + i * RunEntrySize, diff.Runs[i].Sector);
+        PutUInt32(header.data() + HeaderSize + i * RunEntrySize + 8, diff.Runs[i].Count);
+    }
+
+    std::ofstream output(deltaPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error("Failed to create " + deltaPath + ".");
+    }
+    WriteBytes(output, header.data(), header.size(), deltaPath);
+    uint64_t written = header.size();
+
+    std::vector<uint8_t> scratch;
+    for (const auto& run : diff.Runs) {
+        uint64_t begin = run.Sector * SectorSize;
+        uint64_t length = RunBytes(run, diff.TargetSize);
+        for (uint64_t position = 0; position < length; position += ChunkSize) {
+            size_t span = static_cast<size_t>(std::min<uint64_t>(length - position, ChunkSize));
+            const uint8_t* data = target.ReadSpan(begin + position, span, scratch);
+            if (data == nullptr) {
+                throw std::runtime_error("Failed to read the target image.");
+            }
+            WriteBytes(output, data, span, deltaPath);
+        }
+        written += length;
+    }
+    output.close();
+    if (!output) {
+        throw std::runtime_error("Failed to write " + deltaPath + ".");
+    }
+    return written;
+}
+
+DeltaApplyResult ImageDelta::Apply(const std::string& deltaPath, const std::string& imagePath) {
+    auto startTime = std::chrono::steady_clock::now();
+    std::ifstream delta(deltaPath, std::ios::binary);
+    if (!delta) {
+        throw std::runtime_error("Failed to open " + deltaPath + ".");
+    }
+    uint8_t header[HeaderSize];
+    ReadBytes(delta, header, HeaderSize, deltaPath);
+    if (std::memcmp(header, Magic, sizeof(Magic)) != 0 || Bytes::ReadUInt32(header + 8) != SectorSize) {
+        throw std::runtime_error("Not a DCFM delta file: " + deltaPath);
+    }
+    const uint32_t runCount = Bytes::ReadUInt32(header + 12);
+    const uint64_t sourceSize = ReadUInt64(header + 16);
+    const uint64_t targetSize = ReadUInt64(header + 24);
+    const uint64_t sourceDigest = ReadUInt64(header + 32);
+    const uint64_t targetDigest = ReadUInt64(header + 40);
+
+    // The run table must fit in the file before it is allocated, so a damaged count fails cleanly.
+    std::error_code error;
+    const uint64_t deltaSize = std::filesystem::file_size(deltaPath, error);
+    if (error || static_cast<uint64_t>(runCount) * RunEntrySize > deltaSize - HeaderSize) {
+        throw std::runtime_error("Corrupt run table in " + deltaPath + ".");
+    }
+
+    const uint64_t targetSectors = (targetSize + SectorSize - 1) / SectorSize;
+    std::vector<DeltaRun> runs(runCount);
+    std::vector<uint8_t> runTable(static_cast<size_t>(runCount) * RunEntrySize);
+    ReadBytes(delta, runTable.data(), runTable.size(), deltaPath);
+    for (uint32_t i = 0; i < runCount; i++) {
+        runs[i] = { ReadUInt64(runTable.data() + i * RunEntrySize), Bytes::ReadUInt32(runTable.data() + i * RunEntrySize + 8) };
+        // Every run must lie within the target's sectors.
+        if (runs[i].Count == 0 || (i > 0 && runs[i].Sector < runs[i - 1].Sector + runs[i - 1].Count) ||
+            runs[i].Sector >= targetSectors || runs[i].Count > targetSectors - runs[i].Sector) {
+            throw std::runtime_error("Corrupt run table in " + deltaPath + ".");
+        }
+    }
+
+    // The payload is checked in full before the image is touched, so a truncated or damaged
+    // delta fails without writing anything.
+    uint64_t payloadSize = 0;
+    for (const auto& run : runs) {
+        payloadSize += RunBytes(run, targetSize);
+    }
+    if (deltaSize != HeaderSize + runTable.size() + payloadSize) {
+        throw std::runtime_error("Truncated delta file: " + deltaPath);
+    }
+    std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(ChunkSize, payloadSize)));
+    uint64_t payloadDigest = 0;
+    for (const auto& run : runs) {
+        uint64_t length = RunBytes(run, targetSize);
+        for (uint64_t position = 0; position < length; position += ChunkSize) {
+            size_t span = static_cast<size_t>(std::min<uint64_t>(length - position, ChunkSize));
+            ReadBytes(delta, buffer.data(), span, deltaPath);
+            payloadDigest = AddToDigest(payloadDigest, buffer.data(), span);
+        }
+    }
+    if (payloadDigest != targetDigest) {
+        throw std::runtime_error("Corrupt payload in " + deltaPath + ".");
+    }
+    delta.seekg(static_cast<std::streamoff>(HeaderSize + runTable.size()));
+
+    // Only the bytes about to be overwritten are checked, so verifying costs no more than the patch itself.
+    {
+        auto image = ImageReader::Open(imagePath, ImageBackend::Positional);
+        if (!image) {
+            throw std::runtime_error("Failed to open " + imagePath + ".");
+        }
+        if (image->Size() != sourceSize || DigestRuns(*image, runs) != sourceDigest) {
+            throw std::runtime_error(imagePath + " is not the image this delta was made from.");
+        }
+    }
+
+    DeltaApplyResult result;
+    {
+        std::fstream image(imagePath, std::ios::binary | std::ios::in | std::ios::out);
+        if (!image) {
+            throw std::runtime_error("Failed to open " + imagePath + " for writing.");
+        }
+        for (const auto& run : runs) {
+            uint64_t length = RunBytes(run, targetSize);
+            image.seekp(static_cast<std::streamoff>(run.Sector * SectorSize));
+            for (uint64_t position = 0; position < length; position += ChunkSize) {
+                size_t span = static_cast<size_t>(std::min<uint64_t>(length - position, ChunkSize));
+                ReadBytes(delta, buffer.data(), span, deltaPath);
+                WriteBytes(image, buffer.data(), span, imagePath);
+            }
+            result.BytesWritten += length;
+            result.RunsApplied++;
+        }
+        image.close();
+        if (!image) {
+            throw std::runtime_error("Failed to write " + imagePath + ".");
+        }
+    }
+    if (targetSize != sourceSize) {
+        std::filesystem::resize_file(imagePath, targetSize);
+    }
+
+    result.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    LOG_INFO("Applied " << deltaPath << " to " << imagePath << ": " << result.RunsApplied << " runs, "
+        << result.BytesWritten << " bytes written in " << result.Seconds << " s");
+    return result;
+}
@@ -0,0 +1,67 @@
+#ifndef IMAGEDELTA_H
+#define IMAGEDELTA_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ImageReader.h"
+#include "ISO.h"
+
+// A run of consecutive changed sectors.
+struct DeltaRun {
+    uint64_t Sector;
+    uint32_t Count;
+};
+
+struct ImageDiffResult {
+    std::vector<DeltaRun> Runs;     // Ascending and never adjacent
+    uint64_t SourceSize = 0;
+    uint64_t TargetSize = 0;
+    uint64_t ChangedSectors = 0;
+    uint64_t BytesCompared = 0;
+    double Seconds = 0.0;
+};
+
+struct ChangedFile {
+    uint32_t Id;                    // Entry in the index the changes were attributed with
+    std::string Path;
+    uint64_t Sectors;               // Changed sectors within its extent
+};
+
+struct DeltaApplyResult {
+    uint64_t RunsApplied = 0;
+    uint64_t BytesWritten = 0;
+    double Seconds = 0.0;
+};
+
+// Sector-granular binary delta between two images, e.g. an original and a translated build.
+// Images are compared in large chunks first, so identical stretches cost one memcmp each; only
+// chunks that differ are compared sector by sector. Sectors past the end of the source compare
+// against zeros, which is what extending the file on apply produces.
+//
+// Delta file (little-endian): "DCFMDLT2", sector size (u32), run count (u32), source size (u64),
+// target size (u64), FNV-1a digests of the source bytes the runs overwrite and of the target
+// bytes they write (u64 each), then each run's first sector (u64) and count (u32), then each run's
+// target bytes in order. The final run is trimmed to the target size.
+class ImageDelta {
+public:
+    static constexpr uint32_t SectorSize = 2048;
+
+    static ImageDiffResult Compare(ImageReader& source, ImageReader& target);
+
+    // Maps changed sectors to the files and directories whose extents hold them, in LBA order.
+    // Sectors outside every extent (system area, descriptors, path tables, free space) are counted
+    // in `unattributedSectors`. The runs are sectors of the image file, so on a raw image each one
+    // is charged to the logical blocks of the raw sectors it overlaps. Throws std::runtime_error
+    // for compressed images, whose file sectors do not correspond to blocks at all.
+    static std::vector<ChangedFile> Attribute(const ISO& iso, const std::vector<DeltaRun>& runs, uint64_t* unattributedSectors = nullptr);
+
+    // Returns the size of the delta file.
+    static uint64_t Write(const std::string& deltaPath, ImageReader& source, ImageReader& target, const ImageDiffResult& diff);
+
+    // Patches the image at `imagePath` in place. Throws std::runtime_error, before writing
+    // anything, if the image is not the delta's source or the delta is truncated or corrupt.
+    static DeltaApplyResult Apply(const std::string& deltaPath, const std::string& imagePath);
+};
+
+#endif // IMAGEDELTA_H
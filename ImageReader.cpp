@@ -0,0 +1,303 @@
+#include "ImageReader.h"
+#include "CompressedImageReader.h"
+#include "Metrics.h"
+#include "RawSectorReader.h"
+#include "SectorCache.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void ImageReader::CountRead(uint64_t offset, size_t length) {
+    if (!Metrics::IsEnabled()) {
+        return;
+    }
+    Metrics::AddSlow(Counter::Reads, 1);
+    Metrics::AddSlow(Counter::BytesRead, length);
+    // A seek is any jump other than skipping the padding up to the next 2048-byte sector.
+    uint64_t previousEnd = lastReadEnd.exchange(offset + length, std::memory_order_relaxed);
+    if (offset < previousEnd || offset > ((previousEnd + 2047) & ~uint64_t(2047))) {
+        Metrics::AddSlow(Counter::Seeks, 1);
+    }
+}
+
+const uint8_t* ImageReader::ReadSpan(uint64_t offset, size_t length, std::vector<uint8_t>& scratch) {
+    if (offset > Size() || length > Size() - offset) {
+        return nullptr;
+    }
+    CountRead(offset, length);
+    if (const uint8_t* base = Data()) {
+        return base + offset;
+    }
+    scratch.resize(length);
+    if (!Read(offset, scratch.data(), length)) {
+        return nullptr;
+    }
+    return scratch.data();
+}
+
+FileView ImageReader::View(uint64_t offset, size_t length) {
+    if (offset > Size() || length > Size() - offset) {
+        throw std::out_of_range("Requested range lies outside the image.");
+    }
+    CountRead(offset, length);
+    if (const uint8_t* base = Data()) {
+        return FileView(base + offset, length);
+    }
+    auto buffer = std::make_shared<std::vector<uint8_t>>(length);
+    if (!Read(offset, buffer->data(), length)) {
+        throw std::runtime_error("Failed to read from image.");
+    }
+    return FileView(std::move(buffer));
+}
+
+std::unique_ptr<ImageReader> ImageReader::Open(const std::string& path, ImageBackend backend) {
+    if (backend != ImageBackend::Positional) {
+        auto mapped = std::make_unique<MappedImageReader>();
+        if (mapped->Open(path)) {
+            return mapped;
+        }
+        if (backend == ImageBackend::Mapped) {
+            return nullptr;
+        }
+    }
+
+    auto positional = std::make_unique<PositionalImageReader>();
+    if (positional->Open(path)) {
+        return positional;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<ImageReader> ImageReader::OpenImage(const std::string& path, ImageBackend backend) {
+    return RawSectorReader::Wrap(SectorCache::Wrap(CompressedImageReader::Wrap(Open(path, backend))));
+}
+
+MappedImageReader::~MappedImageReader() {
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedImageReader::Open(const std::string& path) {
+    Close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 ||
+        static_cast<uint64_t>(fileSize.QuadPart) > std::numeric_limits<size_t>::max()) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<uint64_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedImageReader::Close() {
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+        data = nullptr;
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle != nullptr) {
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+    }
+    size = 0;
+}
+
+#else
+
+bool MappedImageReader::Open(const std::string& path) {
+    Close();
+
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(file, &st) != 0 || st.st_size <= 0 ||
+        static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max()) {
+        ::close(file);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, file, 0);
+    if (view == MAP_FAILED) {
+        ::close(file);
+        return false;
+    }
+
+    fd = file;
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+void MappedImageReader::Close() {
+    if (data != nullptr) {
+        munmap(const_cast<uint8_t*>(data), static_cast<size_t>(size));
+        data = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    size = 0;
+}
+
+#endif
+
+bool MappedImageReader::Read(uint64_t offset, void* buffer, size_t length) {
+    if (offset > size || length > size - offset) {
+        return false;
+    }
+    std::memcpy(buffer, data + offset, length);
+    return true;
+}
+
+PositionalImageReader::~PositionalImageReader() {
+    Close();
+}
+
+#ifdef _WIN32
+
+bool PositionalImageReader::Open(const std::string& path) {
+    Close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    size = static_cast<uint64_t>(fileSize.QuadPart);
+    return true;
+}
+
+void PositionalImageReader::Close() {
+    if (fileHandle != nullptr) {
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+    }
+    size = 0;
+}
+
+bool PositionalImageReader::Read(uint64_t offset, void* buffer, size_t length) {
+    if (offset > size || length > size - offset) {
+        return false;
+    }
+
+    uint8_t* destination = static_cast<uint8_t*>(buffer);
+    while (length > 0) {
+        // An explicit offset in the OVERLAPPED makes this a positional read even on a synchronous handle.
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(length, 1u << 30));
+        DWORD bytesRead = 0;
+        if (!ReadFile(fileHandle, destination, chunk, &bytesRead, &overlapped) || bytesRead == 0) {
+            return false;
+        }
+        destination += bytesRead;
+        offset += bytesRead;
+        length -= bytesRead;
+    }
+    return true;
+}
+
+#else
+
+bool PositionalImageReader::Open(const std::string& path) {
+    Close();
+
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(file, &st) != 0) {
+        ::close(file);
+        return false;
+    }
+
+    fd = file;
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+void PositionalImageReader::Close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    size = 0;
+}
+
+bool PositionalImageReader::Read(uint64_t offset, void* buffer, size_t length) {
+    if (offset > size || length > size - offset) {
+        return false;
+    }
+
+    uint8_t* destination = static_cast<uint8_t*>(buffer);
+    while (length > 0) {
+        ssize_t bytesRead = pread(fd, destination, length, static_cast<off_t>(offset));
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            return false;
+        }
+        destination += bytesRead;
+        offset += static_cast<uint64_t>(bytesRead);
+        length -= static_cast<size_t>(bytesRead);
+    }
+    return true;
+}
+
+#endif
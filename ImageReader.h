@@ -0,0 +1,108 @@
+#ifndef IMAGEREADER_H
+#define IMAGEREADER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FileView.h"
+
+enum class ImageBackend {
+    Auto,       // Memory-map the image, falling back to Positional if mapping fails
+    Mapped,
+    Positional  // pread / ReadFile at an explicit offset, no shared file cursor
+};
+
+// Random-access source of image bytes. Parsers ask for byte ranges and get back a pointer;
+// mapped images hand out pointers into the mapping, other backends fill a caller-owned buffer.
+// Reads carry their own offset and touch no shared state, so one reader can serve many threads.
+class ImageReader {
+public:
+    virtual ~ImageReader() = default;
+
+    virtual ImageBackend GetBackend() const = 0;
+    virtual uint64_t Size() const = 0;
+    virtual bool Read(uint64_t offset, void* buffer, size_t length) = 0;
+
+    // Base of the whole image when it is memory-mapped, nullptr otherwise.
+    virtual const uint8_t* Data() const { return nullptr; }
+
+    // True when reads no longer match the file on disk, e.g. a SectorOverlay with pending edits.
+    virtual bool IsModified() const { return false; }
+
+    // True when the file holds the image compressed, so it cannot be patched in place.
+    virtual bool IsCompressed() const { return false; }
+
+    // True when reads return the file's own bytes at the same offsets, so the file can just as
+    // well be read around this reader.
+    virtual bool ReadsFileDirectly() const { return false; }
+
+    // Returns a pointer to `length` bytes at `offset`, or nullptr if the range is out of bounds.
+    // `scratch` is only used (and the result only valid while it lives) for non-mapped backends.
+    const uint8_t* ReadSpan(uint64_t offset, size_t length, std::vector<uint8_t>& scratch);
+
+    // Returns a view of `length` bytes at `offset`: zero-copy when mapped, an owned buffer otherwise.
+    // Throws if the range is out of bounds or cannot be read.
+    FileView View(uint64_t offset, size_t length);
+
+    static std::unique_ptr<ImageReader> Open(const std::string& path, ImageBackend backend = ImageBackend::Auto);
+    // Opens a disc image as the 2048-byte-sector volume it holds: CSO/ZSO containers are
+    // decompressed, unmapped images get a SectorCache and raw sectors are reduced to their user
+    // data. Throws for a malformed container.
+    static std::unique_ptr<ImageReader> OpenImage(const std::string& path, ImageBackend backend = ImageBackend::Auto);
+
+private:
+    void CountRead(uint64_t offset, size_t length);
+
+    std::atomic<uint64_t> lastReadEnd{ 0 };
+};
+
+class MappedImageReader : public ImageReader {
+public:
+    MappedImageReader() = default;
+    ~MappedImageReader() override;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    ImageBackend GetBackend() const override { return ImageBackend::Mapped; }
+    uint64_t Size() const override { return size; }
+    bool Read(uint64_t offset, void* buffer, size_t length) override;
+    const uint8_t* Data() const override { return data; }
+    bool ReadsFileDirectly() const override { return true; }
+
+private:
+    const uint8_t* data = nullptr;
+    uint64_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+class PositionalImageReader : public ImageReader {
+public:
+    PositionalImageReader() = default;
+    ~PositionalImageReader() override;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    ImageBackend GetBackend() const override { return ImageBackend::Positional; }
+    uint64_t Size() const override { return size; }
+    bool Read(uint64_t offset, void* buffer, size_t length) override;
+    bool ReadsFileDirectly() const override { return true; }
+
+private:
+    uint64_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+#endif // IMAGEREADER_H
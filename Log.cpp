@@ -0,0 +1,73 @@
+#include "Log.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+namespace Log {
+
+    namespace {
+
+        int InitialLevel() {
+            LogLevel level = LogLevel::Info;
+            if (const char* name = std::getenv("DCFM_LOG_LEVEL")) {
+                ParseLevel(name, level);
+            }
+            return static_cast<int>(level);
+        }
+
+        const char* LevelName(LogLevel level) {
+            switch (level) {
+            case LogLevel::Trace: return "trace";
+            case LogLevel::Debug: return "debug";
+            case LogLevel::Info: return "info";
+            case LogLevel::Warning: return "warning";
+            case LogLevel::Error: return "error";
+            default: return "off";
+            }
+        }
+
+        std::mutex outputMutex;
+        std::atomic<bool> allToStderr{ false };
+
+    } // namespace
+
+    std::atomic<int> currentLevel{ InitialLevel() };
+
+    void SetLevel(LogLevel level) {
+        currentLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    LogLevel GetLevel() {
+        return static_cast<LogLevel>(currentLevel.load(std::memory_order_relaxed));
+    }
+
+    bool ParseLevel(const std::string& name, LogLevel& level) {
+        std::string lower(name);
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        for (int candidate = 0; candidate <= static_cast<int>(LogLevel::Off); candidate++) {
+            if (lower == LevelName(static_cast<LogLevel>(candidate))) {
+                level = static_cast<LogLevel>(candidate);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void SetAllToStderr(bool value) {
+        allToStderr.store(value, std::memory_order_relaxed);
+    }
+
+    void Write(LogLevel level, const std::string& message) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        // Warnings and errors go to stderr so they survive redirecting normal output.
+        bool useStderr = level >= LogLevel::Warning || allToStderr.load(std::memory_order_relaxed);
+        std::ostream& output = useStderr ? std::cerr : std::cout;
+        output << "[" << LevelName(level) << "] " << message << '\n';
+        if (level >= LogLevel::Warning) {
+            output.flush();
+        }
+    }
+
+} // namespace Log
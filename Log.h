@@ -0,0 +1,60 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <sstream>
+#include <string>
+
+enum class LogLevel : int {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warning = 3,
+    Error = 4,
+    Off = 5
+};
+
+// Levels below this are compiled out entirely; define it (e.g. /D DCFM_MIN_LOG_LEVEL=2) to strip
+// trace and debug logging from release builds.
+#ifndef DCFM_MIN_LOG_LEVEL
+#define DCFM_MIN_LOG_LEVEL 0
+#endif
+
+namespace Log {
+
+    // Initialized from the DCFM_LOG_LEVEL environment variable (trace, debug, info, warning, error, off),
+    // defaulting to info.
+    extern std::atomic<int> currentLevel;
+
+    inline bool IsEnabled(LogLevel level) {
+        return static_cast<int>(level) >= DCFM_MIN_LOG_LEVEL &&
+            static_cast<int>(level) >= currentLevel.load(std::memory_order_relaxed);
+    }
+
+    void SetLevel(LogLevel level);
+    LogLevel GetLevel();
+    bool ParseLevel(const std::string& name, LogLevel& level);
+    // Sends every level to stderr, keeping stdout free for data (e.g. the CLI's "cat").
+    void SetAllToStderr(bool value);
+    void Write(LogLevel level, const std::string& message);
+
+} // namespace Log
+
+// The message expression is only evaluated when the level is enabled, so disabled logging costs a
+// single relaxed load and branch (or nothing, below DCFM_MIN_LOG_LEVEL).
+#define DCFM_LOG(level, message)                                  \
+    do {                                                          \
+        if (Log::IsEnabled(level)) {                              \
+            std::ostringstream dcfmLogStream;                     \
+            dcfmLogStream << message;                             \
+            Log::Write(level, dcfmLogStream.str());               \
+        }                                                         \
+    } while (0)
+
+#define LOG_TRACE(message) DCFM_LOG(LogLevel::Trace, message)
+#define LOG_DEBUG(message) DCFM_LOG(LogLevel::Debug, message)
+#define LOG_INFO(message) DCFM_LOG(LogLevel::Info, message)
+#define LOG_WARNING(message) DCFM_LOG(LogLevel::Warning, message)
+#define LOG_ERROR(message) DCFM_LOG(LogLevel::Error, message)
+
+#endif // LOG_H
@@ -94,6 +94,11 @@ LRESULT MainWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
         return HandleNotify(lParam);
     case WM_SIZE:
         return HandleResize();
+    case WM_CLOSE:
+        if (MainWindowUtilities::ConfirmDiscardChanges(hwnd_, iso_)) {
+            DestroyWindow(hwnd_);
+        }
+        break;
     case WM_DESTROY:
         PostQuitMessage(0);
         break;
@@ -1,10 +1,69 @@
 #include "MainWindowEventHandler.h"
 #include "MainWindowUtilities.h"
+#include "ISOPatcher.h"
+#include "Log.h"
 #include <CommCtrl.h>
 #include <shlobj.h>
 #include <fstream>
+#include <iterator>
 #include "resource.h"
 
+namespace {
+
+    // Replaces the file selected in the list view with one picked from disk, as a single undoable edit.
+    void ReplaceSelectedFile(HWND hwnd, HWND hwndTreeView, HWND hwndListView, std::unique_ptr<ISO>& iso) {
+        SectorOverlay* overlay = MainWindowUtilities::GetOverlay(iso);
+        int selected = ListView_GetNextItem(hwndListView, -1, LVNI_SELECTED);
+        if (!overlay || selected < 0) {
+            MessageBox(hwnd, L"Select a file to replace first.", L"Replace File", MB_OK | MB_ICONINFORMATION);
+            return;
+        }
+        LVITEM item = { 0 };
+        item.iItem = selected;
+        item.mask = LVIF_PARAM;
+        ListView_GetItem(hwndListView, &item);
+        uint32_t id = static_cast<uint32_t>(item.lParam);
+        if (iso->GetIndex().IsDirectory(id)) {
+            MessageBox(hwnd, L"Directories cannot be replaced.", L"Replace File", MB_OK | MB_ICONINFORMATION);
+            return;
+        }
+
+        OPENFILENAME ofn;
+        wchar_t szFile[260];
+        ZeroMemory(&ofn, sizeof(ofn));
+        ofn.lStructSize = sizeof(ofn);
+        ofn.hwndOwner = hwnd;
+        ofn.lpstrFile = szFile;
+        ofn.lpstrFile[0] = '\0';
+        ofn.nMaxFile = sizeof(szFile) / sizeof(szFile[0]);
+        ofn.lpstrFilter = L"All Files\0*.*\0";
+        ofn.nFilterIndex = 1;
+        ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
+        if (GetOpenFileName(&ofn) != TRUE) {
+            return;
+        }
+
+        try {
+            std::ifstream input(szFile, std::ios::binary);
+            if (!input) {
+                throw std::runtime_error("Failed to open " + MainWindowUtilities::wstringToString(szFile) + ".");
+            }
+            std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+            std::string path = iso->GetIndex().GetPath(id);
+            ISOPatcher patcher(iso->GetFileName());
+            patcher.Replace(path, std::move(data));
+            overlay->Apply(patcher.Plan(*iso), "Replace " + path);
+            MainWindowUtilities::ReloadIso(hwndTreeView, hwndListView, iso);
+        }
+        catch (const std::exception& ex) {
+            LOG_ERROR("Error replacing file: " << ex.what());
+            MessageBox(hwnd, MainWindowUtilities::stringToWstring(ex.what()).c_str(), L"Replace File", MB_OK | MB_ICONERROR);
+        }
+    }
+
+} // namespace
+
 LRESULT MainWindowEventHandler::HandleCommand(HWND hwnd, WPARAM wParam, LPARAM lParam, HWND hwndTreeView, HWND hwndListView, std::unique_ptr<ISO>& iso) {
     switch (LOWORD(wParam)) {
     case ID_FILE_OPEN: {
@@ -24,11 +83,38 @@ LRESULT MainWindowEventHandler::HandleCommand(HWND hwnd, WPARAM wParam, LPARAM l
         ofn.lpstrInitialDir = nullptr;
         ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
 
-        if (GetOpenFileName(&ofn) == TRUE) {
+        if (MainWindowUtilities::ConfirmDiscardChanges(hwnd, iso) && GetOpenFileName(&ofn) == TRUE) {
             MainWindowUtilities::LoadIsoAndDisplayTree(hwnd, hwndTreeView, hwndListView, iso, szFile);
         }
         break;
     }
+    case ID_FILE_SAVE: {
+        // Only the dirty sectors are written back.
+        SectorOverlay* overlay = MainWindowUtilities::GetOverlay(iso);
+        if (overlay && overlay->IsModified()) {
+            try {
+                overlay->Commit();
+                MainWindowUtilities::ReloadIso(hwndTreeView, hwndListView, iso);
+            }
+            catch (const std::exception& ex) {
+                LOG_ERROR("Error saving ISO file: " << ex.what());
+                MessageBox(hwnd, MainWindowUtilities::stringToWstring(ex.what()).c_str(), L"Save", MB_OK | MB_ICONERROR);
+            }
+        }
+        break;
+    }
+    case ID_EDIT_UNDO:
+    case ID_EDIT_REDO: {
+        SectorOverlay* overlay = MainWindowUtilities::GetOverlay(iso);
+        bool changed = overlay && (LOWORD(wParam) == ID_EDIT_UNDO ? overlay->Undo() : overlay->Redo());
+        if (changed) {
+            MainWindowUtilities::ReloadIso(hwndTreeView, hwndListView, iso);
+        }
+        break;
+    }
+    case ID_EDIT_REPLACE:
+        ReplaceSelectedFile(hwnd, hwndTreeView, hwndListView, iso);
+        break;
     case ID_FILE_EXIT:
         PostMessage(hwnd, WM_CLOSE, 0, 0);
         break;
@@ -7,14 +7,22 @@
 void MainWindowLayout::SetupMenu(HWND hwnd) {
     HMENU hMenu = CreateMenu();
     HMENU hFileMenu = CreatePopupMenu();
+    HMENU hEditMenu = CreatePopupMenu();
     HMENU hHelpMenu = CreatePopupMenu();
 
     AppendMenu(hFileMenu, MF_STRING, ID_FILE_OPEN, L"&Open");
+    AppendMenu(hFileMenu, MF_STRING, ID_FILE_SAVE, L"&Save");
     AppendMenu(hFileMenu, MF_STRING, ID_FILE_EXIT, L"E&xit");
 
+    AppendMenu(hEditMenu, MF_STRING, ID_EDIT_UNDO, L"&Undo");
+    AppendMenu(hEditMenu, MF_STRING, ID_EDIT_REDO, L"&Redo");
+    AppendMenu(hEditMenu, MF_SEPARATOR, 0, nullptr);
+    AppendMenu(hEditMenu, MF_STRING, ID_EDIT_REPLACE, L"Re&place File...");
+
     AppendMenu(hHelpMenu, MF_STRING, ID_HELP_ABOUT, L"&About");
 
     AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hFileMenu, L"&File");
+    AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hEditMenu, L"&Edit");
     AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hHelpMenu, L"&Help");
 
     SetMenu(hwnd, hMenu);
@@ -1,6 +1,9 @@
 ﻿#include "MainWindowUtilities.h"
 #include "ISO.h"
+#include "SectorOverlay.h"
 #include "DirectoryRecord.h"
+#include "Log.h"
+#include "Metrics.h"
 #include <CommCtrl.h>
 #include <Shlwapi.h>
 #include <shlobj.h>
@@ -19,172 +22,160 @@
 void MainWindowUtilities::LoadIsoAndDisplayTree(HWND hwnd, HWND hwndTreeView, HWND hwndListView, std::unique_ptr<ISO>& iso, const std::wstring& isoPath) {
     try {
         // Convert the ISO path (wstring) to a std::string using our updated conversion function.
-        iso = std::make_unique<ISO>(wstringToString(isoPath));
+        // Reads go through an overlay so the image can be edited without touching it until saved.
+        std::string path = wstringToString(isoPath);
+        iso = std::make_unique<ISO>(path, std::make_shared<SectorOverlay>(path));
         iso->LoadISO();
-        std::wcout << L"Loaded ISO: " << isoPath << std::endl;
-        std::wcout << L"Directory Records count: " << iso->GetDirectoryRecords().size() << std::endl;
-        std::wcout << L"File Records count: " << iso->GetFileRecords().size() << std::endl;
-
-        // Clear the TreeView and ListView
-        TreeView_DeleteAllItems(hwndTreeView);
-        ListView_DeleteAllItems(hwndListView);
-
-        // Get the ISO name from the path (the stem)
-        std::wstring isoName = std::filesystem::path(isoPath).stem().wstring();
+        LOG_INFO("Loaded ISO: " << path << " (" << iso->GetIndex().Size() << " index entries)");
+        DisplayTree(hwndTreeView, hwndListView, iso);
+    }
+    catch (const std::exception& ex) {
+        LOG_ERROR("Error loading ISO file: " << ex.what());
+    }
+}
 
-        // Populate the TreeView and ListView
-        MainWindowUtilities::PopulateTreeView(hwndTreeView, iso, isoName);
-        PopulateListView(hwndListView, iso, isoName);
+void MainWindowUtilities::ReloadIso(HWND hwndTreeView, HWND hwndListView, std::unique_ptr<ISO>& iso) {
+    // A fresh ISO over the same reader re-parses the directory tree with the current edits applied.
+    try {
+        auto reloaded = std::make_unique<ISO>(iso->GetFileName(), iso->GetReader());
+        reloaded->LoadISO();
+        iso = std::move(reloaded);
+        DisplayTree(hwndTreeView, hwndListView, iso);
     }
     catch (const std::exception& ex) {
-        std::cerr << "Error loading ISO file: " << ex.what() << std::endl;
+        LOG_ERROR("Error reloading ISO file: " << ex.what());
+    }
+}
+
+void MainWindowUtilities::DisplayTree(HWND hwndTreeView, HWND hwndListView, const std::unique_ptr<ISO>& iso) {
+    // Clear the TreeView and ListView
+    TreeView_DeleteAllItems(hwndTreeView);
+    ListView_DeleteAllItems(hwndListView);
+
+    // Get the ISO name from the path (the stem)
+    std::wstring isoName = std::filesystem::path(stringToWstring(iso->GetFileName())).stem().wstring();
+
+    // Populate the TreeView and ListView
+    MainWindowUtilities::PopulateTreeView(hwndTreeView, iso, isoName);
+    PopulateListView(hwndListView, iso, FileIndex::RootId);
+}
+
+SectorOverlay* MainWindowUtilities::GetOverlay(const std::unique_ptr<ISO>& iso) {
+    return iso ? dynamic_cast<SectorOverlay*>(iso->GetReader().get()) : nullptr;
+}
+
+bool MainWindowUtilities::ConfirmDiscardChanges(HWND hwnd, const std::unique_ptr<ISO>& iso) {
+    SectorOverlay* overlay = GetOverlay(iso);
+    if (!overlay || !overlay->IsModified()) {
+        return true;
     }
+    return MessageBox(hwnd, L"The image has unsaved changes. Discard them?", L"Unsaved Changes", MB_YESNO | MB_ICONWARNING) == IDYES;
 }
 
 void MainWindowUtilities::PopulateTreeView(HWND hwndTreeView, const std::unique_ptr<ISO>& iso, const std::wstring& isoName) {
+    Metrics::ScopedTimer timer(Phase::TreeViewPopulation);
     TreeView_DeleteAllItems(hwndTreeView);
-    std::unordered_map<std::wstring, HTREEITEM> treeItems;
+    const FileIndex& index = iso->GetIndex();
+
+    // Tree items by index id. Directories come in tree order, so a parent is always inserted before its children.
+    std::vector<HTREEITEM> treeItems(index.Size(), nullptr);
 
     // Insert the root item using the ISO name.
     TVINSERTSTRUCT tvisRoot = { 0 };
     tvisRoot.hParent = TVI_ROOT;
     tvisRoot.hInsertAfter = TVI_SORT;
-    tvisRoot.item.mask = TVIF_TEXT;
+    tvisRoot.item.mask = TVIF_TEXT | TVIF_PARAM;
     tvisRoot.item.pszText = const_cast<LPWSTR>(isoName.c_str());
-    HTREEITEM hRoot = TreeView_InsertItem(hwndTreeView, &tvisRoot);
-    treeItems[isoName] = hRoot;
-
-    // Loop through each directory record from the ISO.
-    for (const auto& recordPair : iso->GetDirectoryRecords()) {
-        const auto& recordPathStr = recordPair.first; // Expected format: e.g. "MODULES" or "CONF\NET"
-        const auto& record = recordPair.second;
-        if (record.IsDirectory() && !recordPathStr.empty()) {
-
-            // Determine the full tree path.
-            // If the key does not already begin with the root name, prepend it.
-            std::wstring fullPath = stringToWstring(recordPathStr);;
-            
-            if (fullPath.compare(0, isoName.size(), isoName) != 0)
-                fullPath = isoName + L"\\" + fullPath;
-
-            // Tokenize the fullPath by backslashes.
-            std::wistringstream iss(fullPath);
-            std::wstring token;
-            HTREEITEM hParent = hRoot;
-            std::wstring accum;
-            while (std::getline(iss, token, L'\\')) {
-                if (token.empty()) continue;
-                if (accum.empty())
-                    accum = token;
-                else
-                    accum += L"\\" + token;
-                // Insert a new node if this branch hasn't been inserted yet.
-                if (treeItems.find(accum) == treeItems.end()) {
-                    TVINSERTSTRUCT tvis = { 0 };
-                    tvis.hParent = hParent;
-                    tvis.hInsertAfter = TVI_SORT;
-                    tvis.item.mask = TVIF_TEXT;
-                    tvis.item.pszText = const_cast<LPWSTR>(token.c_str());
-                    HTREEITEM hItem = TreeView_InsertItem(hwndTreeView, &tvis);
-                    treeItems[accum] = hItem;
-                    hParent = hItem;
-                }
-                else {
-                    hParent = treeItems[accum];
-                }
-            }
+    tvisRoot.item.lParam = FileIndex::RootId;
+    treeItems[FileIndex::RootId] = TreeView_InsertItem(hwndTreeView, &tvisRoot);
+
+    for (uint32_t id = FileIndex::RootId + 1; id < index.Size(); id++) {
+        if (!index.IsDirectory(id) || treeItems[index.GetParent(id)] == nullptr) {
+            continue;
         }
+
+        TVINSERTSTRUCT tvis = { 0 };
+        tvis.hParent = treeItems[index.GetParent(id)];
+        tvis.hInsertAfter = TVI_SORT;
+        tvis.item.mask = TVIF_TEXT | TVIF_PARAM;
+        tvis.item.pszText = const_cast<LPWSTR>(index.GetDisplayName(id));
+        tvis.item.lParam = id;
+        treeItems[id] = TreeView_InsertItem(hwndTreeView, &tvis);
     }
 }
 
-void MainWindowUtilities::PopulateListView(HWND hwndListView, const std::unique_ptr<ISO>& iso, const std::wstring& folderPath) {
+void MainWindowUtilities::PopulateListView(HWND hwndListView, const std::unique_ptr<ISO>& iso, uint32_t directoryId) {
+    Metrics::ScopedTimer timer(Phase::ListViewPopulation);
     ListView_DeleteAllItems(hwndListView);
+    const FileIndex& index = iso->GetIndex();
+    if (directoryId >= index.Size() || !index.IsDirectory(directoryId)) {
+        return;
+    }
+
     LVITEM lvi = { 0 };
     lvi.mask = LVIF_TEXT;
     lvi.iItem = 0;
-    std::wcout << L"Populating ListView for folder: " << folderPath << std::endl;
+    LOG_DEBUG("Populating ListView for folder: " << iso->GetRootFolderName() << "\\" << index.GetPath(directoryId));
 
-    auto populateList = [&](const std::unordered_map<std::string, DirectoryRecord>& records) {
-        for (const auto& recordPair : records) {
-            const auto& recordPath = recordPair.first; // std::string
-            const auto& record = recordPair.second;
-
-            // Convert parent path from the record's path.
-            std::wstring parentPath = stringToWstring(std::filesystem::path(recordPath).parent_path().string());
-            if (parentPath.empty() || parentPath == L"\\" || parentPath == L"\0") {
-                parentPath = stringToWstring(iso->GetRootFolderName());
+    std::wstring rootName = stringToWstring(iso->GetRootFolderName());
+    auto populateList = [&](bool directories) {
+        for (uint32_t id : index.GetChildren(directoryId)) {
+            if (index.IsDirectory(id) != directories) {
+                continue;
             }
 
-            // Normalize folderPath by removing a trailing backslash if present.
-            std::wstring normalizedFolderPath = folderPath;
-
-            if (!normalizedFolderPath.empty() && normalizedFolderPath.back() == L'\\') {
-                normalizedFolderPath.pop_back();
-            }
-
-            // Normalize parentPath by removing a trailing backslash if present.
-            std::wstring normalizedparentPath = parentPath;
-
-            if (!normalizedparentPath.empty() && normalizedparentPath.back() == L'\\') {
-                normalizedparentPath.pop_back();
-            }
-
-            std::wcout << L"Checking record: " << normalizedFolderPath
-                << L" (Parent: " << normalizedparentPath << L")" << std::endl;
-
-            if (normalizedparentPath == normalizedFolderPath) {
-                std::wcout << L"Inserting record: " << stringToWstring(recordPath) << std::endl;
-
-                // Insert file name
-                std::wstring fileName = stringToWstring(std::filesystem::path(recordPath).filename().string());
-                lvi.iSubItem = 0;
-                lvi.pszText = const_cast<LPWSTR>(fileName.c_str());
-                ListView_InsertItem(hwndListView, &lvi);
-
-                // Insert full path
-                std::wstring recordPathCopy = stringToWstring(recordPath);
-                lvi.iSubItem = 1;
-                lvi.pszText = const_cast<LPWSTR>(recordPathCopy.c_str());
-                ListView_SetItem(hwndListView, &lvi);
-
-                // Insert file size
-                std::wstring fileSize = std::to_wstring(record.DataLength.Value());
-                lvi.iSubItem = 2;
-                lvi.pszText = const_cast<LPWSTR>(fileSize.c_str());
-                ListView_SetItem(hwndListView, &lvi);
-
-                // Insert LBA (logical block address)
-                std::wstringstream lbaStream;
-                lbaStream << record.ExtentLocation.Value();
-                std::wstring lba = lbaStream.str();
-                lvi.iSubItem = 3;
-                lvi.pszText = const_cast<LPWSTR>(lba.c_str());
-                ListView_SetItem(hwndListView, &lvi);
-
-                // Insert sector length (here, reusing DataLength)
-                std::wstringstream sectorLengthStream;
-                sectorLengthStream << record.DataLength.Value();
-                std::wstring sectorLength = sectorLengthStream.str();
-                lvi.iSubItem = 4;
-                lvi.pszText = const_cast<LPWSTR>(sectorLength.c_str());
-                ListView_SetItem(hwndListView, &lvi);
-
-                lvi.iItem++;
-            }
+            // Insert file name
+            lvi.mask = LVIF_TEXT | LVIF_PARAM;
+            lvi.iSubItem = 0;
+            lvi.pszText = const_cast<LPWSTR>(index.GetDisplayName(id));
+            lvi.lParam = id;
+            ListView_InsertItem(hwndListView, &lvi);
+            lvi.mask = LVIF_TEXT;
+
+            // Insert full path
+            std::wstring recordPath = rootName + L"\\" + stringToWstring(index.GetPath(id));
+            lvi.iSubItem = 1;
+            lvi.pszText = const_cast<LPWSTR>(recordPath.c_str());
+            ListView_SetItem(hwndListView, &lvi);
+
+            // Insert file size
+            std::wstring fileSize = std::to_wstring(index.GetSize(id));
+            lvi.iSubItem = 2;
+            lvi.pszText = const_cast<LPWSTR>(fileSize.c_str());
+            ListView_SetItem(hwndListView, &lvi);
+
+            // Insert LBA (logical block address)
+            std::wstring lba = std::to_wstring(index.GetLBA(id));
+            lvi.iSubItem = 3;
+            lvi.pszText = const_cast<LPWSTR>(lba.c_str());
+            ListView_SetItem(hwndListView, &lvi);
+
+            // Insert sector length (here, reusing DataLength)
+            std::wstring sectorLength = std::to_wstring(index.GetSize(id));
+            lvi.iSubItem = 4;
+            lvi.pszText = const_cast<LPWSTR>(sectorLength.c_str());
+            ListView_SetItem(hwndListView, &lvi);
+
+            lvi.iItem++;
         }
         };
 
-    populateList(iso->GetDirectoryRecords());
-    populateList(iso->GetFileRecords());
+    populateList(true);
+    populateList(false);
+    Metrics::Add(Counter::ListViewItems, lvi.iItem);
 }
 
 void MainWindowUtilities::OnTreeViewItemSelectionChanged(HWND hwndTreeView, HWND hwndListView, const std::unique_ptr<ISO>& iso) {
     HTREEITEM hSelectedItem = TreeView_GetSelection(hwndTreeView);
-    if (hSelectedItem) {
-        std::wstring selectedPath = GetFullPathFromTreeViewItem(hwndTreeView, hSelectedItem);
-        std::wcout << L"Selected TreeView item path: " << selectedPath << std::endl;
+    if (hSelectedItem && iso) {
+        // Each tree item carries the index id of its directory.
+        TVITEM item = { 0 };
+        item.hItem = hSelectedItem;
+        item.mask = TVIF_PARAM;
+        TreeView_GetItem(hwndTreeView, &item);
+
         // Update ListView with the contents of the selected folder
-        PopulateListView(hwndListView, iso, selectedPath);
+        PopulateListView(hwndListView, iso, static_cast<uint32_t>(item.lParam));
     }
 }
 
@@ -5,13 +5,20 @@
 #include <string>
 #include <memory>
 #include "ISO.h"
+#include "SectorOverlay.h"
 #include <commctrl.h>
 
 class MainWindowUtilities {
 public:
     static void LoadIsoAndDisplayTree(HWND hwnd, HWND hwndTreeView, HWND hwndListView, std::unique_ptr<ISO>& iso, const std::wstring& isoPath);
+    static void ReloadIso(HWND hwndTreeView, HWND hwndListView, std::unique_ptr<ISO>& iso);
+    static void DisplayTree(HWND hwndTreeView, HWND hwndListView, const std::unique_ptr<ISO>& iso);
+    // The editable layer the ISO reads through, or nullptr if none is open.
+    static SectorOverlay* GetOverlay(const std::unique_ptr<ISO>& iso);
+    // Asks before unsaved edits are thrown away; true to go ahead.
+    static bool ConfirmDiscardChanges(HWND hwnd, const std::unique_ptr<ISO>& iso);
     static void PopulateTreeView(HWND hwndTreeView, const std::unique_ptr<ISO>& iso, const std::wstring& isoName);
-    static void PopulateListView(HWND hwndListView, const std::unique_ptr<ISO>& iso, const std::wstring& folderPath);
+    static void PopulateListView(HWND hwndListView, const std::unique_ptr<ISO>& iso, uint32_t directoryId);
     static void OnTreeViewItemSelectionChanged(HWND hwndTreeView, HWND hwndListView, const std::unique_ptr<ISO>& iso);
     static std::wstring GetFullPathFromTreeViewItem(HWND hwndTreeView, HTREEITEM hItem);
     static std::wstring stringToWstring(const std::string& str);
@@ -0,0 +1,113 @@
+#include "Metrics.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace Metrics {
+
+    namespace {
+
+        struct PhaseStats {
+            std::atomic<uint64_t> Count{ 0 };
+            std::atomic<uint64_t> TotalNanoseconds{ 0 };
+            std::atomic<uint64_t> MaxNanoseconds{ 0 };
+        };
+
+        std::atomic<uint64_t> counters[static_cast<size_t>(Counter::Count)];
+        PhaseStats phases[static_cast<size_t>(Phase::Count)];
+
+        const char* CounterName(Counter counter) {
+            switch (counter) {
+            case Counter::BytesRead: return "bytes_read";
+            case Counter::Reads: return "reads";
+            case Counter::Seeks: return "seeks";
+            case Counter::RecordsParsed: return "records_parsed";
+            case Counter::DirectoriesParsed: return "directories_parsed";
+            case Counter::FilesExtracted: return "files_extracted";
+            case Counter::BytesExtracted: return "bytes_extracted";
+            case Counter::ListViewItems: return "list_view_items";
+            case Counter::SectorCacheHits: return "sector_cache_hits";
+            case Counter::SectorCacheMisses: return "sector_cache_misses";
+            case Counter::SectorCacheEvictions: return "sector_cache_evictions";
+            default: return "unknown";
+            }
+        }
+
+        const char* PhaseName(Phase phase) {
+            switch (phase) {
+            case Phase::PrimaryVolumeDescriptor: return "primary_volume_descriptor";
+            case Phase::PathTable: return "path_table";
+            case Phase::DirectoryWalk: return "directory_walk";
+            case Phase::IndexCacheLoad: return "index_cache_load";
+            case Phase::IndexCacheSave: return "index_cache_save";
+            case Phase::TreeViewPopulation: return "tree_view_population";
+            case Phase::ListViewPopulation: return "list_view_population";
+            case Phase::Extraction: return "extraction";
+            default: return "unknown";
+            }
+        }
+
+    } // namespace
+
+    std::atomic<bool> enabled{ false };
+
+    void SetEnabled(bool value) {
+        enabled.store(value, std::memory_order_relaxed);
+    }
+
+    void Reset() {
+        for (auto& counter : counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto& phase : phases) {
+            phase.Count.store(0, std::memory_order_relaxed);
+            phase.TotalNanoseconds.store(0, std::memory_order_relaxed);
+            phase.MaxNanoseconds.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void AddSlow(Counter counter, uint64_t value) {
+        counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void RecordPhase(Phase phase, uint64_t nanoseconds) {
+        PhaseStats& stats = phases[static_cast<size_t>(phase)];
+        stats.Count.fetch_add(1, std::memory_order_relaxed);
+        stats.TotalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        uint64_t previous = stats.MaxNanoseconds.load(std::memory_order_relaxed);
+        while (nanoseconds > previous &&
+            !stats.MaxNanoseconds.compare_exchange_weak(previous, nanoseconds, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t GetCounter(Counter counter) {
+        return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+
+    std::string ToJson() {
+        std::ostringstream json;
+        json << std::fixed << std::setprecision(3);
+        json << "{\n  \"counters\": {";
+        for (size_t i = 0; i < static_cast<size_t>(Counter::Count); i++) {
+            json << (i == 0 ? "\n" : ",\n") << "    \"" << CounterName(static_cast<Counter>(i)) << "\": "
+                << counters[i].load(std::memory_order_relaxed);
+        }
+        json << "\n  },\n  \"phases\": {";
+        for (size_t i = 0; i < static_cast<size_t>(Phase::Count); i++) {
+            const PhaseStats& stats = phases[i];
+            json << (i == 0 ? "\n" : ",\n") << "    \"" << PhaseName(static_cast<Phase>(i)) << "\": { \"count\": "
+                << stats.Count.load(std::memory_order_relaxed)
+                << ", \"total_ms\": " << stats.TotalNanoseconds.load(std::memory_order_relaxed) / 1e6
+                << ", \"max_ms\": " << stats.MaxNanoseconds.load(std::memory_order_relaxed) / 1e6 << " }";
+        }
+        json << "\n  }\n}\n";
+        return json.str();
+    }
+
+    bool WriteJson(const std::string& path) {
+        std::ofstream output(path, std::ios::trunc);
+        output << ToJson();
+        return static_cast<bool>(output);
+    }
+
+} // namespace Metrics
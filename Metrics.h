@@ -0,0 +1,88 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+enum class Counter {
+    BytesRead,          // Bytes requested from the image backend
+    Reads,              // Read calls against the image backend
+    Seeks,              // Reads that jumped instead of continuing after the previous one
+    RecordsParsed,      // Directory records decoded
+    DirectoriesParsed,  // Directory extents decoded
+    FilesExtracted,
+    BytesExtracted,
+    ListViewItems,
+    SectorCacheHits,        // Sectors served by a SectorCache
+    SectorCacheMisses,      // Sectors a SectorCache had to read from the image
+    SectorCacheEvictions,
+    Count
+};
+
+enum class Phase {
+    PrimaryVolumeDescriptor,
+    PathTable,
+    DirectoryWalk,
+    IndexCacheLoad,
+    IndexCacheSave,
+    TreeViewPopulation,
+    ListViewPopulation,
+    Extraction,
+    Count
+};
+
+// Process-wide load metrics. Everything is a no-op (a relaxed load and branch) until enabled.
+namespace Metrics {
+
+    extern std::atomic<bool> enabled;
+
+    inline bool IsEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void SetEnabled(bool value);
+    void Reset();
+    void AddSlow(Counter counter, uint64_t value);
+    void RecordPhase(Phase phase, uint64_t nanoseconds);
+
+    inline void Add(Counter counter, uint64_t value = 1) {
+        if (IsEnabled()) {
+            AddSlow(counter, value);
+        }
+    }
+
+    uint64_t GetCounter(Counter counter);
+    // {"counters": {...}, "phases": {"path_table": {"count": 1, "total_ms": 0.12, "max_ms": 0.12}, ...}}
+    std::string ToJson();
+    bool WriteJson(const std::string& path);
+
+    // Times the enclosing scope into a phase when metrics are enabled.
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Phase phase) : phase(phase), active(IsEnabled()) {
+            if (active) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~ScopedTimer() {
+            if (active) {
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                RecordPhase(phase, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            }
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Phase phase;
+        bool active;
+        std::chrono::steady_clock::time_point start;
+    };
+
+} // namespace Metrics
+
+#endif // METRICS_H
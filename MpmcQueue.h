@@ -0,0 +1,122 @@
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free queue for any number of producers and consumers (Vyukov's array queue: each
+// cell carries a sequence number telling whose turn it is, so a push or pop is one CAS on a shared
+// position plus a store to the cell). TryPush/TryPop never block; Push/Pop wait on a futex-backed
+// atomic while the queue is full or empty instead of spinning.
+template <typename T>
+class MpmcQueue {
+public:
+    // The capacity is rounded up to a power of two.
+    explicit MpmcQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; i++) {
+            cells[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    // `value` is only moved from when the push succeeds.
+    bool TryPush(T&& value) {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[position & mask];
+            size_t sequence = cell->Sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        cell->Value = std::move(value);
+        cell->Sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value) {
+        size_t position = dequeuePosition.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[position & mask];
+            size_t sequence = cell->Sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0) {
+                if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                position = dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->Value);
+        cell->Value = T();
+        cell->Sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    void Push(T value) {
+        for (;;) {
+            uint32_t seen = pops.load(std::memory_order_acquire);
+            if (TryPush(std::move(value))) {
+                break;
+            }
+            pops.wait(seen, std::memory_order_acquire);
+        }
+        pushes.fetch_add(1, std::memory_order_release);
+        pushes.notify_all();
+    }
+
+    void Pop(T& value) {
+        for (;;) {
+            uint32_t seen = pushes.load(std::memory_order_acquire);
+            if (TryPop(value)) {
+                break;
+            }
+            pushes.wait(seen, std::memory_order_acquire);
+        }
+        pops.fetch_add(1, std::memory_order_release);
+        pops.notify_all();
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> Sequence;
+        T Value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    // Kept on separate cache lines so producers and consumers do not false-share.
+    alignas(64) std::atomic<size_t> enqueuePosition{ 0 };
+    alignas(64) std::atomic<size_t> dequeuePosition{ 0 };
+    // Bumped after every push and pop, for blocked poppers and pushers to wait on.
+    alignas(64) std::atomic<uint32_t> pushes{ 0 };
+    std::atomic<uint32_t> pops{ 0 };
+};
+
+#endif // MPMCQUEUE_H
@@ -0,0 +1,206 @@
+#include "RawSectorReader.h"
+#include "EdcEcc.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    constexpr uint64_t PrimaryVolumeDescriptorLBA = 16;
+    // Raw sectors read per call on the positional path.
+    constexpr size_t RunSectors = 256;
+
+    // The submode byte is the third of the subheader; this bit marks form 2.
+    constexpr size_t SubheaderSize = 8;
+    constexpr size_t SubmodeOffset = 2;
+    constexpr uint8_t SubmodeForm2 = 0x20;
+
+    constexpr uint8_t SyncPattern[12] = { 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+
+    bool HasVolumeDescriptor(ImageReader& reader, SectorLayout layout) {
+        uint8_t identifier[5];
+        uint64_t offset = PrimaryVolumeDescriptorLBA * layout.SectorSize + layout.DataOffset + 1;
+        return offset + sizeof(identifier) <= reader.Size() && reader.Read(offset, identifier, sizeof(identifier)) &&
+            std::memcmp(identifier, "CD001", sizeof(identifier)) == 0;
+    }
+
+    void CheckForm(const uint8_t* subheader, uint64_t sector) {
+        if ((subheader[SubmodeOffset] & SubmodeForm2) != 0) {
+            throw std::runtime_error("Sector " + std::to_string(sector) +
+                " is a MODE2 form 2 sector, whose 2324 bytes of data cannot be used as a 2048-byte block.");
+        }
+    }
+
+} // namespace
+
+std::string SectorLayout::GetName() const {
+    if (!IsRaw()) {
+        return "2048";
+    }
+    return std::string(IsMode2() ? "MODE2/" : "MODE1/") + std::to_string(SectorSize);
+}
+
+RawSectorReader::RawSectorReader(std::unique_ptr<ImageReader> base, SectorLayout layout)
+    : base(std::move(base)), layout(layout) {
+    if (!this->base) {
+        throw std::runtime_error("Failed to open image.");
+    }
+    if (layout.SectorSize < UserDataSize || layout.DataOffset > layout.SectorSize - UserDataSize) {
+        throw std::runtime_error("Invalid sector layout.");
+    }
+    size = this->base->Size() / layout.SectorSize * UserDataSize;
+}
+
+SectorLayout RawSectorReader::Detect(ImageReader& reader) {
+    if (HasVolumeDescriptor(reader, { 2048, 0 })) {
+        return { 2048, 0 };
+    }
+
+    // Raw sectors start with the sync pattern, then a 4-byte header ending in the mode; MODE2
+    // form 1 sectors put an 8-byte subheader before the user data.
+    uint8_t header[16];
+    uint64_t sector = PrimaryVolumeDescriptorLBA * 2352;
+    if (sector + sizeof(header) <= reader.Size() && reader.Read(sector, header, sizeof(header)) &&
+        std::memcmp(header, SyncPattern, sizeof(SyncPattern)) == 0) {
+        SectorLayout layout{ 2352, header[15] == 2 ? 24u : 16u };
+        if (HasVolumeDescriptor(reader, layout)) {
+            return layout;
+        }
+    }
+
+    if (HasVolumeDescriptor(reader, { 2336, 8 })) {
+        return { 2336, 8 };
+    }
+    return { 2048, 0 };
+}
+
+std::unique_ptr<ImageReader> RawSectorReader::Wrap(std::unique_ptr<ImageReader> reader) {
+    if (!reader) {
+        return nullptr;
+    }
+    SectorLayout layout = Detect(*reader);
+    if (!layout.IsRaw()) {
+        return reader;
+    }
+    return std::make_unique<RawSectorReader>(std::move(reader), layout);
+}
+
+uint64_t RawSectorReader::GetRawOffset(uint64_t offset) const {
+    return offset / UserDataSize * layout.SectorSize + layout.DataOffset + offset % UserDataSize;
+}
+
+bool RawSectorReader::Read(uint64_t offset, void* buffer, size_t length) {
+    if (offset > size || length > size - offset) {
+        return false;
+    }
+    uint8_t* destination = static_cast<uint8_t*>(buffer);
+
+    if (const uint8_t* raw = base->Data()) {
+        while (length > 0) {
+            size_t within = static_cast<size_t>(offset % UserDataSize);
+            size_t chunk = std::min<size_t>(length, UserDataSize - within);
+            const uint8_t* payload = raw + GetRawOffset(offset);
+            if (layout.IsMode2()) {
+                CheckForm(payload - within - SubheaderSize, offset / UserDataSize);
+            }
+            std::memcpy(destination, payload, chunk);
+            destination += chunk;
+            offset += chunk;
+            length -= chunk;
+        }
+        return true;
+    }
+
+    // A read inside one sector needs no staging, unless the subheader has to be read as well.
+    size_t within = static_cast<size_t>(offset % UserDataSize);
+    if (!layout.IsMode2() && length <= UserDataSize - within) {
+        return base->Read(GetRawOffset(offset), destination, length);
+    }
+
+    std::vector<uint8_t> staging;
+    uint64_t sector = offset / UserDataSize;
+    while (length > 0) {
+        size_t sectors = std::min<size_t>((within + length + UserDataSize - 1) / UserDataSize, RunSectors);
+        // The run starts at the first wanted byte, or the first subheader for MODE2, and stops after
+        // the last one, so the sync and ECC at either end are not read.
+        size_t lead = layout.IsMode2() ? SubheaderSize + within : 0;
+        size_t lastChunk = std::min<size_t>(within + length - (sectors - 1) * UserDataSize, UserDataSize);
+        size_t rawLength = lead + (sectors - 1) * layout.SectorSize + lastChunk - within;
+        staging.resize(rawLength);
+        if (!base->Read(sector * layout.SectorSize + layout.DataOffset + within - lead, staging.data(), rawLength)) {
+            return false;
+        }
+        const uint8_t* source = staging.data() + lead;
+        for (size_t i = 0; i < sectors; i++) {
+            if (layout.IsMode2()) {
+                CheckForm(source - within - SubheaderSize, sector + i);
+            }
+            size_t chunk = std::min<size_t>(length, UserDataSize - within);
+            std::memcpy(destination, source, chunk);
+            destination += chunk;
+            length -= chunk;
+            source += chunk + layout.SectorSize - UserDataSize;
+            within = 0;
+        }
+        sector += sectors;
+    }
+    return true;
+}
+
+std::vector<ImageWrite> RawSectorReader::ToRawWrites(const std::vector<ImageWrite>& writes) {
+    // Every sector is held as the 2352 bytes it was or would be cut from, so MODE2/2336 sectors
+    // get the same treatment.
+    const size_t headerSkipped = EdcEcc::RawSectorSize - layout.SectorSize;
+    const uint8_t mode = layout.IsMode2() ? 2 : 1;
+    const uint64_t baseSectors = base->Size() / layout.SectorSize;
+    std::map<uint64_t, std::vector<uint8_t>> sectors;
+
+    for (const auto& write : writes) {
+        uint64_t offset = write.Offset;
+        size_t position = 0;
+        while (position < write.Data.size()) {
+            uint64_t sector = offset / UserDataSize;
+            size_t within = static_cast<size_t>(offset % UserDataSize);
+            size_t chunk = std::min<size_t>(write.Data.size() - position, UserDataSize - within);
+
+            auto [found, inserted] = sectors.try_emplace(sector);
+            std::vector<uint8_t>& raw = found->second;
+            if (inserted) {
+                raw.assign(EdcEcc::RawSectorSize, 0);
+                if (sector < baseSectors) {
+                    if (!base->Read(sector * layout.SectorSize, raw.data() + headerSkipped, layout.SectorSize)) {
+                        throw std::runtime_error("Failed to read from image.");
+                    }
+                    if (mode == 2) {
+                        CheckForm(raw.data() + 16, sector);
+                    }
+                }
+                else if (mode == 2) {
+                    // Subheader, twice: file 0, channel 0, submode data, coding 0.
+                    const uint8_t subheader[8] = { 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x08, 0x00 };
+                    std::memcpy(raw.data() + 16, subheader, sizeof(subheader));
+                }
+                if (headerSkipped > 0 || sector >= baseSectors) {
+                    EdcEcc::WriteHeader(raw.data(), static_cast<uint32_t>(sector), mode);
+                }
+            }
+            std::memcpy(raw.data() + headerSkipped + layout.DataOffset + within, write.Data.data() + position, chunk);
+            offset += chunk;
+            position += chunk;
+        }
+    }
+
+    // Adjacent sectors become single writes.
+    std::vector<ImageWrite> rawWrites;
+    for (auto& [sector, raw] : sectors) {
+        EdcEcc::Regenerate(raw.data());
+        uint64_t offset = sector * layout.SectorSize;
+        if (rawWrites.empty() || rawWrites.back().Offset + rawWrites.back().Data.size() != offset) {
+            rawWrites.push_back({ offset, {} });
+        }
+        rawWrites.back().Data.insert(rawWrites.back().Data.end(), raw.begin() + headerSkipped, raw.end());
+    }
+    return rawWrites;
+}
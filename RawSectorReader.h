@@ -0,0 +1,63 @@
+#ifndef RAWSECTORREADER_H
+#define RAWSECTORREADER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ImageReader.h"
+#include "ISOPatcher.h"
+
+// Where the 2048 bytes of user data sit in each sector of an image file.
+struct SectorLayout {
+    uint32_t SectorSize = 2048;     // Bytes per sector in the file
+    uint32_t DataOffset = 0;        // Offset of the user data within each sector
+
+    bool IsRaw() const { return SectorSize != 2048; }
+    // MODE2 sectors carry an 8-byte subheader right before the user data.
+    bool IsMode2() const { return SectorSize == 2336 || DataOffset == 24; }
+    // "2048", "MODE1/2352", "MODE2/2352" or "MODE2/2336".
+    std::string GetName() const;
+};
+
+// Presents a raw CD image (2352-byte sectors with sync, header and EDC/ECC, or 2336-byte MODE2
+// sectors without sync and header) as a plain 2048-byte-sector image, so ISO and everything above
+// it address logical blocks as usual. A read is split into the user-data payloads of the sectors
+// it covers: straight out of the mapping when the file is mapped, otherwise by reading each run of
+// contiguous raw sectors with one call and copying the payloads out of it.
+//
+// Only MODE1 and MODE2 form 1 sectors hold 2048 bytes of user data. Reading or writing a MODE2
+// form 2 sector (2324 bytes, e.g. XA audio or video streams) throws std::runtime_error.
+class RawSectorReader : public ImageReader {
+public:
+    static constexpr uint32_t UserDataSize = 2048;
+
+    RawSectorReader(std::unique_ptr<ImageReader> base, SectorLayout layout);
+
+    // Looks for the primary volume descriptor under each known layout; a file matching none of
+    // them is taken to be a plain 2048-byte-sector image.
+    static SectorLayout Detect(ImageReader& reader);
+    // Returns `reader` itself for plain images and a RawSectorReader over it for raw ones.
+    static std::unique_ptr<ImageReader> Wrap(std::unique_ptr<ImageReader> reader);
+
+    ImageBackend GetBackend() const override { return base->GetBackend(); }
+    uint64_t Size() const override { return size; }
+    bool Read(uint64_t offset, void* buffer, size_t length) override;
+    bool IsCompressed() const override { return base->IsCompressed(); }
+
+    const SectorLayout& GetLayout() const { return layout; }
+    // Offset in the file of the logical byte at `offset`.
+    uint64_t GetRawOffset(uint64_t offset) const;
+
+    // Turns writes at logical offsets into writes of the whole raw sectors they touch, with their
+    // EDC and ECC regenerated. Sectors past the end of the file are created as MODE1 or MODE2
+    // form 1 data sectors, as the layout implies.
+    std::vector<ImageWrite> ToRawWrites(const std::vector<ImageWrite>& writes);
+
+private:
+    std::unique_ptr<ImageReader> base;
+    SectorLayout layout;
+    uint64_t size;
+};
+
+#endif // RAWSECTORREADER_H
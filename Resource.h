@@ -14,6 +14,7 @@
 #define ID_EDIT_COPY 9005
 #define ID_EDIT_PASTE 9006
 #define ID_HELP_ABOUT 9007
+#define ID_EDIT_REPLACE 9008
 
 #define IDC_TREEVIEW 201
 #define IDC_LISTVIEW 202
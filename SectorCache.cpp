@@ -0,0 +1,166 @@
+#include "SectorCache.h"
+#include "Log.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+    std::atomic<uint64_t> defaultCapacity{ 32ull * 1024 * 1024 };
+
+} // namespace
+
+SectorCache::SectorCache(std::unique_ptr<ImageReader> base, uint64_t capacityBytes)
+    : base(std::move(base)) {
+    if (!this->base) {
+        throw std::runtime_error("Failed to open image.");
+    }
+    shardSectors = static_cast<size_t>(std::max<uint64_t>(1, capacityBytes / SectorSize / ShardCount));
+    // A fifth of each shard stays probation, so new sectors always have somewhere to prove themselves.
+    protectedSectors = shardSectors * 4 / 5;
+}
+
+SectorCache::~SectorCache() {
+    LOG_DEBUG("Sector cache: " << hits.load() << " hits, " << misses.load() << " misses, "
+        << evictions.load() << " evictions, " << bypassed.load() << " bypassed reads");
+}
+
+std::unique_ptr<ImageReader> SectorCache::Wrap(std::unique_ptr<ImageReader> reader) {
+    uint64_t capacity = GetDefaultCapacity();
+    if (!reader || reader->Data() != nullptr || capacity == 0) {
+        return reader;
+    }
+    return std::make_unique<SectorCache>(std::move(reader), capacity);
+}
+
+void SectorCache::SetDefaultCapacity(uint64_t bytes) {
+    defaultCapacity.store(bytes, std::memory_order_relaxed);
+}
+
+uint64_t SectorCache::GetDefaultCapacity() {
+    return defaultCapacity.load(std::memory_order_relaxed);
+}
+
+SectorCacheStats SectorCache::GetStats() const {
+    SectorCacheStats stats;
+    stats.Hits = hits.load(std::memory_order_relaxed);
+    stats.Misses = misses.load(std::memory_order_relaxed);
+    stats.Evictions = evictions.load(std::memory_order_relaxed);
+    stats.Bypassed = bypassed.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool SectorCache::Lookup(Shard& shard, uint64_t sector, uint8_t* destination, size_t within, size_t length) {
+    auto found = shard.Entries.find(sector);
+    if (found == shard.Entries.end()) {
+        return false;
+    }
+    Entry& entry = found->second;
+    if (entry.Protected) {
+        shard.Protected.splice(shard.Protected.begin(), shard.Protected, entry.Position);
+    }
+    else {
+        // Read a second time: promote it, demoting the least recently used protected sector if
+        // the segment is full. The demoted sector gets another round in probation.
+        shard.Probation.erase(entry.Position);
+        shard.Protected.push_front(sector);
+        entry.Position = shard.Protected.begin();
+        entry.Protected = true;
+        if (shard.Protected.size() > protectedSectors) {
+            uint64_t demoted = shard.Protected.back();
+            shard.Protected.pop_back();
+            shard.Probation.push_front(demoted);
+            Entry& demotedEntry = shard.Entries.at(demoted);
+            demotedEntry.Protected = false;
+            demotedEntry.Position = shard.Probation.begin();
+        }
+    }
+    std::memcpy(destination, entry.Data.data() + within, length);
+    return true;
+}
+
+void SectorCache::Insert(Shard& shard, uint64_t sector, const uint8_t* data, size_t length) {
+    auto [found, inserted] = shard.Entries.try_emplace(sector);
+    if (!inserted) {
+        return;
+    }
+    shard.Probation.push_front(sector);
+    found->second.Data.assign(data, data + length);
+    found->second.Protected = false;
+    found->second.Position = shard.Probation.begin();
+
+    uint64_t evicted = 0;
+    while (shard.Entries.size() > shardSectors) {
+        std::list<uint64_t>& segment = shard.Probation.empty() ? shard.Protected : shard.Probation;
+        shard.Entries.erase(segment.back());
+        segment.pop_back();
+        evicted++;
+    }
+    if (evicted > 0) {
+        evictions.fetch_add(evicted, std::memory_order_relaxed);
+        Metrics::Add(Counter::SectorCacheEvictions, evicted);
+    }
+}
+
+bool SectorCache::Read(uint64_t offset, void* buffer, size_t length) {
+    const uint64_t size = base->Size();
+    if (offset > size || length > size - offset) {
+        return false;
+    }
+    if (length > BypassBytes) {
+        bypassed.fetch_add(1, std::memory_order_relaxed);
+        return base->Read(offset, buffer, length);
+    }
+
+    uint8_t* destination = static_cast<uint8_t*>(buffer);
+    uint64_t sector = offset / SectorSize;
+    size_t within = static_cast<size_t>(offset % SectorSize);
+    const uint64_t lastSector = length == 0 ? sector : (offset + length - 1) / SectorSize;
+    uint64_t found = 0;
+
+    while (length > 0) {
+        size_t chunk = std::min<size_t>(length, SectorSize - within);
+        Shard& shard = GetShard(sector);
+        bool hit;
+        {
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            hit = Lookup(shard, sector, destination, within, chunk);
+        }
+        if (hit) {
+            found++;
+            destination += chunk;
+            length -= chunk;
+            within = 0;
+            sector++;
+            continue;
+        }
+
+        // Everything from the first miss to the end of the request comes in with one read;
+        // sectors in it that were already cached are simply not inserted again.
+        uint64_t start = sector * SectorSize;
+        uint64_t end = std::min((lastSector + 1) * SectorSize, size);
+        std::vector<uint8_t> staging(static_cast<size_t>(end - start));
+        if (!base->Read(start, staging.data(), staging.size())) {
+            return false;
+        }
+        for (uint64_t s = sector; s <= lastSector; s++) {
+            size_t position = static_cast<size_t>((s - sector) * SectorSize);
+            size_t sectorLength = std::min<size_t>(SectorSize, staging.size() - position);
+            Shard& target = GetShard(s);
+            std::lock_guard<std::mutex> lock(target.Mutex);
+            Insert(target, s, staging.data() + position, sectorLength);
+        }
+        std::memcpy(destination, staging.data() + within, length);
+        uint64_t missed = lastSector - sector + 1;
+        misses.fetch_add(missed, std::memory_order_relaxed);
+        Metrics::Add(Counter::SectorCacheMisses, missed);
+        break;
+    }
+
+    if (found > 0) {
+        hits.fetch_add(found, std::memory_order_relaxed);
+        Metrics::Add(Counter::SectorCacheHits, found);
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef SECTORCACHE_H
+#define SECTORCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "ImageReader.h"
+
+struct SectorCacheStats {
+    uint64_t Hits = 0;          // Sectors served from the cache
+    uint64_t Misses = 0;        // Sectors read from the image and cached
+    uint64_t Evictions = 0;     // Sectors dropped to make room
+    uint64_t Bypassed = 0;      // Large reads passed straight to the image
+};
+
+// Bounded cache of 2048-byte sectors in front of an image that is not memory-mapped, so directory
+// extents, path tables and small files read more than once cost one trip to the image (or one
+// decompression) instead of one each time.
+//
+// Eviction is segmented LRU: a sector enters a probation segment and only moves to the protected
+// one when it is read again, so a long run of sectors read once (a big file being extracted) cycles
+// through probation without pushing out directory metadata. Reads larger than BypassBytes skip the
+// cache altogether. Sectors are spread over independently locked shards to keep worker threads
+// from serialising on one mutex.
+class SectorCache : public ImageReader {
+public:
+    static constexpr uint32_t SectorSize = 2048;
+    static constexpr uint64_t BypassBytes = 256 * 1024;
+
+    SectorCache(std::unique_ptr<ImageReader> base, uint64_t capacityBytes);
+    ~SectorCache() override;
+
+    // Returns `reader` itself when it is memory-mapped (the page cache already serves repeated
+    // reads without a copy) or when the default capacity is 0.
+    static std::unique_ptr<ImageReader> Wrap(std::unique_ptr<ImageReader> reader);
+    // Capacity given to caches created by Wrap(). Default 32 MiB.
+    static void SetDefaultCapacity(uint64_t bytes);
+    static uint64_t GetDefaultCapacity();
+
+    ImageBackend GetBackend() const override { return base->GetBackend(); }
+    uint64_t Size() const override { return base->Size(); }
+    bool Read(uint64_t offset, void* buffer, size_t length) override;
+    bool IsCompressed() const override { return base->IsCompressed(); }
+    bool ReadsFileDirectly() const override { return base->ReadsFileDirectly(); }
+
+    SectorCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        std::vector<uint8_t> Data;
+        bool Protected;
+        std::list<uint64_t>::iterator Position;
+    };
+
+    struct Shard {
+        std::mutex Mutex;
+        std::unordered_map<uint64_t, Entry> Entries;
+        std::list<uint64_t> Probation;  // Front is most recent
+        std::list<uint64_t> Protected;
+    };
+
+    static constexpr size_t ShardCount = 16;
+
+    Shard& GetShard(uint64_t sector) { return shards[sector % ShardCount]; }
+    // Copies the sector out if cached, promoting it. Caller holds the shard mutex.
+    bool Lookup(Shard& shard, uint64_t sector, uint8_t* destination, size_t within, size_t length);
+    void Insert(Shard& shard, uint64_t sector, const uint8_t* data, size_t length);
+
+    std::unique_ptr<ImageReader> base;
+    size_t shardSectors;            // Capacity of each shard
+    size_t protectedSectors;        // Of which at most this many are protected
+    Shard shards[ShardCount];
+
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+    std::atomic<uint64_t> evictions{ 0 };
+    std::atomic<uint64_t> bypassed{ 0 };
+};
+
+#endif // SECTORCACHE_H
@@ -0,0 +1,295 @@
+#include "SectorOverlay.h"
+#include "Log.h"
+#include "RawSectorReader.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+SectorOverlay::SectorOverlay(std::string imagePath, ImageBackend backend)
+    : path(std::move(imagePath)), backend(backend) {
+    OpenBase();
+    size = baseSize;
+}
+
+void SectorOverlay::OpenBase() {
+    base = ImageReader::OpenImage(path, backend);
+    if (!base) {
+        throw std::runtime_error("Failed to open image: " + path);
+    }
+    baseSize = base->Size();
+}
+
+uint64_t SectorOverlay::Size() const {
+    std::shared_lock lock(mutex);
+    return size;
+}
+
+bool SectorOverlay::IsModified() const {
+    std::shared_lock lock(mutex);
+    return !pages.empty() || size != baseSize;
+}
+
+bool SectorOverlay::ReadBase(uint64_t offset, uint8_t* buffer, size_t length) {
+    // Sectors the image ends in the middle of (or that lie wholly past it) read as zeros.
+    if (!base) {
+        return false;
+    }
+    size_t available = offset < baseSize ? static_cast<size_t>(std::min<uint64_t>(length, baseSize - offset)) : 0;
+    if (available > 0 && !base->Read(offset, buffer, available)) {
+        return false;
+    }
+    std::memset(buffer + available, 0, length - available);
+    return true;
+}
+
+bool SectorOverlay::Read(uint64_t offset, void* buffer, size_t length) {
+    std::shared_lock lock(mutex);
+    if (offset > size || length > size - offset) {
+        return false;
+    }
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    if (pages.empty()) {
+        return ReadBase(offset, out, length);
+    }
+
+    // Alternate between runs of clean sectors, read from the image in one go, and dirty pages.
+    const uint64_t end = offset + length;
+    uint64_t position = offset;
+    auto page = pages.lower_bound(position / SectorSize);
+    while (position < end) {
+        uint64_t sector = position / SectorSize;
+        uint64_t next;
+        if (page != pages.end() && page->first == sector) {
+            next = std::min<uint64_t>(end, (sector + 1) * SectorSize);
+            std::memcpy(out, page->second->data() + position % SectorSize, static_cast<size_t>(next - position));
+            ++page;
+        }
+        else {
+            next = page != pages.end() ? std::min<uint64_t>(end, page->first * SectorSize) : end;
+            if (!ReadBase(position, out, static_cast<size_t>(next - position))) {
+                return false;
+            }
+        }
+        out += next - position;
+        position = next;
+    }
+    return true;
+}
+
+std::vector<uint8_t> SectorOverlay::ReadSector(uint64_t sector) {
+    auto page = pages.find(sector);
+    if (page != pages.end()) {
+        return *page->second;
+    }
+    std::vector<uint8_t> data(SectorSize);
+    if (!ReadBase(sector * SectorSize, data.data(), SectorSize)) {
+        throw std::runtime_error("Failed to read sector " + std::to_string(sector) + " of " + path + ".");
+    }
+    return data;
+}
+
+void SectorOverlay::Write(uint64_t offset, const void* data, size_t length, std::string description) {
+    std::vector<ImageWrite> writes;
+    writes.push_back({ offset, std::vector<uint8_t>(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + length) });
+    Apply(writes, std::move(description));
+}
+
+void SectorOverlay::Apply(const std::vector<ImageWrite>& writes, std::string description) {
+    std::unique_lock lock(mutex);
+    JournalEntry entry{ std::move(description), {}, size, size };
+    std::unordered_set<uint64_t> touched;
+
+    for (const auto& write : writes) {
+        const uint8_t* source = write.Data.data();
+        uint64_t position = write.Offset;
+        const uint64_t end = write.Offset + write.Data.size();
+        while (position < end) {
+            uint64_t sector = position / SectorSize;
+            size_t start = static_cast<size_t>(position % SectorSize);
+            size_t length = static_cast<size_t>(std::min<uint64_t>(end - position, SectorSize - start));
+
+            if (touched.insert(sector).second) {
+                auto current = pages.find(sector);
+                entry.Changes.push_back({ sector, current != pages.end() ? current->second : nullptr, nullptr });
+            }
+            // Whole sectors need not be read first.
+            std::vector<uint8_t> contents = length == SectorSize ? std::vector<uint8_t>(SectorSize) : ReadSector(sector);
+            std::memcpy(contents.data() + start, source, length);
+            pages[sector] = std::make_shared<const std::vector<uint8_t>>(std::move(contents));
+
+            source += length;
+            position += length;
+        }
+        entry.SizeAfter = std::max(entry.SizeAfter, end);
+    }
+    if (entry.Changes.empty()) {
+        return;
+    }
+
+    for (auto& change : entry.Changes) {
+        change.After = pages[change.Sector];
+    }
+    size = entry.SizeAfter;
+    LOG_DEBUG("Overlay edit \"" << entry.Description << "\": " << entry.Changes.size() << " sectors, "
+        << pages.size() << " dirty in total");
+    undoJournal.push_back(std::move(entry));
+    redoJournal.clear();
+    TrimJournal();
+}
+
+void SectorOverlay::Restore(const JournalEntry& entry, bool forward) {
+    for (const auto& change : entry.Changes) {
+        const Page& page = forward ? change.After : change.Before;
+        if (page) {
+            pages[change.Sector] = page;
+        }
+        else {
+            pages.erase(change.Sector);
+        }
+    }
+    size = forward ? entry.SizeAfter : entry.SizeBefore;
+}
+
+bool SectorOverlay::CanUndo() const {
+    std::shared_lock lock(mutex);
+    return !undoJournal.empty();
+}
+
+bool SectorOverlay::CanRedo() const {
+    std::shared_lock lock(mutex);
+    return !redoJournal.empty();
+}
+
+std::string SectorOverlay::GetUndoDescription() const {
+    std::shared_lock lock(mutex);
+    return undoJournal.empty() ? std::string() : undoJournal.back().Description;
+}
+
+std::string SectorOverlay::GetRedoDescription() const {
+    std::shared_lock lock(mutex);
+    return redoJournal.empty() ? std::string() : redoJournal.back().Description;
+}
+
+bool SectorOverlay::Undo() {
+    std::unique_lock lock(mutex);
+    if (undoJournal.empty()) {
+        return false;
+    }
+    Restore(undoJournal.back(), false);
+    redoJournal.push_back(std::move(undoJournal.back()));
+    undoJournal.pop_back();
+    return true;
+}
+
+bool SectorOverlay::Redo() {
+    std::unique_lock lock(mutex);
+    if (redoJournal.empty()) {
+        return false;
+    }
+    Restore(redoJournal.back(), true);
+    undoJournal.push_back(std::move(redoJournal.back()));
+    redoJournal.pop_back();
+    return true;
+}
+
+void SectorOverlay::SetJournalLimit(size_t entries) {
+    std::unique_lock lock(mutex);
+    journalLimit = entries;
+    TrimJournal();
+}
+
+void SectorOverlay::TrimJournal() {
+    while (undoJournal.size() > journalLimit) {
+        undoJournal.pop_front();
+    }
+}
+
+size_t SectorOverlay::GetDirtySectorCount() const {
+    std::shared_lock lock(mutex);
+    return pages.size();
+}
+
+uint64_t SectorOverlay::GetMemoryUsage() const {
+    std::shared_lock lock(mutex);
+    // Pages are shared between the overlay and the journal, so each is counted once.
+    std::unordered_set<const std::vector<uint8_t>*> seen;
+    uint64_t bytes = 0;
+    auto count = [&](const Page& page) {
+        if (page && seen.insert(page.get()).second) {
+            bytes += page->size();
+        }
+    };
+    for (const auto& [sector, page] : pages) {
+        count(page);
+    }
+    auto countEntry = [&](const JournalEntry& entry) {
+        for (const auto& change : entry.Changes) {
+            count(change.Before);
+            count(change.After);
+        }
+    };
+    std::for_each(undoJournal.begin(), undoJournal.end(), countEntry);
+    std::for_each(redoJournal.begin(), redoJournal.end(), countEntry);
+    return bytes;
+}
+
+uint64_t SectorOverlay::Commit() {
+    std::unique_lock lock(mutex);
+    if (!base) {
+        // An earlier commit wrote the image but could not reopen it.
+        OpenBase();
+    }
+    if (pages.empty() && size == baseSize) {
+        return 0;
+    }
+    if (base->IsCompressed()) {
+        throw std::runtime_error("Compressed images cannot be committed to; their edits stay in the overlay.");
+    }
+
+    // Runs of adjacent dirty sectors become single writes, trimmed to the image size.
+    std::vector<ImageWrite> writes;
+    for (const auto& [sector, page] : pages) {
+        uint64_t offset = sector * SectorSize;
+        if (offset >= size) {
+            continue;
+        }
+        size_t length = static_cast<size_t>(std::min<uint64_t>(SectorSize, size - offset));
+        if (writes.empty() || writes.back().Offset + writes.back().Data.size() != offset) {
+            writes.push_back({ offset, {} });
+        }
+        writes.back().Data.insert(writes.back().Data.end(), page->begin(), page->begin() + length);
+    }
+
+    if (auto* raw = dynamic_cast<RawSectorReader*>(base.get())) {
+        writes = raw->ToRawWrites(writes);
+    }
+
+    // The image must be unmapped before it can be opened for writing on Windows. Should it fail to
+    // reopen, base stays null: reads fail rather than crash, and the next Commit() tries again.
+    base.reset();
+    uint64_t bytesWritten = 0;
+    try {
+        bytesWritten = ISOPatcher::ApplyWrites(path, writes);
+    }
+    catch (...) {
+        try {
+            OpenBase();
+        }
+        catch (const std::exception& ex) {
+            LOG_ERROR("Failed to reopen " << path << " after a failed commit: " << ex.what());
+        }
+        throw;
+    }
+    OpenBase();
+    size = baseSize;
+
+    LOG_INFO("Committed " << pages.size() << " dirty sectors to " << path << " in " << writes.size()
+        << " writes (" << bytesWritten << " bytes)");
+    pages.clear();
+    undoJournal.clear();
+    redoJournal.clear();
+    return bytesWritten;
+}
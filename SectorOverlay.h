@@ -0,0 +1,95 @@
+#ifndef SECTOROVERLAY_H
+#define SECTOROVERLAY_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "ImageReader.h"
+#include "ISOPatcher.h"
+
+// An editable layer over a read-only image. Edited sectors are held in a sparse copy-on-write
+// overlay of immutable 2048-byte pages; everything else is read from the image, which is never
+// touched until Commit(). Each edit is one journal entry holding the pages it replaced, so memory
+// grows with the changed data (and the undo history) rather than with the image size.
+//
+// Reads never hand out pointers into the underlying mapping (Data() is always nullptr), so views
+// taken from an overlay stay valid across Commit().
+class SectorOverlay : public ImageReader {
+public:
+    static constexpr uint32_t SectorSize = 2048;
+
+    // Throws std::runtime_error if the image cannot be opened.
+    explicit SectorOverlay(std::string imagePath, ImageBackend backend = ImageBackend::Auto);
+
+    ImageBackend GetBackend() const override { return backend; }
+    uint64_t Size() const override;
+    bool Read(uint64_t offset, void* buffer, size_t length) override;
+    bool IsModified() const override;
+
+    // Each call is one journal entry, undone or redone as a whole. Writes past the end grow the
+    // image. A new edit discards the redo history.
+    void Write(uint64_t offset, const void* data, size_t length, std::string description = {});
+    void Apply(const std::vector<ImageWrite>& writes, std::string description = {});
+
+    bool CanUndo() const;
+    bool CanRedo() const;
+    std::string GetUndoDescription() const;
+    std::string GetRedoDescription() const;
+    // Return false when there is nothing to undo or redo.
+    bool Undo();
+    bool Redo();
+
+    // Oldest entries past the limit are forgotten; their edits stay in the overlay. Default 256.
+    void SetJournalLimit(size_t entries);
+
+    size_t GetDirtySectorCount() const;
+    // Bytes of page data held by the overlay and the journal together.
+    uint64_t GetMemoryUsage() const;
+
+    // Writes the dirty sectors into the image, adjacent ones as single writes, then reopens it and
+    // clears the overlay and the journal. Returns the number of bytes written. On failure the
+    // edits are kept so the commit can be retried. If the image cannot be reopened afterwards,
+    // reads fail until a later Commit() manages to reopen it.
+    uint64_t Commit();
+
+    const std::string& GetPath() const { return path; }
+
+private:
+    using Page = std::shared_ptr<const std::vector<uint8_t>>;
+
+    struct SectorChange {
+        uint64_t Sector;
+        Page Before;    // nullptr when the sector was read from the image
+        Page After;
+    };
+
+    struct JournalEntry {
+        std::string Description;
+        std::vector<SectorChange> Changes;
+        uint64_t SizeBefore;
+        uint64_t SizeAfter;
+    };
+
+    void OpenBase();
+    bool ReadBase(uint64_t offset, uint8_t* buffer, size_t length);
+    std::vector<uint8_t> ReadSector(uint64_t sector);
+    void Restore(const JournalEntry& entry, bool forward);
+    void TrimJournal();
+
+    std::string path;
+    ImageBackend backend;
+    std::unique_ptr<ImageReader> base;
+    uint64_t baseSize = 0;
+    uint64_t size = 0;
+    std::map<uint64_t, Page> pages;
+    std::deque<JournalEntry> undoJournal;
+    std::vector<JournalEntry> redoJournal;
+    size_t journalLimit = 256;
+    mutable std::shared_mutex mutex;
+};
+
+#endif // SECTOROVERLAY_H
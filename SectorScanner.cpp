@@ -0,0 +1,181 @@
+#include "SectorScanner.h"
+#include "Bytes.h"
+#include "EdcEcc.h"
+#include "ISOPatcher.h"
+#include "Log.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+    constexpr size_t ChunkSize = 4 * 1024 * 1024;
+    constexpr uint64_t PrimaryVolumeDescriptorLBA = 16;
+    constexpr size_t VolumeSpaceSizeOffset = 80;
+
+    struct ChunkResult {
+        SectorScanReport Report;
+        std::vector<ImageWrite> Repairs;
+    };
+
+    void Append(std::vector<uint32_t>& to, const std::vector<uint32_t>& from) {
+        to.insert(to.end(), from.begin(), from.end());
+    }
+
+    void CheckChunk(const uint8_t* data, uint64_t firstSector, uint64_t sectorCount, SectorLayout layout, bool repair, ChunkResult& result) {
+        SectorScanReport& report = result.Report;
+        // MODE2/2336 sectors are checked as the 2352-byte sectors they were cut from.
+        const size_t headerSkipped = EdcEcc::RawSectorSize - layout.SectorSize;
+        uint8_t expanded[EdcEcc::RawSectorSize];
+
+        for (uint64_t i = 0; i < sectorCount; i++) {
+            uint32_t lba = static_cast<uint32_t>(firstSector + i);
+            const uint8_t* sector = data + i * layout.SectorSize;
+            if (headerSkipped > 0) {
+                EdcEcc::WriteHeader(expanded, lba, 2);
+                std::memcpy(expanded + headerSkipped, sector, layout.SectorSize);
+                sector = expanded;
+            }
+
+            EdcEcc::SectorCheck check = EdcEcc::Check(sector, lba);
+            switch (check.Kind) {
+            case EdcEcc::SectorKind::NoSync:
+                report.NoSync.push_back(lba);
+                continue;
+            case EdcEcc::SectorKind::Unknown:
+                report.UnknownMode.push_back(lba);
+                continue;
+            case EdcEcc::SectorKind::Empty:
+                report.Empty++;
+                break;
+            case EdcEcc::SectorKind::Mode1:
+                report.Mode1++;
+                break;
+            case EdcEcc::SectorKind::Mode2Form1:
+                report.Mode2Form1++;
+                break;
+            case EdcEcc::SectorKind::Mode2Form2:
+                report.Mode2Form2++;
+                break;
+            }
+            if (!check.AddressValid) {
+                report.BadAddress.push_back(lba);
+            }
+            if (!check.EdcValid) {
+                report.BadEdc.push_back(lba);
+            }
+            if (!check.EccValid) {
+                report.BadEcc.push_back(lba);
+            }
+
+            if (repair && (!check.EdcValid || !check.EccValid)) {
+                if (sector != expanded) {
+                    std::memcpy(expanded, sector, EdcEcc::RawSectorSize);
+                }
+                // What the ECC can undo is undone. Otherwise the codes are only recomputed for a sector
+                // whose header shows it is in its place, such as one whose user data was edited.
+                if (EdcEcc::Correct(expanded)) {
+                    report.Corrected++;
+                }
+                else if (check.AddressValid) {
+                    EdcEcc::Regenerate(expanded);
+                }
+                else {
+                    report.Unrecoverable.push_back(lba);
+                    continue;
+                }
+                result.Repairs.push_back({ lba * static_cast<uint64_t>(layout.SectorSize),
+                    std::vector<uint8_t>(expanded + headerSkipped, expanded + EdcEcc::RawSectorSize) });
+            }
+        }
+    }
+
+} // namespace
+
+SectorScanner::SectorScanner(std::string imagePath, SectorScanOptions options)
+    : imagePath(std::move(imagePath)), options(options) {
+}
+
+SectorScanReport SectorScanner::Scan() {
+    auto startTime = std::chrono::steady_clock::now();
+    SectorScanReport report;
+    std::vector<ImageWrite> repairs;
+    {
+        auto image = ImageReader::Open(imagePath, options.Backend);
+        if (!image) {
+            throw std::runtime_error("Failed to open image: " + imagePath);
+        }
+        const SectorLayout layout = RawSectorReader::Detect(*image);
+        if (!layout.IsRaw()) {
+            throw std::runtime_error(imagePath + " is not a raw-sector image.");
+        }
+        report.Layout = layout;
+        report.ImageSectors = image->Size() / layout.SectorSize;
+
+        uint8_t volumeSpaceSize[4];
+        if (!image->Read(PrimaryVolumeDescriptorLBA * layout.SectorSize + layout.DataOffset + VolumeSpaceSizeOffset,
+            volumeSpaceSize, sizeof(volumeSpaceSize))) {
+            throw std::runtime_error("Failed to read the primary volume descriptor of " + imagePath + ".");
+        }
+        report.VolumeSectors = Bytes::ReadUInt32(volumeSpaceSize);
+        report.SectorsChecked = std::min(report.VolumeSectors, report.ImageSectors);
+
+        const uint64_t chunkSectors = ChunkSize / layout.SectorSize;
+        std::vector<ChunkResult> results(static_cast<size_t>((report.SectorsChecked + chunkSectors - 1) / chunkSectors));
+        ByteBudget budget(options.MaxBytesInFlight);
+        WorkerPool pool(options.ThreadCount);
+        for (size_t index = 0; index < results.size(); index++) {
+            uint64_t firstSector = index * chunkSectors;
+            uint64_t sectorCount = std::min(chunkSectors, report.SectorsChecked - firstSector);
+            size_t length = static_cast<size_t>(sectorCount * layout.SectorSize);
+            budget.Acquire(length);
+            FileView chunk;
+            try {
+                chunk = image->View(firstSector * layout.SectorSize, length);
+            }
+            catch (...) {
+                budget.Release(length);
+                pool.Wait();
+                throw;
+            }
+            pool.Submit([this, &results, &budget, index, firstSector, sectorCount, layout, chunk]() {
+                CheckChunk(chunk.Data(), firstSector, sectorCount, layout, options.Repair, results[index]);
+                budget.Release(chunk.Size());
+            });
+        }
+        pool.Wait();
+
+        // Chunks are merged in order, so the sector lists come out sorted.
+        for (auto& result : results) {
+            report.Mode1 += result.Report.Mode1;
+            report.Mode2Form1 += result.Report.Mode2Form1;
+            report.Mode2Form2 += result.Report.Mode2Form2;
+            report.Empty += result.Report.Empty;
+            Append(report.NoSync, result.Report.NoSync);
+            Append(report.UnknownMode, result.Report.UnknownMode);
+            Append(report.BadAddress, result.Report.BadAddress);
+            Append(report.BadEdc, result.Report.BadEdc);
+            Append(report.BadEcc, result.Report.BadEcc);
+            Append(report.Unrecoverable, result.Report.Unrecoverable);
+            report.Corrected += result.Report.Corrected;
+            std::move(result.Repairs.begin(), result.Repairs.end(), std::back_inserter(repairs));
+        }
+    }
+
+    // The image is closed by now, so it can be opened for writing on Windows too.
+    if (!repairs.empty()) {
+        ISOPatcher::ApplyWrites(imagePath, repairs);
+        report.Repaired = repairs.size();
+    }
+
+    report.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    uint64_t bytes = report.SectorsChecked * report.Layout.SectorSize;
+    LOG_INFO("Scanned " << report.SectorsChecked << " " << report.Layout.GetName() << " sectors of " << imagePath
+        << " in " << report.Seconds << " s: " << (report.Seconds > 0.0 ? bytes / (1024.0 * 1024.0) / report.Seconds : 0.0)
+        << " MB/s");
+    return report;
+}
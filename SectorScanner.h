@@ -0,0 +1,63 @@
+#ifndef SECTORSCANNER_H
+#define SECTORSCANNER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ImageReader.h"
+#include "RawSectorReader.h"
+
+struct SectorScanOptions {
+    ImageBackend Backend = ImageBackend::Auto;
+    size_t ThreadCount = 0;                         // 0 = one checking thread per hardware thread
+    uint64_t MaxBytesInFlight = 256ull * 1024 * 1024; // Hard cap on data read but not yet checked
+    bool Repair = false;                            // Fix sectors that fail their EDC/ECC where possible
+};
+
+struct SectorScanReport {
+    SectorLayout Layout;
+    uint64_t VolumeSectors = 0;     // From the primary volume descriptor
+    uint64_t ImageSectors = 0;      // Whole sectors in the file
+    uint64_t SectorsChecked = 0;    // The volume, or as much of it as the file holds
+    uint64_t Mode1 = 0;
+    uint64_t Mode2Form1 = 0;
+    uint64_t Mode2Form2 = 0;
+    uint64_t Empty = 0;
+    // Failing sector numbers, ascending. Repaired sectors are still listed.
+    std::vector<uint32_t> NoSync;
+    std::vector<uint32_t> UnknownMode;
+    std::vector<uint32_t> BadAddress;
+    std::vector<uint32_t> BadEdc;
+    std::vector<uint32_t> BadEcc;
+    std::vector<uint32_t> Unrecoverable;    // Failing sectors that repairing left alone
+    uint64_t Repaired = 0;          // Sectors written back, when repairing
+    uint64_t Corrected = 0;         // Of those, the ones restored by the ECC
+    double Seconds = 0.0;
+
+    bool Passed() const {
+        bool codesValid = (BadEdc.empty() && BadEcc.empty()) || (Repaired > 0 && Unrecoverable.empty());
+        return NoSync.empty() && UnknownMode.empty() && BadAddress.empty() && codesValid && SectorsChecked == VolumeSectors;
+    }
+};
+
+// Checks the sync pattern, header address, EDC and ECC of every sector of the volume in a raw
+// image. The file is read sequentially in chunks that are checked on a worker pool.
+//
+// With Repair set, sectors whose EDC or ECC does not match their contents are fixed and written
+// back once the scan is done. Damage the P/Q parity can correct is corrected. Beyond that, a
+// sector with a valid header gets its EDC and ECC recomputed, e.g. after its user data was edited
+// by a tool that does not know about raw sectors; that makes whatever it holds look intact. The
+// rest are reported as unrecoverable. A small edit looks like damage, so it may be corrected away.
+class SectorScanner {
+public:
+    explicit SectorScanner(std::string imagePath, SectorScanOptions options = {});
+
+    // Throws std::runtime_error if the image is not a raw-sector image.
+    SectorScanReport Scan();
+
+private:
+    std::string imagePath;
+    SectorScanOptions options;
+};
+
+#endif // SECTORSCANNER_H
@@ -0,0 +1,349 @@
+#include "SyntheticISO.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+    constexpr uint32_t BlockSize = SyntheticISO::LogicalBlockSize;
+
+    uint32_t SectorsFor(uint64_t bytes) {
+        return static_cast<uint32_t>(std::max<uint64_t>(1, (bytes + BlockSize - 1) / BlockSize));
+    }
+
+    void PutUInt16LE(uint8_t* out, uint16_t value) {
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    void PutUInt16BE(uint8_t* out, uint16_t value) {
+        out[0] = static_cast<uint8_t>(value >> 8);
+        out[1] = static_cast<uint8_t>(value);
+    }
+
+    void PutUInt32LE(uint8_t* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    void PutUInt32BE(uint8_t* out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out[i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+        }
+    }
+
+    void PutBothEndian16(uint8_t* out, uint16_t value) {
+        PutUInt16LE(out, value);
+        PutUInt16BE(out + 2, value);
+    }
+
+    void PutBothEndian32(uint8_t* out, uint32_t value) {
+        PutUInt32LE(out, value);
+        PutUInt32BE(out + 4, value);
+    }
+
+    size_t RecordLength(size_t identifierLength) {
+        size_t length = 33 + identifierLength;
+        return length + (length & 1);
+    }
+
+    // Appends one directory record, first moving to the next sector if it would straddle a boundary.
+    void AppendRecord(std::vector<uint8_t>& extent, const std::string& identifier, uint32_t lba, uint32_t size, bool isDirectory) {
+        size_t length = RecordLength(identifier.size());
+        size_t used = extent.size() % BlockSize;
+        if (used + length > BlockSize) {
+            extent.resize(extent.size() + BlockSize - used, 0);
+        }
+
+        size_t start = extent.size();
+        extent.resize(start + length, 0);
+        uint8_t* record = extent.data() + start;
+        record[0] = static_cast<uint8_t>(length);
+        PutBothEndian32(record + 2, lba);
+        PutBothEndian32(record + 10, size);
+        const uint8_t recorded[7] = { 99, 1, 2, 3, 4, 5, 0 }; // 1999-01-02 03:04:05 GMT
+        std::copy(recorded, recorded + 7, record + 18);
+        record[25] = isDirectory ? 0x02 : 0x00;
+        PutBothEndian16(record + 28, 1);
+        record[32] = static_cast<uint8_t>(identifier.size());
+        std::copy(identifier.begin(), identifier.end(), record + 33);
+    }
+
+    void FillPattern(uint8_t* out, size_t length, uint32_t seed) {
+        uint32_t state = seed * 2654435761u + 1;
+        for (size_t i = 0; i < length; i++) {
+            state = state * 1103515245u + 12345u;
+            out[i] = static_cast<uint8_t>(state >> 16);
+        }
+    }
+
+} // namespace
+
+SyntheticISO::SyntheticISO() {
+    directories.push_back({ "", Root, {}, {} });
+}
+
+uint32_t SyntheticISO::AddDirectory(uint32_t parent, const std::string& name) {
+    uint32_t id = static_cast<uint32_t>(directories.size());
+    directories.push_back({ name, parent, {}, {} });
+    directories[parent].Directories.push_back(id);
+    return id;
+}
+
+void SyntheticISO::AddFile(uint32_t parent, const std::string& name, uint32_t size) {
+    directories[parent].Files.push_back(static_cast<uint32_t>(files.size()));
+    files.push_back({ name + ";1", size });
+}
+
+uint64_t SyntheticISO::GetTotalFileBytes() const {
+    uint64_t total = 0;
+    for (const auto& file : files) {
+        total += file.Size;
+    }
+    return total;
+}
+
+void SyntheticISO::Write(const std::string& path) const {
+    // Path table order: breadth first, siblings sorted by identifier.
+    std::vector<uint32_t> order = { Root };
+    std::vector<uint16_t> parentNumbers = { 1 };
+    for (size_t i = 0; i < order.size(); i++) {
+        std::vector<uint32_t> children = directories[order[i]].Directories;
+        std::sort(children.begin(), children.end(), [this](uint32_t a, uint32_t b) {
+            return directories[a].Name < directories[b].Name;
+        });
+        for (uint32_t child : children) {
+            order.push_back(child);
+            parentNumbers.push_back(static_cast<uint16_t>(i + 1));
+        }
+    }
+    if (order.size() > 0xFFFF) {
+        throw std::runtime_error("Too many directories for a path table.");
+    }
+
+    // Each directory's records, with extent locations patched in once the layout is known.
+    struct Entry {
+        std::string Identifier;
+        uint32_t Id;
+        bool IsDirectory;
+    };
+    std::vector<std::vector<Entry>> entries(directories.size());
+    std::vector<uint32_t> extentSizes(directories.size());
+    for (uint32_t directory : order) {
+        auto& list = entries[directory];
+        for (uint32_t child : directories[directory].Directories) {
+            list.push_back({ directories[child].Name, child, true });
+        }
+        for (uint32_t file : directories[directory].Files) {
+            list.push_back({ files[file].Name, file, false });
+        }
+        std::sort(list.begin(), list.end(), [](const Entry& a, const Entry& b) { return a.Identifier < b.Identifier; });
+
+        std::vector<uint8_t> extent;
+        AppendRecord(extent, std::string(1, '\0'), 0, 0, true);
+        AppendRecord(extent, std::string(1, '\1'), 0, 0, true);
+        for (const auto& entry : list) {
+            AppendRecord(extent, entry.Identifier, 0, 0, entry.IsDirectory);
+        }
+        extentSizes[directory] = SectorsFor(extent.size()) * BlockSize;
+    }
+
+    size_t pathTableSize = 0;
+    for (uint32_t directory : order) {
+        size_t nameLength = directory == Root ? 1 : directories[directory].Name.size();
+        pathTableSize += 8 + nameLength + (nameLength & 1);
+    }
+    uint32_t pathTableSectors = SectorsFor(pathTableSize);
+
+    // Sectors 0-15 system area, 16 PVD, 17 terminator, then the L and M path tables,
+    // the directory extents in path table order and finally the file data.
+    uint32_t lPathTableLBA = 18;
+    uint32_t mPathTableLBA = lPathTableLBA + pathTableSectors;
+    uint32_t nextLBA = mPathTableLBA + pathTableSectors;
+
+    std::vector<uint32_t> directoryLBAs(directories.size());
+    for (uint32_t directory : order) {
+        directoryLBAs[directory] = nextLBA;
+        nextLBA += extentSizes[directory] / BlockSize;
+    }
+    std::vector<uint32_t> fileLBAs(files.size());
+    for (uint32_t directory : order) {
+        for (const auto& entry : entries[directory]) {
+            if (!entry.IsDirectory) {
+                fileLBAs[entry.Id] = nextLBA;
+                nextLBA += SectorsFor(files[entry.Id].Size);
+            }
+        }
+    }
+    uint32_t volumeSpaceSize = nextLBA;
+
+    std::vector<uint8_t> head(static_cast<size_t>(mPathTableLBA + pathTableSectors) * BlockSize, 0);
+
+    uint8_t* pvd = head.data() + 16 * BlockSize;
+    pvd[0] = 1;
+    std::copy_n("CD001", 5, pvd + 1);
+    pvd[6] = 1;
+    std::fill(pvd + 8, pvd + 72, ' ');
+    std::copy_n("PLAYSTATION", 11, pvd + 8);
+    std::copy_n("SYNTHETIC", 9, pvd + 40);
+    PutBothEndian32(pvd + 80, volumeSpaceSize);
+    PutBothEndian16(pvd + 120, 1);
+    PutBothEndian16(pvd + 124, 1);
+    PutBothEndian16(pvd + 128, BlockSize);
+    PutBothEndian32(pvd + 132, static_cast<uint32_t>(pathTableSize));
+    PutUInt32LE(pvd + 140, lPathTableLBA);
+    PutUInt32BE(pvd + 148, mPathTableLBA);
+    std::vector<uint8_t> rootRecord;
+    AppendRecord(rootRecord, std::string(1, '\0'), directoryLBAs[Root], extentSizes[Root], true);
+    std::copy(rootRecord.begin(), rootRecord.end(), pvd + 156);
+    pvd[881] = 1;
+
+    uint8_t* terminator = head.data() + 17 * BlockSize;
+    terminator[0] = 255;
+    std::copy_n("CD001", 5, terminator + 1);
+    terminator[6] = 1;
+
+    uint8_t* lTable = head.data() + static_cast<size_t>(lPathTableLBA) * BlockSize;
+    uint8_t* mTable = head.data() + static_cast<size_t>(mPathTableLBA) * BlockSize;
+    for (size_t i = 0; i < order.size(); i++) {
+        uint32_t directory = order[i];
+        std::string name = directory == Root ? std::string(1, '\0') : directories[directory].Name;
+        for (uint8_t* table : { lTable, mTable }) {
+            table[0] = static_cast<uint8_t>(name.size());
+            if (table == lTable) {
+                PutUInt32LE(table + 2, directoryLBAs[directory]);
+                PutUInt16LE(table + 6, parentNumbers[i]);
+            }
+            else {
+                PutUInt32BE(table + 2, directoryLBAs[directory]);
+                PutUInt16BE(table + 6, parentNumbers[i]);
+            }
+            std::copy(name.begin(), name.end(), table + 8);
+        }
+        size_t entryLength = 8 + name.size() + (name.size() & 1);
+        lTable += entryLength;
+        mTable += entryLength;
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Failed to create synthetic image: " + path);
+    }
+    out.write(reinterpret_cast<const char*>(head.data()), head.size());
+
+    for (uint32_t directory : order) {
+        uint32_t parent = directories[directory].Parent;
+        std::vector<uint8_t> extent;
+        AppendRecord(extent, std::string(1, '\0'), directoryLBAs[directory], extentSizes[directory], true);
+        AppendRecord(extent, std::string(1, '\1'), directoryLBAs[parent], extentSizes[parent], true);
+        for (const auto& entry : entries[directory]) {
+            if (entry.IsDirectory) {
+                AppendRecord(extent, entry.Identifier, directoryLBAs[entry.Id], extentSizes[entry.Id], true);
+            }
+            else {
+                AppendRecord(extent, entry.Identifier, fileLBAs[entry.Id], files[entry.Id].Size, false);
+            }
+        }
+        extent.resize(extentSizes[directory], 0);
+        out.seekp(static_cast<std::streamoff>(directoryLBAs[directory]) * BlockSize);
+        out.write(reinterpret_cast<const char*>(extent.data()), extent.size());
+    }
+
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < files.size(); i++) {
+        size_t length = std::min<uint64_t>(files[i].Size, files[i].Size > DenseFileLimit ? BlockSize : DenseFileLimit);
+        if (length == 0) {
+            continue;
+        }
+        data.resize(length);
+        FillPattern(data.data(), length, static_cast<uint32_t>(i));
+        out.seekp(static_cast<std::streamoff>(fileLBAs[i]) * BlockSize);
+        out.write(reinterpret_cast<const char*>(data.data()), length);
+    }
+
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Failed to write synthetic image: " + path);
+    }
+    // Extends the file over the trailing holes without writing them.
+    std::filesystem::resize_file(path, static_cast<uint64_t>(volumeSpaceSize) * BlockSize);
+}
+
+std::vector<std::string> SyntheticISO::GetShapeNames() {
+    return { "deep", "wide", "multisector", "tiny", "large" };
+}
+
+SyntheticISO SyntheticISO::CreateShape(const std::string& shape, uint32_t scale) {
+    scale = std::max<uint32_t>(scale, 1);
+    SyntheticISO iso;
+    char name[16];
+
+    if (shape == "deep") {
+        // A single chain of nested directories with a few small files at every level.
+        uint32_t directory = Root;
+        uint32_t depth = std::max<uint32_t>(96 / scale, 8);
+        for (uint32_t level = 0; level < depth; level++) {
+            snprintf(name, sizeof(name), "LEVEL%03u", level);
+            directory = iso.AddDirectory(directory, name);
+            for (uint32_t i = 0; i < 4; i++) {
+                snprintf(name, sizeof(name), "F%u.BIN", i);
+                iso.AddFile(directory, name, 1024 + i * 512);
+            }
+        }
+    }
+    else if (shape == "wide") {
+        // One directory holding tens of thousands of entries.
+        uint32_t directory = iso.AddDirectory(Root, "WIDE");
+        uint32_t count = 30000 / scale;
+        for (uint32_t i = 0; i < count; i++) {
+            snprintf(name, sizeof(name), "F%06u.BIN", i);
+            iso.AddFile(directory, name, 2048);
+        }
+    }
+    else if (shape == "multisector") {
+        // Many directories whose records each fill four to five sectors.
+        uint32_t count = 400 / scale;
+        for (uint32_t d = 0; d < count; d++) {
+            snprintf(name, sizeof(name), "DIR%04u", d);
+            uint32_t directory = iso.AddDirectory(Root, name);
+            for (uint32_t i = 0; i < 200; i++) {
+                snprintf(name, sizeof(name), "FILE%04u.DAT", i);
+                iso.AddFile(directory, name, 4096 + (i % 7) * 1000);
+            }
+        }
+    }
+    else if (shape == "tiny") {
+        // Many files well below a sector, spread over a two-level tree.
+        uint32_t groups = std::max<uint32_t>(20 / scale, 1);
+        uint32_t perDirectory = 2500 / scale;
+        for (uint32_t g = 0; g < groups; g++) {
+            snprintf(name, sizeof(name), "GROUP%02u", g);
+            uint32_t group = iso.AddDirectory(Root, name);
+            for (uint32_t s = 0; s < 4; s++) {
+                snprintf(name, sizeof(name), "SUB%u", s);
+                uint32_t directory = iso.AddDirectory(group, name);
+                for (uint32_t i = 0; i < perDirectory / 4; i++) {
+                    snprintf(name, sizeof(name), "T%05u.TXT", i);
+                    iso.AddFile(directory, name, 1 + (i * 37) % 512);
+                }
+            }
+        }
+    }
+    else if (shape == "large") {
+        // A handful of multi-GB files (sparse on disk) next to a small one.
+        uint32_t directory = iso.AddDirectory(Root, "MOVIES");
+        uint32_t size = static_cast<uint32_t>((2ull << 30) / scale);
+        for (uint32_t i = 0; i < 2; i++) {
+            snprintf(name, sizeof(name), "MOVIE%u.PSS", i);
+            iso.AddFile(directory, name, size);
+        }
+        iso.AddFile(Root, "SYSTEM.CNF", 64);
+    }
+    else {
+        throw std::invalid_argument("Unknown synthetic image shape: " + shape);
+    }
+    return iso;
+}
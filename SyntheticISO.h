@@ -0,0 +1,55 @@
+#ifndef SYNTHETICISO_H
+#define SYNTHETICISO_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Builds a minimal but well-formed ISO9660 image (PVD, terminator, L/M path tables, directory
+// extents, file data) for benchmarks. Directory records never straddle a sector, so large
+// directories span several sectors just as mastering tools lay them out.
+//
+// File contents are a deterministic pattern. Only the first sector of files larger than
+// DenseFileLimit is written; the rest is left as a hole, so multi-GB files stay sparse on disk.
+class SyntheticISO {
+public:
+    static constexpr uint32_t Root = 0;
+    static constexpr uint32_t LogicalBlockSize = 2048;
+    static constexpr uint64_t DenseFileLimit = 1024 * 1024;
+
+    SyntheticISO();
+
+    // Names are d-characters (e.g. "DATA", "FILE.BIN"); files get a ";1" version suffix on disc.
+    uint32_t AddDirectory(uint32_t parent, const std::string& name);
+    void AddFile(uint32_t parent, const std::string& name, uint32_t size);
+
+    size_t GetDirectoryCount() const { return directories.size(); }
+    size_t GetFileCount() const { return files.size(); }
+    uint64_t GetTotalFileBytes() const;
+
+    // Lays out and writes the image. Throws std::runtime_error if the file cannot be written.
+    void Write(const std::string& path) const;
+
+    // Preset shapes: "deep", "wide", "multisector", "tiny" and "large". `scale` divides the entry
+    // counts (and the size of the large files) for quick runs. Throws on an unknown shape name.
+    static SyntheticISO CreateShape(const std::string& shape, uint32_t scale = 1);
+    static std::vector<std::string> GetShapeNames();
+
+private:
+    struct Directory {
+        std::string Name;
+        uint32_t Parent;
+        std::vector<uint32_t> Directories;
+        std::vector<uint32_t> Files;
+    };
+
+    struct File {
+        std::string Name;
+        uint32_t Size;
+    };
+
+    std::vector<Directory> directories;
+    std::vector<File> files;
+};
+
+#endif // SYNTHETICISO_H
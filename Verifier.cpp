@@ -0,0 +1,320 @@
+#include "Verifier.h"
+#include "AsyncReader.h"
+#include "ISOArchive.h"
+#include "Log.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+    constexpr size_t ChunkSize = 4 * 1024 * 1024;
+
+    // "LEVEL000/F0.BIN;1" -> "LEVEL000/F0.BIN"
+    std::string StripVersions(std::string_view path) {
+        std::string result;
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = path.find('/', start);
+            if (end == std::string_view::npos) {
+                end = path.size();
+            }
+            std::string_view component = path.substr(start, end - start);
+            component = component.substr(0, component.rfind(';'));
+            if (start > 0) {
+                result += '/';
+            }
+            result += component;
+            start = end + 1;
+        }
+        return result;
+    }
+
+    std::string NormalizePath(std::string_view path) {
+        std::string normalized;
+        for (char c : path) {
+            c = c == '\\' ? '/' : c;
+            normalized += (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+        }
+        // The member separator is kept; only the file part carries versions.
+        size_t member = normalized.find(':');
+        std::string file = StripVersions(normalized.substr(0, member));
+        std::string result = member == std::string::npos ? file : file + normalized.substr(member);
+        result.erase(0, result.find_first_not_of('/'));
+        return result;
+    }
+
+    bool IsHex(std::string_view text, size_t length) {
+        return text.size() == length && std::all_of(text.begin(), text.end(), [](char c) {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+        });
+    }
+
+    uint8_t HexValue(char c) {
+        if (c >= '0' && c <= '9') {
+            return static_cast<uint8_t>(c - '0');
+        }
+        return static_cast<uint8_t>((c | 0x20) - 'a' + 10);
+    }
+
+    uint32_t ParseCrc(std::string_view text) {
+        uint32_t value = 0;
+        for (char c : text) {
+            value = (value << 4) | HexValue(c);
+        }
+        return value;
+    }
+
+    Checksum::Sha1::Digest ParseSha1(std::string_view text) {
+        Checksum::Sha1::Digest digest;
+        for (size_t i = 0; i < digest.size(); i++) {
+            digest[i] = static_cast<uint8_t>((HexValue(text[i * 2]) << 4) | HexValue(text[i * 2 + 1]));
+        }
+        return digest;
+    }
+
+    struct HashItem {
+        uint64_t Offset;
+        uint64_t Size;
+        std::string Path;
+    };
+
+    // Running state of one file. `Busy` is set while a worker owns the file's pending chunks.
+    struct HashState {
+        std::mutex Mutex;
+        std::deque<FileView> Pending;
+        bool Busy = false;
+        uint32_t Crc32 = 0;
+        Checksum::Sha1 Sha1;
+    };
+
+} // namespace
+
+Verifier::Verifier(ISO& iso, VerificationOptions options)
+    : iso(iso), options(options) {
+}
+
+std::vector<FileDigest> Verifier::HashAll() {
+    auto startTime = std::chrono::steady_clock::now();
+    const FileIndex& index = iso.GetIndex();
+
+    std::vector<HashItem> items;
+    for (uint32_t id = FileIndex::RootId + 1; id < index.Size(); id++) {
+        if (index.IsDirectory(id)) {
+            continue;
+        }
+        std::string path = StripVersions(index.GetPath(id, '/'));
+        items.push_back({ iso.GetImageOffset(id), index.GetSize(id), path });
+
+        std::string extension = path.substr(std::min(path.size(), path.rfind('.')));
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); });
+        if (!options.ArchiveMembers || (extension != ".HD2" && extension != ".HED")) {
+            continue;
+        }
+        try {
+            ISOArchive archive(iso, index.GetPath(id, '/'));
+            const ArchiveIndex& members = archive.GetIndex();
+            for (uint32_t member = 0; member < members.Size(); member++) {
+                std::string name(members.GetName(member));
+                std::replace(name.begin(), name.end(), '\\', '/');
+                items.push_back({ archive.GetImageOffset(member), members.GetSize(member), path + ":" + name });
+            }
+        }
+        catch (const std::exception& ex) {
+            LOG_WARNING("Skipping the members of " << path << ": " << ex.what());
+        }
+    }
+    std::stable_sort(items.begin(), items.end(), [](const HashItem& a, const HashItem& b) { return a.Offset < b.Offset; });
+
+    // Chunks are tagged with their item. Sorting keeps each item's chunks in order, and chunks
+    // of archive members come out of the buffer of the archive that holds them.
+    const uint64_t chunkSize = std::max<uint64_t>(1, std::min<uint64_t>(ChunkSize, options.MaxBytesInFlight));
+    std::vector<AsyncReadRequest> requests;
+    for (size_t item = 0; item < items.size(); item++) {
+        for (uint64_t position = 0; position < items[item].Size; position += chunkSize) {
+            uint64_t length = std::min(items[item].Size - position, chunkSize);
+            requests.push_back({ items[item].Offset + position, length, item });
+        }
+    }
+
+    // The reader's buffers are released as chunks are hashed, so the pool must go first.
+    std::vector<HashState> states(items.size());
+    AsyncReadOptions readOptions;
+    readOptions.QueueDepth = options.QueueDepth;
+    readOptions.MaxBytesInFlight = options.MaxBytesInFlight;
+    AsyncReader source(*iso.GetReader(), iso.GetFileName(), readOptions);
+    WorkerPool pool(options.ThreadCount);
+    source.Start(std::move(requests));
+
+    auto drain = [&states](size_t item) {
+        HashState& state = states[item];
+        for (;;) {
+            FileView chunk;
+            {
+                std::lock_guard<std::mutex> lock(state.Mutex);
+                if (state.Pending.empty()) {
+                    state.Busy = false;
+                    return;
+                }
+                chunk = std::move(state.Pending.front());
+                state.Pending.pop_front();
+            }
+            state.Crc32 = Checksum::Crc32(chunk.Data(), chunk.Size(), state.Crc32);
+            state.Sha1.Update(chunk.Data(), chunk.Size());
+        }
+    };
+
+    uint64_t bytesHashed = 0;
+    AsyncReadResult read;
+    try {
+        while (source.Next(read)) {
+            size_t item = static_cast<size_t>(read.Tag);
+            size_t length = read.Data.Size();
+            bool start;
+            {
+                std::lock_guard<std::mutex> lock(states[item].Mutex);
+                states[item].Pending.push_back(std::move(read.Data));
+                start = !states[item].Busy;
+                states[item].Busy = true;
+            }
+            if (start) {
+                pool.Submit([&drain, item]() { drain(item); });
+            }
+            bytesHashed += length;
+        }
+    }
+    catch (...) {
+        pool.Wait();
+        throw;
+    }
+    pool.Wait();
+
+    std::vector<FileDigest> digests(items.size());
+    for (size_t item = 0; item < items.size(); item++) {
+        digests[item].Path = std::move(items[item].Path);
+        digests[item].Size = items[item].Size;
+        digests[item].Crc32 = states[item].Crc32;
+        digests[item].Sha1 = states[item].Sha1.Finish();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    LOG_INFO("Hashed " << digests.size() << " entries (" << bytesHashed << " bytes) in " << seconds << " s: "
+        << (seconds > 0.0 ? bytesHashed / (1024.0 * 1024.0) / seconds : 0.0) << " MB/s");
+    return digests;
+}
+
+std::vector<ManifestEntry> Verifier::LoadManifest(const std::string& path) {
+    std::ifstream input(path);
+    if (!input) {
+        throw std::runtime_error("Failed to open " + path + ".");
+    }
+
+    std::vector<ManifestEntry> entries;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(input, line); lineNumber++) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+            line.pop_back();
+        }
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == ';' || line[first] == '#') {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string token0, token1, token2;
+        fields >> token0 >> token1 >> token2;
+        auto rest = [&](size_t tokens) {
+            // Text after the first `tokens` whitespace-separated fields; paths may contain spaces.
+            size_t position = first;
+            for (size_t i = 0; i < tokens; i++) {
+                position = line.find_first_of(" \t", position);
+                position = line.find_first_not_of(" \t", position);
+            }
+            return position == std::string::npos ? std::string() : line.substr(position);
+        };
+
+        ManifestEntry entry;
+        if (IsHex(token0, 8) && IsHex(token1, 40) && !token2.empty() &&
+            std::all_of(token2.begin(), token2.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            entry.Crc32 = ParseCrc(token0);
+            entry.Sha1 = ParseSha1(token1);
+            entry.Size = std::stoull(token2);
+            entry.Path = rest(3);
+        }
+        else if (IsHex(token0, 40)) {
+            entry.Sha1 = ParseSha1(token0);
+            entry.Path = rest(1);
+            if (!entry.Path.empty() && entry.Path[0] == '*') {
+                entry.Path.erase(0, 1);
+            }
+        }
+        else {
+            size_t separator = line.find_last_of(" \t");
+            std::string crc = separator == std::string::npos ? std::string() : line.substr(separator + 1);
+            if (!IsHex(crc, 8)) {
+                throw std::runtime_error("Unrecognized line " + std::to_string(lineNumber) + " in " + path + ".");
+            }
+            entry.Crc32 = ParseCrc(crc);
+            entry.Path = line.substr(first, line.find_last_not_of(" \t", separator) + 1 - first);
+        }
+        if (entry.Path.empty()) {
+            throw std::runtime_error("Missing path on line " + std::to_string(lineNumber) + " in " + path + ".");
+        }
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+void Verifier::WriteManifest(std::ostream& output, const std::vector<FileDigest>& digests) {
+    output << "; crc32 sha1 size path\n";
+    for (const auto& digest : digests) {
+        output << Checksum::ToHex(digest.Crc32) << ' ' << Checksum::ToHex(digest.Sha1.data(), digest.Sha1.size())
+            << ' ' << digest.Size << ' ' << digest.Path << '\n';
+    }
+}
+
+VerificationReport Verifier::Compare(const std::vector<FileDigest>& digests, const std::vector<ManifestEntry>& manifest) {
+    std::unordered_map<std::string, const FileDigest*> byPath;
+    for (const auto& digest : digests) {
+        byPath.emplace(NormalizePath(digest.Path), &digest);
+    }
+
+    VerificationReport report;
+    std::unordered_set<const FileDigest*> listed;
+    for (const auto& entry : manifest) {
+        auto found = byPath.find(NormalizePath(entry.Path));
+        if (found == byPath.end()) {
+            report.Missing.push_back(entry.Path);
+            continue;
+        }
+        const FileDigest& digest = *found->second;
+        listed.insert(&digest);
+        if (entry.Size && *entry.Size != digest.Size) {
+            report.Mismatched.push_back(entry.Path + " (size " + std::to_string(digest.Size) + ", expected " + std::to_string(*entry.Size) + ")");
+        }
+        else if (entry.Crc32 && *entry.Crc32 != digest.Crc32) {
+            report.Mismatched.push_back(entry.Path + " (crc32 " + Checksum::ToHex(digest.Crc32) + ", expected " + Checksum::ToHex(*entry.Crc32) + ")");
+        }
+        else if (entry.Sha1 && *entry.Sha1 != digest.Sha1) {
+            report.Mismatched.push_back(entry.Path + " (sha1 " + Checksum::ToHex(digest.Sha1.data(), digest.Sha1.size()) +
+                ", expected " + Checksum::ToHex(entry.Sha1->data(), entry.Sha1->size()) + ")");
+        }
+        else {
+            report.Matched++;
+        }
+    }
+    for (const auto& digest : digests) {
+        if (!listed.count(&digest)) {
+            report.Unlisted.push_back(digest.Path);
+        }
+    }
+    return report;
+}
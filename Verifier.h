@@ -0,0 +1,67 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Checksum.h"
+#include "ISO.h"
+
+struct VerificationOptions {
+    size_t ThreadCount = 0;                         // 0 = one hashing thread per hardware thread
+    uint64_t MaxBytesInFlight = 256ull * 1024 * 1024; // Hard cap on data read but not yet hashed
+    bool ArchiveMembers = false;                    // Also hash the members of every .hd2/.hed archive
+    size_t QueueDepth = 16;                         // Image reads kept in flight (see AsyncReader)
+};
+
+struct FileDigest {
+    std::string Path;               // "DATA/DATA.DAT", or "DATA/DATA.HD2:member" for archive members
+    uint64_t Size = 0;
+    uint32_t Crc32 = 0;
+    Checksum::Sha1::Digest Sha1{};
+};
+
+// One line of a hash list. Only the fields the list provides are checked.
+struct ManifestEntry {
+    std::string Path;
+    std::optional<uint64_t> Size;
+    std::optional<uint32_t> Crc32;
+    std::optional<Checksum::Sha1::Digest> Sha1;
+};
+
+struct VerificationReport {
+    uint64_t Matched = 0;
+    std::vector<std::string> Mismatched;    // With the first differing field
+    std::vector<std::string> Missing;       // Listed in the manifest but not in the image
+    std::vector<std::string> Unlisted;      // In the image but not in the manifest
+
+    bool Passed() const { return Mismatched.empty() && Missing.empty(); }
+};
+
+// Computes a CRC-32 and SHA-1 of every file in an image, optionally of every archive member too.
+// The image is read in LBA order in chunks, so the source stays sequential, and each chunk is
+// hashed on a worker pool. Chunks of one file are hashed in order by one worker at a time, while
+// different files hash in parallel.
+class Verifier {
+public:
+    Verifier(ISO& iso, VerificationOptions options = {});
+
+    // Digests in LBA order.
+    std::vector<FileDigest> HashAll();
+
+    // Reads this tool's own manifests ("crc32 sha1 size path"), sha1sum output ("sha1  path") and
+    // SFV files ("path crc32"). Lines starting with ';' or '#' are comments.
+    static std::vector<ManifestEntry> LoadManifest(const std::string& path);
+    static void WriteManifest(std::ostream& output, const std::vector<FileDigest>& digests);
+
+    // Paths match ignoring case, separator style and ";1" version suffixes.
+    static VerificationReport Compare(const std::vector<FileDigest>& digests, const std::vector<ManifestEntry>& manifest);
+
+private:
+    ISO& iso;
+    VerificationOptions options;
+};
+
+#endif // VERIFIER_H
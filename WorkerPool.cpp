@@ -0,0 +1,98 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(&WorkerPool::Run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void WorkerPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return tasks.empty() && activeTasks == 0; });
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkerPool::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty()) {
+            return;
+        }
+
+        std::function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+        activeTasks++;
+        lock.unlock();
+
+        try {
+            task();
+        }
+        catch (...) {
+            lock.lock();
+            if (!firstError) {
+                firstError = std::current_exception();
+            }
+            lock.unlock();
+        }
+
+        lock.lock();
+        activeTasks--;
+        if (tasks.empty() && activeTasks == 0) {
+            idle.notify_all();
+        }
+    }
+}
+
+void ByteBudget::Acquire(uint64_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [&] { return inFlight == 0 || inFlight + bytes <= limit; });
+    inFlight += bytes;
+    peak = std::max(peak, inFlight);
+}
+
+bool ByteBudget::TryAcquire(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (inFlight != 0 && inFlight + bytes > limit) {
+        return false;
+    }
+    inFlight += bytes;
+    peak = std::max(peak, inFlight);
+    return true;
+}
+
+void ByteBudget::Release(uint64_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight -= bytes;
+    }
+    released.notify_all();
+}
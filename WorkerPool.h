@@ -0,0 +1,60 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads draining a FIFO of tasks. The first exception thrown by a task is kept
+// and rethrown from Wait(); tasks queued after it still run.
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threadCount = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Submit(std::function<void()> task);
+    void Wait();
+    size_t GetThreadCount() const { return threads.size(); }
+
+private:
+    void Run();
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable idle;
+    size_t activeTasks = 0;
+    bool stopping = false;
+    std::exception_ptr firstError;
+};
+
+// Hard cap on the number of bytes held by in-flight work. Acquire() blocks until the request fits;
+// a single request larger than the cap is admitted once nothing else is in flight.
+class ByteBudget {
+public:
+    explicit ByteBudget(uint64_t limit) : limit(limit) {}
+
+    void Acquire(uint64_t bytes);
+    // Acquire() that gives up instead of waiting.
+    bool TryAcquire(uint64_t bytes);
+    void Release(uint64_t bytes);
+    uint64_t GetPeak() const { return peak; }
+
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    uint64_t limit;
+    uint64_t inFlight = 0;
+    uint64_t peak = 0;
+};
+
+#endif // WORKERPOOL_H
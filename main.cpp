@@ -1,7 +1,13 @@
 #include "MainWindow.h"
+#include "Metrics.h"
 #include <windows.h>
+#include <cstdlib>
 
 int APIENTRY wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow) {
+    // DCFM_METRICS=<file> collects load metrics for the session and writes them there as JSON on exit.
+    const char* metricsPath = std::getenv("DCFM_METRICS");
+    Metrics::SetEnabled(metricsPath != nullptr);
+
     MainWindow mainWindow(hInstance);
 
     if (!mainWindow.Create(L"Dark Cloud File Manager", 800, 600)) {
@@ -16,6 +22,10 @@ int APIENTRY wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmd
         DispatchMessage(&msg);
     }
 
+    if (metricsPath != nullptr) {
+        Metrics::WriteJson(metricsPath);
+    }
+
     return (int)msg.wParam;
 }
 